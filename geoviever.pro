@@ -1,4 +1,4 @@
-QT += core gui widgets location positioning quick quickwidgets
+QT += core gui widgets concurrent location network positioning quick quickwidgets
 
 CONFIG += c++17
 
@@ -6,27 +6,60 @@ include(src/3rdparty/libexif/libexif.pri)
 include(src/3rdparty/libjpeg/libjpeg.pri)
 
 SOURCES += \
+    src/bitmap.cpp \
+    src/catalog.cpp \
+    src/clusters.cpp \
     src/exif/file.cpp \
     src/exif/utils.cpp \
     src/exifstorage.cpp \
+    src/heatmap.cpp \
+    src/heatmaplayer.cpp \
     src/keywordsdialog.cpp \
     src/main.cpp \
     src/mainwindow.cpp \
+    src/markerlayer.cpp \
     src/model.cpp \
     src/pics.cpp \
     src/pixmaplabel.cpp \
+    src/previewloader.cpp \
+    src/stringpool.cpp \
+    src/thumbnailatlas.cpp \
+    src/thumbnaildelegate.cpp \
+    src/thumbnailstore.cpp \
+    src/tilepack.cpp \
+    src/tileserver.cpp \
+    src/tileview.cpp \
+    src/timeindex.cpp \
+    src/timeline.cpp \
     src/tooltip.cpp
 
 HEADERS += \
+    src/bitmap.h \
+    src/catalog.h \
+    src/clusters.h \
     src/exif/file.h \
     src/exif/utils.h \
     src/exifstorage.h \
+    src/heatmap.h \
+    src/heatmaplayer.h \
     src/keywordsdialog.h \
     src/mainwindow.h \
+    src/markerlayer.h \
     src/model.h \
+    src/photoid.h \
     src/pics.h \
     src/pixmaplabel.h \
+    src/previewloader.h \
     src/qtcompat.h \
+    src/stringpool.h \
+    src/thumbnailatlas.h \
+    src/thumbnaildelegate.h \
+    src/thumbnailstore.h \
+    src/tilepack.h \
+    src/tileserver.h \
+    src/tileview.h \
+    src/timeindex.h \
+    src/timeline.h \
     src/tooltip.h
 
 FORMS += \
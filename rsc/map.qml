@@ -1,14 +1,19 @@
-import QtGraphicalEffects 1.15
-import QtQuick 2.0
+import QtQuick 2.15
 import QtLocation 5.6
 import QtPositioning 5.6
-import QtQuick.Shapes 1.1
+import GeoViewer 1.0
 
 Rectangle {
     Map {
         id: map
         anchors.fill: parent
-        plugin: Plugin { name: "osm"; }
+        // the tiles come through the local caching server, as the custom map type
+        plugin: Plugin {
+            name: "osm"
+            PluginParameter { name: "osm.mapping.custom.host"; value: tiles.url }
+            PluginParameter { name: "osm.mapping.providersrepository.disabled"; value: true }
+        }
+        activeMapType: supportedMapTypes[supportedMapTypes.length - 1]
         center:  QtPositioning.coordinate(59.95, 30.32)
         zoomLevel: 11
 
@@ -28,61 +33,49 @@ Rectangle {
             easing.type: Easing.InOutQuad
         }
 
+        // the controller only asks to move, the map reports its zoom and center back
         Connections {
             target: controller
-            function onCenterChanged() {
-                if (Math.abs(controller.center.latitude - map.center.latitude) > Number.EPSILON &&
-                    Math.abs(controller.center.longitude - map.center.longitude) > Number.EPSILON) {
-                    centerAnimation.from = map.center
-                    centerAnimation.to = controller.center
-                    centerAnimation.start()
-                }
-            }
-            function onZoomChanged() {
-                if (Math.abs(controller.zoom - map.zoomLevel) > Number.EPSILON) {
-                    zoomAnimation.from = map.zoomLevel
-                    zoomAnimation.to = controller.zoom
-                    zoomAnimation.start()
-                }
+            function onFlightRequested(center, zoom) {
+                tiles.prefetchPath(map.center, map.zoomLevel, center, zoom, Qt.size(map.width, map.height))
+                centerAnimation.from = map.center
+                centerAnimation.to = center
+                centerAnimation.start()
+                zoomAnimation.from = map.zoomLevel
+                zoomAnimation.to = zoom
+                zoomAnimation.start()
             }
         }
 
-        MapItemView {
-            model: controller
-            delegate: MapQuickItem {
-                coordinate: QtPositioning.coordinate(_latitude_, _longitude_)
-                anchorPoint: Qt.point(thumbnail.width * 0.5, thumbnail.height * 0.5)
-                sourceItem: Shape {
-                    id: thumbnail
-                    width: controller.thumbnailSize
-                    height: controller.thumbnailSize
-                    visible: true
-
-                    Image {
-                        id: pic
-                        source: _pixmap_
-                    }
-
-                    ColorOverlay {
-                        id: overlay
-                        anchors.fill: pic
-                        source: pic
-                        color: selection.currentIndex.row === index ? "#40000040" : "#00000000"
-                    }
+        onZoomLevelChanged: controller.zoom = map.zoomLevel
+        onCenterChanged: controller.center = map.center
+        onVisibleRegionChanged: {
+            controller.viewport = map.visibleRegion.boundingGeoRectangle()
+            // the path prefetched for an animation is not replaced while it runs; the region is fetched once the map settles
+            if (!centerAnimation.running && !zoomAnimation.running)
+                tiles.prefetchRegion(controller.viewport, map.zoomLevel)
+        }
+    }
 
-                    MouseArea {
-                        anchors.fill: parent
-                        hoverEnabled: true
+    // a million photos are a heat, not markers
+    HeatmapLayer {
+        anchors.fill: map
+        visible: map.zoomLevel < controller.heatmapZoom
+        model: controller
+        zoom: map.zoomLevel
+        center: map.center
+    }
 
-                        onClicked: selection.currentRow = index;
-                        onEntered: selection.hoveredRow = index;
-                        onExited: selection.hoveredRow = -1;
-                    }
-                }
-            }
-        }
+    // all the buckets in one item; presses outside the markers go through to the map
+    MarkerLayer {
+        anchors.fill: map
+        visible: map.zoomLevel >= controller.heatmapZoom
+        model: controller
+        selectionModel: selection
+        zoom: map.zoomLevel
+        center: map.center
 
-        onZoomLevelChanged: controller.zoom = map.zoomLevel
-        onCenterChanged: controller.center = map.center
+        onClicked: selection.currentRow = row
+        onHovered: selection.hoveredRow = row
     }
 }
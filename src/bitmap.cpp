@@ -0,0 +1,427 @@
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BITMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "bitmap.h"
+
+constexpr int Bitmap::ARRAY_MAX;
+constexpr int Bitmap::BITSET_WORDS;
+
+namespace
+{
+
+struct And
+{
+    static quint64 apply(quint64 L, quint64 R) { return L & R; }
+#ifdef BITMAP_SSE2
+    static __m128i apply(__m128i L, __m128i R) { return _mm_and_si128(L, R); }
+#endif
+};
+
+struct Or
+{
+    static quint64 apply(quint64 L, quint64 R) { return L | R; }
+#ifdef BITMAP_SSE2
+    static __m128i apply(__m128i L, __m128i R) { return _mm_or_si128(L, R); }
+#endif
+};
+
+struct AndNot
+{
+    static quint64 apply(quint64 L, quint64 R) { return L & ~R; }
+#ifdef BITMAP_SSE2
+    static __m128i apply(__m128i L, __m128i R) { return _mm_andnot_si128(R, L); }
+#endif
+};
+
+/// combines two bitsets word by word, returns the number of bits set in the result
+template <class Op>
+int combine(const quint64* L, const quint64* R, quint64* out, int words)
+{
+    int i = 0;
+#ifdef BITMAP_SSE2
+    for (; i + 1 < words; i += 2)
+    {
+        __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(L + i));
+        __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(R + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), Op::apply(l, r));
+    }
+#endif
+    // the odd word left by the vector loop
+    for (; i < words; ++i)
+        out[i] = Op::apply(L[i], R[i]);
+
+    int count = 0;
+    for (int i = 0; i < words; ++i)
+        count += qPopulationCount(out[i]);
+    return count;
+}
+
+inline bool testBit(const QVector<quint64>& bits, quint16 low)
+{
+    return bits.at(low >> 6) & (quint64(1) << (low & 63));
+}
+
+} // namespace
+
+bool Bitmap::Chunk::contains(quint16 low) const
+{
+    if (isBitset())
+        return testBit(bits, low);
+    return std::binary_search(array.cbegin(), array.cend(), low);
+}
+
+bool Bitmap::Chunk::insert(quint16 low)
+{
+    if (isBitset())
+    {
+        quint64& word = bits[low >> 6];
+        const quint64 mask = quint64(1) << (low & 63);
+        if (word & mask)
+            return false;
+        word |= mask;
+        ++count;
+        return true;
+    }
+
+    auto i = std::lower_bound(array.begin(), array.end(), low);
+    if (i != array.end() && *i == low)
+        return false;
+
+    array.insert(i, low);
+    ++count;
+    normalize();
+    return true;
+}
+
+bool Bitmap::Chunk::remove(quint16 low)
+{
+    if (isBitset())
+    {
+        quint64& word = bits[low >> 6];
+        const quint64 mask = quint64(1) << (low & 63);
+        if (!(word & mask))
+            return false;
+        word &= ~mask;
+        --count;
+        normalize();
+        return true;
+    }
+
+    auto i = std::lower_bound(array.begin(), array.end(), low);
+    if (i == array.end() || *i != low)
+        return false;
+
+    array.erase(i);
+    --count;
+    return true;
+}
+
+void Bitmap::Chunk::toBitset()
+{
+    bits.fill(0, BITSET_WORDS);
+    for (quint16 low: array)
+        bits[low >> 6] |= quint64(1) << (low & 63);
+    array.clear();
+    array.squeeze();
+}
+
+void Bitmap::Chunk::toArray()
+{
+    array.clear();
+    array.reserve(count);
+    for (int w = 0; w < BITSET_WORDS; ++w)
+        for (quint64 word = bits.at(w); word; word &= word - 1)
+            array.append(static_cast<quint16>(w * 64 + qCountTrailingZeroBits(word)));
+    bits.clear();
+    bits.squeeze();
+}
+
+/// keeps the representation canonical: an array up to ARRAY_MAX values, a bitset above
+void Bitmap::Chunk::normalize()
+{
+    if (isBitset() && count <= ARRAY_MAX)
+        toArray();
+    else if (!isBitset() && count > ARRAY_MAX)
+        toBitset();
+}
+
+bool Bitmap::Chunk::operator ==(const Chunk& other) const
+{
+    return key == other.key && count == other.count && array == other.array && bits == other.bits;
+}
+
+Bitmap::Chunk Bitmap::intersect(const Chunk& L, const Chunk& R)
+{
+    Chunk chunk;
+    chunk.key = L.key;
+
+    if (L.isBitset() && R.isBitset())
+    {
+        chunk.bits.resize(BITSET_WORDS);
+        chunk.count = combine<And>(L.bits.constData(), R.bits.constData(), chunk.bits.data(), BITSET_WORDS);
+        chunk.normalize();
+        return chunk;
+    }
+
+    if (L.isBitset() || R.isBitset())
+    {
+        const Chunk& array = L.isBitset() ? R : L;
+        const Chunk& bitset = L.isBitset() ? L : R;
+        chunk.array.reserve(array.count);
+        for (quint16 low: array.array)
+            if (testBit(bitset.bits, low))
+                chunk.array.append(low);
+        chunk.count = chunk.array.size();
+        return chunk;
+    }
+
+    chunk.array.resize(std::min(L.count, R.count));
+    auto end = std::set_intersection(L.array.cbegin(), L.array.cend(), R.array.cbegin(), R.array.cend(), chunk.array.begin());
+    chunk.array.resize(static_cast<int>(std::distance(chunk.array.begin(), end)));
+    chunk.count = chunk.array.size();
+    return chunk;
+}
+
+Bitmap::Chunk Bitmap::unite(const Chunk& L, const Chunk& R)
+{
+    Chunk chunk;
+    chunk.key = L.key;
+
+    if (L.isBitset() && R.isBitset())
+    {
+        chunk.bits.resize(BITSET_WORDS);
+        chunk.count = combine<Or>(L.bits.constData(), R.bits.constData(), chunk.bits.data(), BITSET_WORDS);
+        return chunk;
+    }
+
+    if (L.isBitset() || R.isBitset())
+    {
+        const Chunk& array = L.isBitset() ? R : L;
+        chunk = L.isBitset() ? L : R;
+        for (quint16 low: array.array)
+            chunk.insert(low);
+        return chunk;
+    }
+
+    chunk.array.resize(L.count + R.count);
+    auto end = std::set_union(L.array.cbegin(), L.array.cend(), R.array.cbegin(), R.array.cend(), chunk.array.begin());
+    chunk.array.resize(static_cast<int>(std::distance(chunk.array.begin(), end)));
+    chunk.count = chunk.array.size();
+    chunk.normalize();
+    return chunk;
+}
+
+Bitmap::Chunk Bitmap::subtract(const Chunk& L, const Chunk& R)
+{
+    Chunk chunk;
+    chunk.key = L.key;
+
+    if (L.isBitset() && R.isBitset())
+    {
+        chunk.bits.resize(BITSET_WORDS);
+        chunk.count = combine<AndNot>(L.bits.constData(), R.bits.constData(), chunk.bits.data(), BITSET_WORDS);
+        chunk.normalize();
+        return chunk;
+    }
+
+    if (L.isBitset())
+    {
+        chunk = L;
+        for (quint16 low: R.array)
+        {
+            quint64& word = chunk.bits[low >> 6];
+            const quint64 mask = quint64(1) << (low & 63);
+            if (word & mask)
+            {
+                word &= ~mask;
+                --chunk.count;
+            }
+        }
+        chunk.normalize();
+        return chunk;
+    }
+
+    if (R.isBitset())
+    {
+        chunk.array.reserve(L.count);
+        for (quint16 low: L.array)
+            if (!testBit(R.bits, low))
+                chunk.array.append(low);
+        chunk.count = chunk.array.size();
+        return chunk;
+    }
+
+    chunk.array.resize(L.count);
+    auto end = std::set_difference(L.array.cbegin(), L.array.cend(), R.array.cbegin(), R.array.cend(), chunk.array.begin());
+    chunk.array.resize(static_cast<int>(std::distance(chunk.array.begin(), end)));
+    chunk.count = chunk.array.size();
+    return chunk;
+}
+
+/// \return index of the chunk with \a key or -(insertion point) - 1
+int Bitmap::find(quint16 key) const
+{
+    auto i = std::lower_bound(mChunks.cbegin(), mChunks.cend(), key, [](const Chunk& chunk, quint16 k){
+        return chunk.key < k; });
+    int index = static_cast<int>(std::distance(mChunks.cbegin(), i));
+    return i != mChunks.cend() && i->key == key ? index : -index - 1;
+}
+
+Bitmap Bitmap::fromWords(const QVector<quint64>& words)
+{
+    Bitmap bitmap;
+    for (int begin = 0; begin < words.size(); begin += BITSET_WORDS)
+    {
+        const int end = std::min(begin + BITSET_WORDS, words.size());
+
+        Chunk chunk;
+        chunk.key = static_cast<quint16>(begin / BITSET_WORDS);
+        chunk.bits.fill(0, BITSET_WORDS);
+        std::copy(words.cbegin() + begin, words.cbegin() + end, chunk.bits.begin());
+        for (int i = 0; i < end - begin; ++i)
+            chunk.count += qPopulationCount(chunk.bits.at(i));
+
+        if (chunk.count == 0)
+            continue;
+
+        chunk.normalize();
+        bitmap.mChunks.append(chunk);
+    }
+    return bitmap;
+}
+
+bool Bitmap::insert(quint32 value)
+{
+    const quint16 key = static_cast<quint16>(value >> 16);
+    int i = find(key);
+    if (i < 0)
+    {
+        i = -i - 1;
+        Chunk chunk;
+        chunk.key = key;
+        mChunks.insert(i, chunk);
+    }
+
+    return mChunks[i].insert(static_cast<quint16>(value & 0xFFFF));
+}
+
+bool Bitmap::remove(quint32 value)
+{
+    int i = find(static_cast<quint16>(value >> 16));
+    if (i < 0)
+        return false;
+
+    if (!mChunks[i].remove(static_cast<quint16>(value & 0xFFFF)))
+        return false;
+
+    if (mChunks.at(i).count == 0)
+        mChunks.removeAt(i);
+
+    return true;
+}
+
+bool Bitmap::contains(quint32 value) const
+{
+    int i = find(static_cast<quint16>(value >> 16));
+    return i >= 0 && mChunks.at(i).contains(static_cast<quint16>(value & 0xFFFF));
+}
+
+int Bitmap::size() const
+{
+    int size = 0;
+    for (const Chunk& chunk: mChunks)
+        size += chunk.count;
+    return size;
+}
+
+QVector<quint32> Bitmap::values() const
+{
+    QVector<quint32> values;
+    values.reserve(size());
+    forEach([&values](quint32 value){ values.append(value); });
+    return values;
+}
+
+Bitmap Bitmap::operator &(const Bitmap& other) const
+{
+    Bitmap result;
+    for (int l = 0, r = 0; l < mChunks.size() && r < other.mChunks.size(); )
+    {
+        const Chunk& L = mChunks.at(l);
+        const Chunk& R = other.mChunks.at(r);
+        if (L.key < R.key)
+        {
+            ++l;
+        }
+        else if (R.key < L.key)
+        {
+            ++r;
+        }
+        else
+        {
+            Chunk chunk = intersect(L, R);
+            if (chunk.count)
+                result.mChunks.append(chunk);
+            ++l, ++r;
+        }
+    }
+    return result;
+}
+
+Bitmap Bitmap::operator |(const Bitmap& other) const
+{
+    Bitmap result;
+    result.mChunks.reserve(std::max(mChunks.size(), other.mChunks.size()));
+
+    int l = 0, r = 0;
+    while (l < mChunks.size() && r < other.mChunks.size())
+    {
+        const Chunk& L = mChunks.at(l);
+        const Chunk& R = other.mChunks.at(r);
+        if (L.key < R.key)
+            result.mChunks.append(L), ++l;
+        else if (R.key < L.key)
+            result.mChunks.append(R), ++r;
+        else
+            result.mChunks.append(unite(L, R)), ++l, ++r;
+    }
+
+    for (; l < mChunks.size(); ++l)
+        result.mChunks.append(mChunks.at(l));
+    for (; r < other.mChunks.size(); ++r)
+        result.mChunks.append(other.mChunks.at(r));
+
+    return result;
+}
+
+Bitmap Bitmap::operator -(const Bitmap& other) const
+{
+    Bitmap result;
+    int r = 0;
+    for (const Chunk& L: mChunks)
+    {
+        while (r < other.mChunks.size() && other.mChunks.at(r).key < L.key)
+            ++r;
+
+        if (r < other.mChunks.size() && other.mChunks.at(r).key == L.key)
+        {
+            Chunk chunk = subtract(L, other.mChunks.at(r));
+            if (chunk.count)
+                result.mChunks.append(chunk);
+        }
+        else
+        {
+            result.mChunks.append(L);
+        }
+    }
+    return result;
+}
+
+bool Bitmap::operator ==(const Bitmap& other) const
+{
+    return mChunks == other.mChunks;
+}
@@ -0,0 +1,95 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <QtAlgorithms>
+#include <QVector>
+
+/// Compressed set of 32-bit values (roaring-style), used for sets of PhotoIds.
+/// Values are grouped into chunks of 65536 by their high 16 bits. A sparse chunk is
+/// a sorted array of the low 16 bits, a dense one is a 65536-bit bitset.
+/// Set operations work chunk by chunk, so their cost depends on the compressed size only.
+class Bitmap
+{
+public:
+    Bitmap() = default;
+
+    /// builds a bitmap from a plain bitset: value i is present if bit i % 64 of words[i / 64] is set
+    static Bitmap fromWords(const QVector<quint64>& words);
+
+    bool insert(quint32 value);
+    bool remove(quint32 value);
+    bool contains(quint32 value) const;
+
+    int size() const;
+    bool isEmpty() const { return mChunks.isEmpty(); }
+    void clear() { mChunks.clear(); }
+
+    QVector<quint32> values() const;
+
+    /// calls \a f for every value in ascending order
+    template <typename F>
+    void forEach(F f) const;
+
+    Bitmap operator &(const Bitmap& other) const;
+    Bitmap operator |(const Bitmap& other) const;
+    Bitmap operator -(const Bitmap& other) const;
+
+    Bitmap& operator &=(const Bitmap& other) { return *this = *this & other; }
+    Bitmap& operator |=(const Bitmap& other) { return *this = *this | other; }
+    Bitmap& operator -=(const Bitmap& other) { return *this = *this - other; }
+
+    bool operator ==(const Bitmap& other) const;
+    bool operator !=(const Bitmap& other) const { return !(*this == other); }
+
+private:
+    static constexpr int ARRAY_MAX = 4096;         // a bigger chunk takes less memory as a bitset
+    static constexpr int BITSET_WORDS = 65536 / 64;
+
+    struct Chunk
+    {
+        quint16 key = 0;
+        int count = 0;
+        QVector<quint16> array; // sorted, used while count <= ARRAY_MAX
+        QVector<quint64> bits;  // BITSET_WORDS words otherwise
+
+        bool isBitset() const { return !bits.isEmpty(); }
+        bool contains(quint16 low) const;
+        bool insert(quint16 low);
+        bool remove(quint16 low);
+        void toBitset();
+        void toArray();
+        void normalize();
+
+        bool operator ==(const Chunk& other) const;
+    };
+
+    static Chunk intersect(const Chunk& L, const Chunk& R);
+    static Chunk unite(const Chunk& L, const Chunk& R);
+    static Chunk subtract(const Chunk& L, const Chunk& R);
+
+    int find(quint16 key) const;
+
+    QVector<Chunk> mChunks; // sorted by key, none is empty
+};
+
+template <typename F>
+void Bitmap::forEach(F f) const
+{
+    for (const Chunk& chunk: mChunks)
+    {
+        const quint32 high = static_cast<quint32>(chunk.key) << 16;
+        if (chunk.isBitset())
+        {
+            for (int w = 0; w < BITSET_WORDS; ++w)
+                for (quint64 word = chunk.bits.at(w); word; word &= word - 1)
+                    f(high | static_cast<quint32>(w * 64 + qCountTrailingZeroBits(word)));
+        }
+        else
+        {
+            for (quint16 low: chunk.array)
+                f(high | low);
+        }
+    }
+}
+
+#endif // BITMAP_H
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CATALOG_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "catalog.h"
+#include "exifstorage.h"
+
+constexpr qint64 Catalog::INVALID_TIME;
+
+namespace
+{
+
+const int KEYWORD_SLACK = 4096;         // replaced keyword ids kept before the slices are compacted
+
+/// evaluates \a predicate for rows [0, rows) into a plain bitset, 64 rows per word;
+/// the inner loop has no branches, so the compiler is free to vectorize it
+template <typename Predicate>
+QVector<quint64> scan(int rows, Predicate predicate)
+{
+    QVector<quint64> words((rows + 63) / 64, 0);
+    quint64* out = words.data();
+    for (int w = 0; w < words.size(); ++w)
+    {
+        const int begin = w * 64;
+        const int count = std::min(64, rows - begin);
+        quint64 word = 0;
+        for (int i = 0; i < count; ++i)
+            word |= quint64(predicate(begin + i)) << i;
+        out[w] = word;
+    }
+    return words;
+}
+
+} // namespace
+
+void Catalog::set(const Photo& photo, QMap<KeywordId, int>* counts)
+{
+    const PhotoId id = photo.id;
+    if (id == INVALID_PHOTO_ID)
+        return;
+
+    if (rows() <= static_cast<int>(id))
+        resize(id + 1);
+
+    // the file may be parsed again after its keywords have been edited
+    if (mIds.contains(id))
+    {
+        const KeywordId* begin = mKeywordData.constData() + mKeywordOffset.at(id);
+        for (const KeywordId* keyword = begin; keyword != begin + mKeywordCount.at(id); ++keyword)
+            if (mKeywords[*keyword].remove(id) && counts)
+                (*counts)[*keyword] = mKeywords.at(*keyword).size();
+    }
+
+    if (mIds.contains(id))
+        mTimeIndex.remove(id, mTime.at(id));
+    mTimeIndex.insert(id, photo.time);
+
+    const bool located = !photo.position.isNull();
+    mLat[id] = located ? photo.position.x() : std::nan("");
+    mLon[id] = located ? photo.position.y() : std::nan("");
+    mTime[id] = photo.time;
+    mOrientation[id] = photo.orientation;
+
+    // reuse the old slice if the new list fits
+    const int count = std::min(photo.keywords.size(), int(std::numeric_limits<quint16>::max()));
+    if (count > mKeywordCount.at(id))
+    {
+        mKeywordGarbage += mKeywordCount.at(id);
+        mKeywordOffset[id] = static_cast<quint32>(mKeywordData.size());
+        mKeywordData.resize(mKeywordData.size() + count);
+    }
+    else
+    {
+        mKeywordGarbage += mKeywordCount.at(id) - count;
+    }
+    mKeywordCount[id] = static_cast<quint16>(count);
+    std::copy(photo.keywords.cbegin(), photo.keywords.cbegin() + count, mKeywordData.begin() + mKeywordOffset.at(id));
+
+    for (int i = 0; i < count; ++i)
+    {
+        const KeywordId keyword = photo.keywords.at(i);
+        if (mKeywords.size() <= static_cast<int>(keyword))
+            mKeywords.resize(keyword + 1);
+        mKeywords[keyword].insert(id);
+        if (counts)
+            (*counts)[keyword] = mKeywords.at(keyword).size();
+    }
+
+    mIds.insert(id);
+
+    if (mKeywordGarbage > KEYWORD_SLACK && mKeywordGarbage * 2 > mKeywordData.size())
+        compactKeywords();
+}
+
+QPointF Catalog::position(PhotoId id) const
+{
+    if (!mIds.contains(id) || std::isnan(mLat.at(id)))
+        return {};
+    return QPointF(mLat.at(id), mLon.at(id));
+}
+
+qint64 Catalog::time(PhotoId id) const
+{
+    return mIds.contains(id) ? mTime.at(id) : INVALID_TIME;
+}
+
+KeywordIdList Catalog::keywords(PhotoId id) const
+{
+    if (!mIds.contains(id))
+        return {};
+
+    const KeywordId* begin = mKeywordData.constData() + mKeywordOffset.at(id);
+    KeywordIdList keywords(mKeywordCount.at(id));
+    std::copy(begin, begin + keywords.size(), keywords.begin());
+    return keywords;
+}
+
+const Bitmap& Catalog::tagged(KeywordId keyword) const
+{
+    static const Bitmap empty;
+    return keyword < static_cast<KeywordId>(mKeywords.size()) ? mKeywords.at(keyword) : empty;
+}
+
+/// \return all the keywords used by at least one photo
+KeywordIdList Catalog::keywords() const
+{
+    KeywordIdList keywords;
+    for (int i = 0; i < mKeywords.size(); ++i)
+        if (!mKeywords.at(i).isEmpty())
+            keywords.append(static_cast<KeywordId>(i));
+    return keywords;
+}
+
+Bitmap Catalog::select(const CatalogQuery& query) const
+{
+    using Op = CatalogQuery::Op;
+
+    switch (query.op())
+    {
+    case Op::Keyword:
+        return tagged(query.keyword());
+
+    case Op::Area:
+        return Bitmap::fromWords(scanArea(query.bounds())) & mIds;
+
+    case Op::Period:
+        return query.from() < query.to() ? mTimeIndex.select({ query.from(), query.to() }) : Bitmap();
+
+    case Op::Orientation:
+        return Bitmap::fromWords(scanOrientation(query.orientation())) & mIds;
+
+    case Op::Not:
+        return mIds - select(query.operands().front());
+
+    case Op::And:
+    {
+        // NOT operands are subtracted instead of being complemented against all the photos
+        std::vector<const CatalogQuery*> positive, negative;
+        for (const auto& operand: query.operands())
+            (operand.op() == Op::Not ? negative : positive).push_back(&operand);
+
+        if (positive.empty() && negative.empty())
+            return {};
+
+        Bitmap result = positive.empty() ? mIds : select(*positive.front());
+        for (size_t i = 1; i < positive.size() && !result.isEmpty(); ++i)
+            result &= select(*positive[i]);
+        for (size_t i = 0; i < negative.size() && !result.isEmpty(); ++i)
+            result -= select(negative[i]->operands().front());
+        return result;
+    }
+
+    case Op::Or:
+    {
+        Bitmap result;
+        for (const CatalogQuery& operand: query.operands())
+            result |= select(operand);
+        return result;
+    }
+    }
+
+    return {};
+}
+
+void Catalog::resize(int rows)
+{
+    mLat.resize(rows);
+    mLon.resize(rows);
+    mTime.resize(rows);
+    mOrientation.resize(rows);
+    mKeywordOffset.resize(rows);
+    mKeywordCount.resize(rows);
+}
+
+/// packs the keyword slices of the photos back to back, once the replaced ones take more than the rest
+void Catalog::compactKeywords()
+{
+    QVector<KeywordId> data;
+    data.reserve(mKeywordData.size() - mKeywordGarbage);
+
+    mIds.forEach([this, &data](PhotoId id){
+        const KeywordId* begin = mKeywordData.constData() + mKeywordOffset.at(id);
+        mKeywordOffset[id] = static_cast<quint32>(data.size());
+        for (const KeywordId* keyword = begin; keyword != begin + mKeywordCount.at(id); ++keyword)
+            data.append(*keyword);
+    });
+
+    mKeywordData.swap(data);
+    mKeywordGarbage = 0;
+}
+
+QVector<quint64> Catalog::scanArea(const QRectF& bounds) const
+{
+    const QRectF r = bounds.normalized();
+    const double* lat = mLat.constData();
+    const double* lon = mLon.constData();
+
+#ifdef CATALOG_SSE2
+    // two rows per register; NaN coordinates never compare true
+    QVector<quint64> words((rows() + 63) / 64, 0);
+    quint64* out = words.data();
+    const __m128d latMin = _mm_set1_pd(r.left()), latMax = _mm_set1_pd(r.right());
+    const __m128d lonMin = _mm_set1_pd(r.top()), lonMax = _mm_set1_pd(r.bottom());
+
+    int i = 0;
+    for (; i + 1 < rows(); i += 2)
+    {
+        const __m128d la = _mm_loadu_pd(lat + i);
+        const __m128d lo = _mm_loadu_pd(lon + i);
+        const __m128d mask = _mm_and_pd(_mm_and_pd(_mm_cmpge_pd(la, latMin), _mm_cmple_pd(la, latMax)),
+                                        _mm_and_pd(_mm_cmpge_pd(lo, lonMin), _mm_cmple_pd(lo, lonMax)));
+        out[i >> 6] |= quint64(_mm_movemask_pd(mask)) << (i & 63);
+    }
+
+    if (i < rows() && lat[i] >= r.left() && lat[i] <= r.right() && lon[i] >= r.top() && lon[i] <= r.bottom())
+        out[i >> 6] |= quint64(1) << (i & 63);
+
+    return words;
+#else
+    return scan(rows(), [=](int i) {
+        return (lat[i] >= r.left()) & (lat[i] <= r.right()) & (lon[i] >= r.top()) & (lon[i] <= r.bottom()); });
+#endif
+}
+
+QVector<quint64> Catalog::scanOrientation(quint16 orientation) const
+{
+    const quint16* value = mOrientation.constData();
+    return scan(rows(), [=](int i) { return value[i] == orientation; });
+}
+
+CatalogQuery CatalogQuery::tagged(KeywordId keyword)
+{
+    CatalogQuery query(Op::Keyword);
+    query.mKeyword = keyword;
+    return query;
+}
+
+CatalogQuery CatalogQuery::within(const QRectF& bounds)
+{
+    CatalogQuery query(Op::Area);
+    query.mBounds = bounds;
+    return query;
+}
+
+CatalogQuery CatalogQuery::between(qint64 from, qint64 to)
+{
+    CatalogQuery query(Op::Period);
+    query.mFrom = from;
+    query.mTo = to;
+    return query;
+}
+
+CatalogQuery CatalogQuery::oriented(quint16 orientation)
+{
+    CatalogQuery query(Op::Orientation);
+    query.mOrientation = orientation;
+    return query;
+}
+
+CatalogQuery CatalogQuery::all(const std::vector<CatalogQuery>& operands)
+{
+    CatalogQuery query(Op::And);
+    query.mOperands = operands;
+    return query;
+}
+
+CatalogQuery CatalogQuery::any(const std::vector<CatalogQuery>& operands)
+{
+    CatalogQuery query(Op::Or);
+    query.mOperands = operands;
+    return query;
+}
+
+CatalogQuery CatalogQuery::negate(const CatalogQuery& operand)
+{
+    CatalogQuery query(Op::Not);
+    query.mOperands = { operand };
+    return query;
+}
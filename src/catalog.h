@@ -0,0 +1,104 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <QMap>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+#include <vector>
+
+#include "bitmap.h"
+#include "photoid.h"
+#include "timeindex.h"
+
+struct Photo;
+
+/// compound predicate over the catalog columns,
+/// e.g. taken in 2019 AND within the bounds AND tagged "family";
+/// the keyword filter of the UI is one of them, an AND or OR of tagged()
+class CatalogQuery
+{
+public:
+    enum class Op { Keyword, Area, Period, Orientation, And, Or, Not };
+
+    /// none of the photos for an unknown \a keyword
+    static CatalogQuery tagged(KeywordId keyword);
+    /// \a bounds are in Photo::position coordinates: x is latitude, y is longitude
+    static CatalogQuery within(const QRectF& bounds);
+    /// [from, to) in msecs since epoch
+    static CatalogQuery between(qint64 from, qint64 to);
+    static CatalogQuery oriented(quint16 orientation);
+
+    static CatalogQuery all(const std::vector<CatalogQuery>& operands);
+    static CatalogQuery any(const std::vector<CatalogQuery>& operands);
+    static CatalogQuery negate(const CatalogQuery& operand);
+
+    Op op() const { return mOp; }
+    KeywordId keyword() const { return mKeyword; }
+    const QRectF& bounds() const { return mBounds; }
+    qint64 from() const { return mFrom; }
+    qint64 to() const { return mTo; }
+    quint16 orientation() const { return mOrientation; }
+    const std::vector<CatalogQuery>& operands() const { return mOperands; }
+
+private:
+    explicit CatalogQuery(Op op) : mOp(op) {}
+
+    Op mOp;
+    KeywordId mKeyword = INVALID_PHOTO_ID;
+    QRectF mBounds;
+    qint64 mFrom = 0, mTo = 0;
+    quint16 mOrientation = 0;
+    std::vector<CatalogQuery> mOperands;
+};
+
+
+/// Struct-of-arrays photo metadata indexed by PhotoId.
+/// Every attribute is a contiguous column, so a predicate is a tight branchless loop
+/// over one or two columns producing 64 rows of the result per word.
+/// Not thread safe: ExifStorage guards it with its mutex.
+class Catalog
+{
+public:
+    static constexpr qint64 INVALID_TIME = TimeIndex::INVALID_TIME;
+
+    /// puts the photo to its row; \a counts receives the new size of every keyword touched
+    void set(const Photo& photo, QMap<KeywordId, int>* counts = nullptr);
+
+    const Bitmap& ids() const { return mIds; }
+    bool contains(PhotoId id) const { return mIds.contains(id); }
+
+    QPointF position(PhotoId id) const;
+    qint64 time(PhotoId id) const;
+    KeywordIdList keywords(PhotoId id) const;
+
+    const Bitmap& tagged(KeywordId keyword) const;
+    KeywordIdList keywords() const;
+
+    const TimeIndex& timeIndex() const { return mTimeIndex; }
+
+    Bitmap select(const CatalogQuery& query) const;
+
+private:
+    int rows() const { return mLat.size(); }
+    void resize(int rows);
+    void compactKeywords();
+
+    QVector<quint64> scanArea(const QRectF& bounds) const;
+    QVector<quint64> scanOrientation(quint16 orientation) const;
+
+    QVector<double> mLat, mLon;          // NaN if the photo has no coordinates
+    QVector<qint64> mTime;               // msecs since epoch or INVALID_TIME
+    QVector<quint16> mOrientation;
+    QVector<quint32> mKeywordOffset;     // the photo keywords are
+    QVector<quint16> mKeywordCount;      // mKeywordData[offset, offset + count)
+    QVector<KeywordId> mKeywordData;
+    int mKeywordGarbage = 0;             // of mKeywordData, left behind by the lists that were replaced
+
+    Bitmap mIds;                         // rows holding a photo
+    QVector<Bitmap> mKeywords;           // inverted index, indexed by KeywordId
+    TimeIndex mTimeIndex;                // sorted mTime
+};
+
+#endif // CATALOG_H
@@ -0,0 +1,401 @@
+#include <QtAlgorithms>
+#include <QtMath>
+
+#include <algorithm>
+
+#include "clusters.h"
+
+namespace Mercator
+{
+
+QPointF project(const QPointF& position)
+{
+    const double latitude = qDegreesToRadians(std::max(-MAX_LATITUDE, std::min(position.x(), MAX_LATITUDE)));
+    const double x = (position.y() + 180) / 360;
+    const double y = 0.5 - std::log(std::tan(M_PI / 4 + latitude / 2)) / (2 * M_PI);
+    return QPointF(x * TILE, y * TILE);
+}
+
+QPointF unproject(const QPointF& point)
+{
+    const double longitude = point.x() / TILE * 360 - 180;
+    const double latitude = 2 * std::atan(std::exp((0.5 - point.y() / TILE) * 2 * M_PI)) - M_PI / 2;
+    return QPointF(qRadiansToDegrees(latitude), longitude);
+}
+
+Point world(const QPointF& position)
+{
+    const QPointF point = project(position);
+    return world(point.x(), point.y());
+}
+
+QPointF projected(const Point& point)
+{
+    const double f = scale(WORLD_ZOOM);
+    return QPointF(point.x / f, point.y / f);
+}
+
+Point world(double x, double y)
+{
+    const double f = scale(WORLD_ZOOM);
+    const auto clamp = [](double v){ return static_cast<quint32>(std::max(0.0, std::min(v, 4294967295.0))); };
+    return { clamp(x * f), clamp(y * f) };
+}
+
+} // namespace Mercator
+
+
+#if defined(__AVX2__)
+#  define CLUSTERS_AVX2
+#  define CLUSTERS_AVX2_TARGET
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define CLUSTERS_AVX2
+#  define CLUSTERS_AVX2_RUNTIME
+#  define CLUSTERS_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#ifdef CLUSTERS_AVX2
+#include <immintrin.h>
+
+namespace
+{
+
+CLUSTERS_AVX2_TARGET
+int nearestAvx2(const Mercator::Point* points, int n, Mercator::Point point, int shift, quint32 radius, quint32* distance)
+{
+    const __m256i px = _mm256_set1_epi32(static_cast<int>(point.x));
+    const __m256i py = _mm256_set1_epi32(static_cast<int>(point.y));
+    const __m256i r = _mm256_set1_epi32(static_cast<int>(radius));
+    const __m128i s = _mm_cvtsi32_si128(shift);
+
+    quint32 limit = *distance;
+    int best = -1;
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        // x0 y0 .. x3 y3 | x4 y4 .. x7 y7 -> x0 .. x7, y0 .. y7
+        const __m256 lo = _mm256_loadu_ps(reinterpret_cast<const float*>(points + i));
+        const __m256 hi = _mm256_loadu_ps(reinterpret_cast<const float*>(points + i + 4));
+        const __m256i x = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256i y = _mm256_permute4x64_epi64(_mm256_castps_si256(_mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0));
+
+        // unsigned |a - b| in the pixels of the level, clamped to the radius so that the squares don't overflow;
+        // a clamped one is at least radius^2 away, which the limit never accepts
+        const __m256i dx = _mm256_min_epu32(_mm256_srl_epi32(_mm256_sub_epi32(_mm256_max_epu32(x, px), _mm256_min_epu32(x, px)), s), r);
+        const __m256i dy = _mm256_min_epu32(_mm256_srl_epi32(_mm256_sub_epi32(_mm256_max_epu32(y, py), _mm256_min_epu32(y, py)), s), r);
+        const __m256i d = _mm256_add_epi32(_mm256_mullo_epi32(dx, dx), _mm256_mullo_epi32(dy, dy));
+
+        quint32 mask = static_cast<quint32>(_mm256_movemask_ps(_mm256_castsi256_ps(
+                           _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(limit)), d))));
+        if (!mask)
+            continue;
+
+        alignas(32) quint32 lanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), d);
+        for (; mask; mask &= mask - 1)
+        {
+            const int lane = qCountTrailingZeroBits(mask);
+            if (lanes[lane] < limit)
+            {
+                limit = lanes[lane];
+                best = i + lane;
+            }
+        }
+    }
+
+    const int tail = nearestScalar(points + i, n - i, point, shift, radius, &limit);
+    if (tail != -1)
+        best = i + tail;
+
+    *distance = limit;
+    return best;
+}
+
+} // namespace
+#endif
+
+int nearest(const Mercator::Point* points, int n, Mercator::Point point, int shift, quint32 radius, quint32* distance)
+{
+#ifdef CLUSTERS_AVX2
+#ifdef CLUSTERS_AVX2_RUNTIME
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+#else
+    static const bool avx2 = true;
+#endif
+    if (avx2 && n >= 8)
+        return nearestAvx2(points, n, point, shift, radius, distance);
+#endif
+    return nearestScalar(points, n, point, shift, radius, distance);
+}
+
+int nearestScalar(const Mercator::Point* points, int n, Mercator::Point point, int shift, quint32 radius, quint32* distance)
+{
+    quint32 limit = *distance;
+    int best = -1;
+
+    for (int i = 0; i < n; ++i)
+    {
+        const Mercator::Point& p = points[i];
+        const quint32 dx = (p.x > point.x ? p.x - point.x : point.x - p.x) >> shift;
+        const quint32 dy = (p.y > point.y ? p.y - point.y : point.y - p.y) >> shift;
+        if (dx >= radius || dy >= radius)
+            continue;
+
+        const quint32 d = dx * dx + dy * dy;
+        if (d < limit)
+        {
+            limit = d;
+            best = i;
+        }
+    }
+
+    *distance = limit;
+    return best;
+}
+
+
+void SpatialHash::insert(int item, Mercator::Point point)
+{
+    Cell& cell = mCells[keyOf(point)];
+    cell.items.append(item);
+    cell.points.append(point);
+}
+
+bool SpatialHash::remove(int item, Mercator::Point point)
+{
+    auto it = mCells.find(keyOf(point));
+    if (it == mCells.end())
+        return false;
+
+    Cell& cell = *it;
+    const int i = cell.items.indexOf(item);
+    if (i == -1)
+        return false;
+
+    // the order within a cell doesn't matter
+    cell.items[i] = cell.items.last();
+    cell.points[i] = cell.points.last();
+    cell.items.removeLast();
+    cell.points.removeLast();
+
+    if (cell.items.isEmpty())
+        mCells.erase(it);
+    return true;
+}
+
+void SpatialHash::move(int item, Mercator::Point from, Mercator::Point to)
+{
+    if (keyOf(from) != keyOf(to))
+    {
+        remove(item, from);
+        insert(item, to);
+        return;
+    }
+
+    auto it = mCells.find(keyOf(from));
+    if (it == mCells.end())
+        return;
+
+    const int i = it->items.indexOf(item);
+    if (i != -1)
+        it->points[i] = to;
+}
+
+int SpatialHash::nearest(Mercator::Point point, int shift, quint32 radius) const
+{
+    const quint64 reach = static_cast<quint64>(radius) << shift;
+    const quint64 max = 0xffffffffu;
+    const quint64 x0 = point.x > reach ? point.x - reach : 0, x1 = std::min(point.x + reach, max);
+    const quint64 y0 = point.y > reach ? point.y - reach : 0, y1 = std::min(point.y + reach, max);
+
+    int best = -1;
+    quint32 distance = radius * radius;
+    for (quint64 y = y0 >> mShift; y <= (y1 >> mShift); ++y)
+        for (quint64 x = x0 >> mShift; x <= (x1 >> mShift); ++x)
+        {
+            auto it = mCells.constFind(key(static_cast<quint32>(x), static_cast<quint32>(y)));
+            if (it == mCells.cend())
+                continue;
+
+            const int i = ::nearest(it->points.constData(), it->points.size(), point, shift, radius, &distance);
+            if (i != -1)
+                best = it->items.at(i);
+        }
+
+    return best;
+}
+
+
+constexpr int ClusterIndex::MIN_LEVEL;
+constexpr int ClusterIndex::MAX_LEVEL;
+
+ClusterIndex::ClusterIndex(int radius) : mRadius(radius)
+{
+    clear();
+}
+
+bool ClusterIndex::insert(PhotoId id, const QPointF& position)
+{
+    if (id == INVALID_PHOTO_ID || contains(id))
+        return false;
+
+    if (static_cast<int>(id) >= mPoints.size())
+    {
+        const int size = std::max(static_cast<int>(id) + 1, mPoints.size() * 2);
+        mPoints.resize(size);
+        for (Level& level: mLevels)
+        {
+            const int old = level.mOwner.size();
+            level.mOwner.resize(size);
+            level.mSlot.resize(size);
+            std::fill(level.mOwner.begin() + old, level.mOwner.end(), -1);
+        }
+    }
+
+    const Mercator::Point point = Mercator::world(position);
+    mPoints[id] = point;
+
+    for (int z = MIN_LEVEL; z <= MAX_LEVEL; ++z)
+    {
+        Level& level = mLevels[z];
+        int index = level.mGrid.nearest(point, Mercator::WORLD_ZOOM - z, mRadius);
+
+        if (index == -1)
+        {
+            if (level.mFree.isEmpty())
+            {
+                index = level.mClusters.size();
+                level.mClusters.append(Cluster());
+            }
+            else
+            {
+                index = level.mFree.takeLast();
+            }
+
+            Cluster& cluster = level.mClusters[index];
+            level.mSlot[id] = cluster.photos.size();
+            cluster.photos.append(id);
+            cluster.point = point;
+            cluster.sumX = point.x;
+            cluster.sumY = point.y;
+            level.mGrid.insert(index, point);
+        }
+        else
+        {
+            Cluster& cluster = level.mClusters[index];
+            const Mercator::Point before = cluster.point;
+            level.mSlot[id] = cluster.photos.size();
+            cluster.photos.append(id);
+            cluster.sumX += point.x;
+            cluster.sumY += point.y;
+            cluster.point = { static_cast<quint32>(cluster.sumX / cluster.photos.size()), static_cast<quint32>(cluster.sumY / cluster.photos.size()) };
+            level.mGrid.move(index, before, cluster.point);
+        }
+
+        level.mOwner[id] = index;
+    }
+
+    ++mSize;
+    return true;
+}
+
+bool ClusterIndex::remove(PhotoId id)
+{
+    if (id == INVALID_PHOTO_ID || !contains(id))
+        return false;
+
+    const Mercator::Point point = mPoints.at(id);
+
+    for (Level& level: mLevels)
+    {
+        const int index = level.mOwner.at(id);
+        level.mOwner[id] = -1;
+
+        Cluster& cluster = level.mClusters[index];
+        const Mercator::Point before = cluster.point;
+
+        // the last photo takes the place of the removed one, the first one stays unless it is removed
+        const PhotoId last = cluster.photos.takeLast();
+        if (last != id)
+        {
+            const int slot = level.mSlot.at(id);
+            cluster.photos[slot] = last;
+            level.mSlot[last] = slot;
+        }
+
+        if (!cluster.photos.isEmpty())
+        {
+            cluster.sumX -= point.x;
+            cluster.sumY -= point.y;
+            cluster.point = { static_cast<quint32>(cluster.sumX / cluster.photos.size()), static_cast<quint32>(cluster.sumY / cluster.photos.size()) };
+            level.mGrid.move(index, before, cluster.point);
+        }
+        else
+        {
+            level.mGrid.remove(index, before);
+            cluster = Cluster();
+            level.mFree.append(index);
+        }
+    }
+
+    --mSize;
+    return true;
+}
+
+bool ClusterIndex::apply(QHash<PhotoId, QPointF>* changes, const std::function<bool()>& cancelled)
+{
+    PhotoIdList ids = changes->keys().toVector();
+    std::sort(ids.begin(), ids.end());
+
+    // the photos gone or moved are removed first, the ones staying where they are are done
+    for (PhotoId id: ids)
+    {
+        const QPointF position = changes->value(id);
+        if (contains(id) && (position.isNull() || Mercator::world(position) != mPoints.at(id)))
+        {
+            if (cancelled && cancelled())
+                return false;
+            remove(id);
+        }
+
+        if (position.isNull() || contains(id))
+            changes->remove(id);
+    }
+
+    // then the new ones are inserted in the order of their ids
+    for (PhotoId id: ids)
+    {
+        auto it = changes->find(id);
+        if (it == changes->end())
+            continue;
+
+        if (cancelled && cancelled())
+            return false;
+        insert(id, *it);
+        changes->erase(it);
+    }
+
+    return true;
+}
+
+void ClusterIndex::clear()
+{
+    // cells of at least twice the radius, in world pixels
+    int bits = 0;
+    while ((1 << bits) < 2 * mRadius)
+        ++bits;
+
+    mLevels.clear();
+    mLevels.resize(MAX_LEVEL + 1);
+    for (int z = MIN_LEVEL; z <= MAX_LEVEL; ++z)
+        mLevels[z].mGrid = SpatialHash(std::min(Mercator::WORLD_ZOOM - z + bits, 31));
+
+    mPoints.clear();
+    mSize = 0;
+}
+
+int ClusterIndex::level(double zoom)
+{
+    return std::max(MIN_LEVEL, std::min(static_cast<int>(std::floor(zoom)), MAX_LEVEL));
+}
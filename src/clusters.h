@@ -0,0 +1,208 @@
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+#include <QHash>
+#include <QPointF>
+#include <QRectF>
+#include <QVector>
+
+#include <cmath>
+#include <functional>
+
+#include "photoid.h"
+
+/// Web Mercator, the projection of the map tiles:
+/// the world is TILE x TILE px at zoom 0 and 2^zoom times bigger at zoom, x grows to the east, y to the south;
+/// so the distance of two projected points times 2^zoom is their distance on the screen
+namespace Mercator
+{
+
+constexpr double TILE = 256;
+constexpr double MAX_LATITUDE = 85.05112878;
+
+/// the world pixels of this zoom fill 32 bits: 256 * 2^24 = 2^32
+constexpr int WORLD_ZOOM = 24;
+
+/// a position in the world pixels of WORLD_ZOOM; the pixels of the zoom z are these >> (WORLD_ZOOM - z)
+struct Point
+{
+    quint32 x = 0;
+    quint32 y = 0;
+
+    bool operator ==(const Point& other) const { return x == other.x && y == other.y; }
+    bool operator !=(const Point& other) const { return !(*this == other); }
+};
+
+/// \a position is (latitude, longitude) in degrees, as Photo::position
+QPointF project(const QPointF& position);
+QPointF unproject(const QPointF& point);
+
+/// \a position projected to the world pixels, once, so clustering compares integers only
+Point world(const QPointF& position);
+/// the world pixel \a point in the zoom 0 pixels of project()
+QPointF projected(const Point& point);
+/// the zoom 0 pixel \a point in the world pixels, clamped to the world
+Point world(double x, double y);
+
+inline double scale(double zoom) { return std::exp2(zoom); }
+
+} // namespace Mercator
+
+
+/// \return the index of the one of \a n \a points nearest to \a point and closer than \a radius pixels
+/// of the zoom WORLD_ZOOM - \a shift, or -1; \a distance is the squared distance to beat on input
+/// (radius^2 at most) and the found one on output. Runs 8 points at a time with AVX2 if the CPU has it.
+int nearest(const Mercator::Point* points, int n, Mercator::Point point, int shift, quint32 radius, quint32* distance);
+int nearestScalar(const Mercator::Point* points, int n, Mercator::Point point, int shift, quint32 radius, quint32* distance);
+
+
+/// Items at world pixel points hashed by square cells of 2^shift world pixels;
+/// with cells at least twice the search radius, the items near a point are in the 2 x 2 cells around it.
+/// The points of a cell are kept contiguously for ::nearest().
+class SpatialHash
+{
+public:
+    explicit SpatialHash(int shift = 31) : mShift(shift) {}
+
+    int shift() const { return mShift; }
+
+    void insert(int item, Mercator::Point point);
+    bool remove(int item, Mercator::Point point);
+    void move(int item, Mercator::Point from, Mercator::Point to);
+    void clear() { mCells.clear(); }
+
+    /// \return the item nearest to the \a point closer than \a radius pixels of the zoom WORLD_ZOOM - \a shift, -1 if none
+    int nearest(Mercator::Point point, int shift, quint32 radius) const;
+
+    /// calls \a f for the items inside [\a from, \a to]
+    template<typename F>
+    void forIn(Mercator::Point from, Mercator::Point to, F f) const
+    {
+        for (quint64 y = from.y >> mShift, y1 = to.y >> mShift; y <= y1; ++y)
+            for (quint64 x = from.x >> mShift, x1 = to.x >> mShift; x <= x1; ++x)
+            {
+                auto it = mCells.constFind(key(static_cast<quint32>(x), static_cast<quint32>(y)));
+                if (it == mCells.cend())
+                    continue;
+
+                const Cell& cell = *it;
+                for (int i = 0; i < cell.items.size(); ++i)
+                {
+                    const Mercator::Point& p = cell.points.at(i);
+                    if (p.x >= from.x && p.x <= to.x && p.y >= from.y && p.y <= to.y)
+                        f(cell.items.at(i));
+                }
+            }
+    }
+
+private:
+    struct Cell
+    {
+        QVector<int> items;
+        QVector<Mercator::Point> points;
+    };
+
+    static quint64 key(quint32 x, quint32 y) { return (static_cast<quint64>(y) << 32) | x; }
+    quint64 keyOf(Mercator::Point point) const { return key(point.x >> mShift, point.y >> mShift); }
+
+    QHash<quint64, Cell> mCells;
+    int mShift;
+};
+
+
+/// Clusters of photos for every integer zoom level, so that changing the zoom only selects a level.
+/// Every level is clustered greedily: a photo joins the nearest cluster closer than the radius
+/// in screen pixels, or starts a new one; the clusters are found through a SpatialHash per level.
+/// Positions are projected to world pixels once, on insert, and compared as integers.
+/// Inserting and removing a photo is O(levels) and keeps the other photos in their clusters.
+/// A freed cluster leaves an empty slot, so cluster indexes never move.
+/// The data of every level is implicitly shared: a copy of a Level costs nothing
+/// until the index changes, then only that level is detached.
+class ClusterIndex
+{
+public:
+    static constexpr int MIN_LEVEL = 0;
+    static constexpr int MAX_LEVEL = 20;
+
+    struct Cluster
+    {
+        PhotoIdList photos;     // the first one is shown
+        Mercator::Point point;  // mean world position
+        quint64 sumX = 0;
+        quint64 sumY = 0;
+
+        bool isEmpty() const { return photos.isEmpty(); }
+        QPointF projected() const { return Mercator::projected(point); }
+        /// latitude and longitude of the point, unprojected on demand only
+        QPointF position() const { return Mercator::unproject(projected()); }
+    };
+
+    /// the clusters of one zoom level
+    class Level
+    {
+    public:
+        /// the clusters, empty ones included
+        const QVector<Cluster>& clusters() const { return mClusters; }
+
+        /// \return the cluster of the photo, -1 if there is no such photo
+        int cluster(PhotoId id) const { return id < static_cast<PhotoId>(mOwner.size()) ? mOwner.at(id) : -1; }
+
+        /// calls \a f for the clusters inside the \a rect of zoom 0 pixels
+        template<typename F>
+        void forIn(const QRectF& rect, F f) const
+        {
+            if (rect.right() >= 0 && rect.left() <= Mercator::TILE && rect.bottom() >= 0 && rect.top() <= Mercator::TILE)
+                mGrid.forIn(Mercator::world(rect.left(), rect.top()), Mercator::world(rect.right(), rect.bottom()), f);
+        }
+
+    private:
+        friend class ClusterIndex;
+
+        QVector<Cluster> mClusters;
+        QVector<int> mFree;         // empty clusters
+        QVector<qint32> mOwner;     // cluster by PhotoId, -1 if none
+        QVector<qint32> mSlot;      // index in the photos of its cluster by PhotoId, for removing in O(1)
+        SpatialHash mGrid;
+    };
+
+    /// photos closer than \a radius screen pixels are clustered
+    explicit ClusterIndex(int radius);
+
+    bool insert(PhotoId id, const QPointF& position);
+    bool remove(PhotoId id);
+    void clear();
+
+    /// applies the \a changes, positions (latitude, longitude) by photo: a null one removes the photo,
+    /// another one inserts or moves it; the photos gone or moved are removed first, then the new ones
+    /// are inserted in the order of their ids; the applied changes are taken out of \a changes
+    /// \return false if \a cancelled returned true midway, the index is then only partly updated but consistent,
+    /// and the rest of the \a changes can be applied later
+    bool apply(QHash<PhotoId, QPointF>* changes, const std::function<bool()>& cancelled = {});
+
+    bool contains(PhotoId id) const { return cluster(id, MAX_LEVEL) != -1; }
+    Mercator::Point point(PhotoId id) const { return contains(id) ? mPoints.at(id) : Mercator::Point(); }
+    int size() const { return mSize; }
+
+    /// the level drawn at the \a zoom: clusters of a level don't overlap at any bigger zoom
+    static int level(double zoom);
+
+    const Level& at(int level) const { return mLevels.at(level); }
+
+    /// the clusters of the \a level, empty ones included
+    const QVector<Cluster>& clusters(int level) const { return at(level).clusters(); }
+
+    /// \return the cluster of the photo at the \a level, -1 if there is no such photo
+    int cluster(PhotoId id, int level) const { return at(level).cluster(id); }
+
+    /// calls \a f for the clusters of the \a level inside the \a rect of zoom 0 pixels
+    template<typename F>
+    void forIn(int level, const QRectF& rect, F f) const { at(level).forIn(rect, f); }
+
+private:
+    QVector<Level> mLevels;
+    QVector<Mercator::Point> mPoints;   // by PhotoId
+    int mRadius;                        // screen pixels
+    int mSize = 0;
+};
+
+#endif // CLUSTERS_H
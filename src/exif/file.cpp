@@ -1,10 +1,11 @@
 #include <QBuffer>
 #include <QByteArray>
 #include <QDebug>
+#include <QImage>
 #include <QImageReader>
-#include <QPixmap>
 #include <QVector>
 
+#include <algorithm>
 #include <cstdio>
 
 #include <libexif/exif-content.h>
@@ -35,6 +36,39 @@ bool Orientation::isRotated() const
 class FileHelper // TODO use Qt private class
 {
 public:
+    /// reads the size from the JPEG frame header without decoding anything
+    static QSize jpegSize(const QByteArray& jpeg)
+    {
+        const auto* d = reinterpret_cast<const uchar*>(jpeg.constData());
+        const int size = jpeg.size();
+
+        if (size < 4 || d[0] != 0xFF || d[1] != 0xD8)
+            return {};
+
+        for (int i = 2; i + 9 < size; )
+        {
+            if (d[i] != 0xFF)
+                return {};
+
+            const uchar marker = d[i + 1];
+            if (marker == 0xFF) { // fill byte
+                ++i;
+                continue;
+            }
+
+            // SOF0..SOF15 except DHT, JPG and DAC
+            if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+                return QSize((d[i + 7] << 8) | d[i + 8], (d[i + 5] << 8) | d[i + 6]);
+
+            if (marker == 0xD9 || marker == 0xDA) // EOI or SOS: no frame header before the data
+                return {};
+
+            i += 2 + ((d[i + 2] << 8) | d[i + 3]);
+        }
+
+        return {};
+    }
+
     static const QByteArray AsciiMarker;
     static const QByteArray UnicodeMarker;
     static const QByteArray JisMarker;
@@ -707,28 +741,19 @@ void File::remove(ExifIfd ifd, ExifTag tag)
     FileHelper::erase(ifd, tag, this);
 }
 
-QPixmap File::thumbnail(int width, int height) const
+QImage File::thumbnail(int width, int height, bool upscale) const
 {
-    if (mExifData && mExifData->data && mExifData->size)
+    Thumbnail embedded = embeddedThumbnail();
+    const QRect crop = embedded.crop(width, height);
+    if (!embedded.isNull() && (upscale || crop.width() * crop.height() >= width * height))
     {
-        QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char*>(mExifData->data), mExifData->size); // not copied
-        QBuffer buffer(&data);
+        QBuffer buffer(&embedded.jpeg);
         QImageReader reader(&buffer);
-        Orientation orientation = value(EXIF_IFD_1, EXIF_TAG_ORIENTATION).toInt();
 
-        // fix non-rotated EXIF thumbnail
-        QSize size = reader.size();
-        if (orientation == Orientation::Unknown && ((mWidth > mHeight) != (size.width() > size.height())))
-        {
-            // We don't know whether the picture should be rotated 90CW or 270CW.
-            // Future idea: compare the top line of image pixels with the top line of thumbnail pixels.
+        if (embedded.guessed)
             std::swap(width, height);
 
-            Orientation imageOrientation = value(EXIF_IFD_0, EXIF_TAG_ORIENTATION).toInt();
-            orientation = imageOrientation.isRotated() ? imageOrientation : Orientation::Rotate270CW;
-        }
-
-        return Pics::fromImageReader(&reader, width, height, orientation);
+        return Pics::fromImageReader(&reader, width, height, embedded.orientation);
     }
 
     if (!mFileName.isEmpty())
@@ -750,6 +775,44 @@ QPixmap File::thumbnail(int width, int height) const
     return {};
 }
 
+Thumbnail File::embeddedThumbnail() const
+{
+    Thumbnail thumbnail;
+    if (!mExifData || !mExifData->data || !mExifData->size)
+        return thumbnail;
+
+    thumbnail.jpeg = QByteArray::fromRawData(reinterpret_cast<const char*>(mExifData->data), mExifData->size);
+    thumbnail.size = FileHelper::jpegSize(thumbnail.jpeg);
+    thumbnail.orientation = value(EXIF_IFD_1, EXIF_TAG_ORIENTATION).toInt();
+
+    // fix non-rotated EXIF thumbnail; nothing is guessed without both sizes
+    const QSize& size = thumbnail.size;
+    if (thumbnail.orientation == Orientation::Unknown && size.isValid() && mWidth && mHeight &&
+        ((mWidth > mHeight) != (size.width() > size.height())))
+    {
+        // We don't know whether the picture should be rotated 90CW or 270CW.
+        // Future idea: compare the top line of image pixels with the top line of thumbnail pixels.
+        Orientation imageOrientation = value(EXIF_IFD_0, EXIF_TAG_ORIENTATION).toInt();
+        thumbnail.orientation = imageOrientation.isRotated() ? imageOrientation : Orientation::Rotate270CW;
+        thumbnail.guessed = true;
+    }
+
+    return thumbnail;
+}
+
+QRect Thumbnail::crop(int width, int height) const
+{
+    if (size.isEmpty() || width <= 0 || height <= 0)
+        return QRect(QPoint(0, 0), size);
+
+    if (orientation.isRotated())
+        std::swap(width, height);
+
+    const double scale = std::max(1.0 * width / size.width(), 1.0 * height / size.height());
+    const QSize cropped(std::min(size.width(), qRound(width / scale)), std::min(size.height(), qRound(height / scale)));
+    return QRect(QPoint((size.width() - cropped.width()) / 2, (size.height() - cropped.height()) / 2), cropped);
+}
+
 ExifData* File::data() const
 {
     return mExifData;
@@ -2,6 +2,8 @@
 #define EXIF_FILE_H
 
 #include <QCoreApplication>
+#include <QRect>
+#include <QSize>
 
 #include <libexif/exif-tag.h>
 #include <libexif/exif-log.h>
@@ -56,6 +58,22 @@ public:
     bool isRotated() const;
 };
 
+/// JPEG thumbnail embedded in IFD1, exactly as it is stored in the file.
+/// Nothing is decoded: the size comes from the JPEG frame header.
+struct Thumbnail
+{
+    QByteArray jpeg;            // not copied: valid while the File is alive and not modified
+    QSize size;                 // stored size, invalid if the frame header can't be read
+    Orientation orientation;    // to be applied after decoding
+    bool guessed = false;       // the orientation is not stored, it is guessed from the image aspect ratio
+
+    bool isNull() const { return jpeg.isEmpty(); }
+
+    /// \return the centered part of the stored picture that fills
+    /// \a width x \a height after the orientation is applied
+    QRect crop(int width, int height) const;
+};
+
 /// EXIF tags are stored in several groups called IFDs.
 /// You can load all tags from the file with load function.
 /// Set functions replaces an existing tag in a ifd or creates a new one.
@@ -121,7 +139,10 @@ public:
     QMap<ExifTag, QVariant> values(ExifIfd ifd) const;
     QVariant value(ExifIfd ifd, ExifTag tag) const;
 
-    QPixmap thumbnail(int width = 0, int height = 0) const;
+    /// the embedded thumbnail if there is one, otherwise the picture itself scaled down;
+    /// with \a upscale false an embedded thumbnail too small for \a width x \a height is skipped
+    QImage thumbnail(int width = 0, int height = 0, bool upscale = true) const;
+    Thumbnail embeddedThumbnail() const;
 
     ExifData* data() const;
     ExifContent* content(ExifIfd ifd) const;
@@ -112,3 +112,52 @@ QPointF Exif::Utils::fromLatLon(const QVariantList &latVal, const QByteArray &la
 
     return QPointF(lat, lon);
 }
+
+/// parses "YYYY:MM:DD HH:MM:SS" (DateTimeOriginal) and optional SubSecTimeOriginal digits
+/// with a fixed-position scan; the time zone is unknown, so the result is treated as UTC
+/// \return msecs since epoch
+qint64 Exif::Utils::fromDateTime(const QByteArray& dateTime, const QByteArray& subSecTime, bool* ok)
+{
+    if (ok) *ok = false;
+    if (dateTime.size() < 19)
+        return 0;
+
+    const char* s = dateTime.constData();
+    auto number = [s](int pos, int len, int* value) {
+        int v = 0;
+        for (int i = pos; i < pos + len; ++i) {
+            if (s[i] < '0' || s[i] > '9')
+                return false;
+            v = v * 10 + (s[i] - '0');
+        }
+        *value = v;
+        return true;
+    };
+
+    int year, month, day, hour, minute, second;
+    if (!number(0, 4, &year) || !number(5, 2, &month) || !number(8, 2, &day) ||
+        !number(11, 2, &hour) || !number(14, 2, &minute) || !number(17, 2, &second))
+        return 0; // "    :  :     :  :  " is a common way to write an unknown date
+
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+        return 0;
+
+    // days from civil, see http://howardhinnant.github.io/date_algorithms.html
+    const int y = year - (month <= 2);
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;
+    const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    const qint64 days = static_cast<qint64>(era) * 146097 + doe - 719468;
+
+    int msecs = 0;
+    for (int i = 0, scale = 100; i < subSecTime.size() && scale > 0; ++i, scale /= 10) {
+        const char c = subSecTime.at(i);
+        if (c < '0' || c > '9')
+            break;
+        msecs += (c - '0') * scale;
+    }
+
+    if (ok) *ok = true;
+    return ((days * 24 + hour) * 60 + minute) * 60000LL + second * 1000LL + msecs;
+}
@@ -30,6 +30,7 @@ QGeoCoordinate fromLatLon(const QVector<ExifRational>& lat, const QByteArray& la
 double fromSingleRational(const QVector<ExifRational>& rational, const QByteArray& ref);
 QPointF fromLatLon(const QVariantList& latVal, const QByteArray& latRef,
                    const QVariantList& lonVal, const QByteArray& lonRef);
+qint64 fromDateTime(const QByteArray& dateTime, const QByteArray& subSecTime, bool* ok = nullptr);
 
 } // namespace Utils
 
@@ -1,46 +1,56 @@
 #include <QDir>
-#include <QPixmap>
 #include <QVariant>
 
+#include <algorithm>
+
 #include "exif/file.h"
 #include "exif/utils.h"
 
 #include "exifstorage.h"
-#include "pics.h"
 
 int ExifReader::thumbnailSize = 32;
 
-bool ThreadSafeStringSet::insert(const QString& s)
+namespace
+{
+
+inline quint64 levelKey(PhotoId id, int level)
+{
+    return (static_cast<quint64>(id) << 8) | static_cast<quint64>(level);
+}
+
+} // namespace
+
+bool ThreadSafeIdSet::insert(PhotoId id)
 {
     QMutexLocker lock(&mMutex);
     int sz = Super::size();
-    Super::insert(s);
+    Super::insert(id);
     return Super::size() > sz;
 }
 
-void ThreadSafeStringSet::remove(const QString& s)
+void ThreadSafeIdSet::remove(PhotoId id)
 {
     QMutexLocker lock(&mMutex);
-    Super::remove(s);
+    Super::remove(id);
 }
 
-void ThreadSafeStringSet::clear()
+void ThreadSafeIdSet::clear()
 {
     QMutexLocker lock(&mMutex);
     Super::clear();
 }
 
-QString ThreadSafeStringSet::takeFirst()
+PhotoId ThreadSafeIdSet::takeFirst()
 {
     QMutexLocker lock(&mMutex);
-    if (isEmpty()) return "";
+    if (isEmpty()) return INVALID_PHOTO_ID;
     auto first = cbegin();
-    QString s = *first;
+    PhotoId id = *first;
     erase(first);
-    return s;
+    return id;
 }
 
-int ThreadSafeStringSet::size() const
+int ThreadSafeIdSet::size() const
 {
     QMutexLocker lock(&mMutex);
     return Super::size();
@@ -57,14 +67,14 @@ WaitCondition::Locker::~Locker()
     mCondition->mMutex.unlock();
 }
 
-void ExifReader::parse(const QString& path)
+void ExifReader::parse(PhotoId id)
 {
-    if (path.isEmpty()) return;
+    if (id == INVALID_PHOTO_ID) return;
 
-    if (auto photo = load(path))
+    if (auto photo = load(id))
         emit ready(photo);
     else
-        emit failed(path);
+        emit failed(id);
 }
 
 void ExifReader::run()
@@ -75,17 +85,21 @@ void ExifReader::run()
 
         while (!mTerminated)
         {
-            QString path = mPending->takeFirst();
-            if (path.isEmpty()) break;
-            parse(path);
+            PhotoId id = mPending->takeFirst();
+            if (id == INVALID_PHOTO_ID) break;
+            parse(id);
         }
     }
 }
 
-QSharedPointer<Photo> ExifReader::load(const QString& path)
+QSharedPointer<Photo> ExifReader::load(PhotoId id)
 {
+    const QString path = ExifStorage::path(id);
+    if (path.isEmpty())
+        return {};
+
     auto data = QSharedPointer<Photo>::create();
-    data->path = path;
+    data->id = id;
 
     Exif::File exif;
     if (exif.load(QDir::toNativeSeparators(path), false))
@@ -99,20 +113,29 @@ QSharedPointer<Photo> ExifReader::load(const QString& path)
             data->position = Exif::Utils::fromLatLon(latVal.toList(), latRef, lonVal.toList(), lonRef);
 
         data->orientation = exif.orientation();
-        data->keywords = exif.value(EXIF_IFD_0, EXIF_TAG_XP_KEYWORDS).toString();
-    }
 
-    QPixmap pix = exif.thumbnail(thumbnailSize, thumbnailSize);
-    if (!pix.isNull())
-    {
-        data->pix32 = pix.width() == 32 ? pix : pix.scaled(32, 32, Qt::KeepAspectRatio);
-        data->pix16 = pix.scaled(16, 16, Qt::KeepAspectRatio);
-        data->pixBase64 = Pics::toBase64(pix, "JPEG");
+        bool ok = false;
+        qint64 time = Exif::Utils::fromDateTime(exif.value(EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_ORIGINAL).toByteArray(),
+                                                exif.value(EXIF_IFD_EXIF, EXIF_TAG_SUB_SEC_TIME_ORIGINAL).toByteArray(), &ok);
+        if (ok)
+            data->time = time;
+
+        data->keywords = ExifStorage::parseKeywords(exif.value(EXIF_IFD_0, EXIF_TAG_XP_KEYWORDS).toString());
     }
 
+    // QImage only: this runs in the reader threads
+    data->thumbnail = ThumbnailStore::compress(exif, thumbnailSize, true, &data->thumbnailOrientation);
+
     return data;
 }
 
+/// the best source for the \a size: the embedded thumbnail if it is big enough, otherwise the picture decoded at a DCT scale
+QByteArray ExifReader::thumbnail(PhotoId id, int size, Exif::Orientation* orientation)
+{
+    Exif::File exif(ExifStorage::path(id), false);
+    return ThumbnailStore::compress(exif, size, false, orientation);
+}
+
 ExifStorage::ExifStorage() : mThread(&mPending, &mCondition)
 {
     qRegisterMetaType< QSharedPointer<Photo> >();
@@ -120,6 +143,9 @@ ExifStorage::ExifStorage() : mThread(&mPending, &mCondition)
     connect(&mThread, &ExifReader::ready, this, &ExifStorage::add);
     connect(&mThread, &ExifReader::failed, this, &ExifStorage::fail);
 
+    // the GUI thread keeps a core
+    mThumbnailBuilder.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+
     mThread.start();
 }
 
@@ -133,21 +159,22 @@ ExifStorage::~ExifStorage()
 void ExifStorage::add(const QSharedPointer<Photo>& photo)
 {
     int rest = 0;
-    QMap<QString, int> keywords;
+    QMap<KeywordId, int> keywords;
 
     {
         QMutexLocker lock(&mMutex);
-        mData[photo->path] = photo;
+        if (mData.size() <= static_cast<int>(photo->id))
+            mData.resize(photo->id + 1);
 
-        if (!photo->keywords.isEmpty())
-        {
-            for (const QString& keyword: photo->keywords.split(';'))
-            {
-                QSet<QString>& files = mKeywords[keyword.trimmed()];
-                files.insert(photo->path);
-                keywords[keyword] = files.size();
-            }
-        }
+        mData[photo->id] = photo;
+        mCatalog.set(*photo, &keywords);
+
+        mThumbnails.insert(photo->id, 0, photo->thumbnail, photo->thumbnailOrientation);
+        photo->thumbnail.clear(); // stored once, in the arena
+
+        // the file may have changed, the failed levels are tried again
+        for (int level = 1; level < ThumbnailStore::LEVELS; ++level)
+            mFailedLevels.remove(levelKey(photo->id, level));
 
         rest = mPending.size();
     }
@@ -155,10 +182,10 @@ void ExifStorage::add(const QSharedPointer<Photo>& photo)
     emit ready(photo);
     emit remains(rest);
     for (auto i = keywords.cbegin(); i != keywords.cend(); ++i)
-        emit keywordAdded(i.key(), i.value());
+        emit keywordAdded(mKeywordNames.value(i.key()), i.value());
 }
 
-void ExifStorage::fail(const QString& /*path*/)
+void ExifStorage::fail(PhotoId /*id*/)
 {
     int rest = 0;
 
@@ -185,80 +212,231 @@ void ExifStorage::destroy()
 
     storage->mThread.quit();
     storage->mThread.wait();
+
+    storage->mThumbnailBuilder.clear();
+    storage->mThumbnailBuilder.waitForDone();
 }
 
-void ExifStorage::parse(const QString& path)
+PhotoId ExifStorage::id(const QString& path)
 {
+    return path.isEmpty() ? INVALID_PHOTO_ID : instance()->mPaths.insert(path);
+}
+
+PhotoId ExifStorage::find(const QString& path)
+{
+    return path.isEmpty() ? INVALID_PHOTO_ID : instance()->mPaths.find(path);
+}
+
+QString ExifStorage::path(PhotoId id)
+{
+    return id == INVALID_PHOTO_ID ? QString() : instance()->mPaths.value(id);
+}
+
+/// orders photos by path without converting them to QString
+bool ExifStorage::lessPath(PhotoId L, PhotoId R)
+{
+    return instance()->mPaths.compare(L, R) < 0;
+}
+
+void ExifStorage::parse(PhotoId id)
+{
+    if (id == INVALID_PHOTO_ID)
+        return;
+
     auto storage = instance();
-    if (storage->mPending.insert(path))
+    if (storage->mPending.insert(id))
         storage->mCondition.wakeOne();
 }
 
-void ExifStorage::cancel(const QString& path)
+void ExifStorage::cancel(PhotoId id)
 {
     auto storage = instance();
-    storage->mPending.remove(path);
+    storage->mPending.remove(id);
 }
 
-QSharedPointer<Photo> ExifStorage::data(const QString& path)
+QSharedPointer<Photo> ExifStorage::data(PhotoId id)
 {
+    if (id == INVALID_PHOTO_ID)
+        return {};
+
     auto storage = instance();
     QMutexLocker lock(&storage->mMutex);
-    auto i = storage->mData.constFind(path);
-    if (i != storage->mData.constEnd())
-        return *i;
+    if (static_cast<int>(id) < storage->mData.size())
+        if (const auto& photo = storage->mData.at(id))
+            return photo;
 
-    if (storage->mPending.insert(path))
+    if (storage->mPending.insert(id))
         storage->mCondition.wakeOne();
 
     return {};
 }
 
-QStringList ExifStorage::keywords()
+QSharedPointer<Photo> ExifStorage::data(const QString& path)
+{
+    return data(id(path));
+}
+
+bool ExifStorage::hasThumbnail(PhotoId id)
 {
+    return id != INVALID_PHOTO_ID && instance()->mThumbnails.contains(id);
+}
+
+/// \return the thumbnail not bigger than \a size x \a size or a null image if the photo is not loaded yet;
+/// while the pyramid level for the \a size is being built in the background a smaller one is returned,
+/// thumbnailReady() tells when the level is there
+QImage ExifStorage::thumbnail(PhotoId id, int size)
+{
+    if (id == INVALID_PHOTO_ID)
+        return {};
+
     auto storage = instance();
-    QMutexLocker lock(&storage->mMutex);
-    return storage->mKeywords.keys();
+    const int level = thumbnailLevel(size);
+
+    bool exact = true;
+    QImage image = storage->mThumbnails.image(id, level, size, &exact);
+    if (!exact && !image.isNull())
+        storage->buildThumbnail(id, level);
+
+    return image;
 }
 
-QStringList ExifStorage::keywords(const QString& file)
+/// \return the lowest pyramid level not smaller than \a size or the top one
+int ExifStorage::thumbnailLevel(int size)
 {
-    QString string;
-    if (auto photo = data(file))
-        string = photo->keywords;
-    else
-        string = Exif::File(file, false).value(EXIF_IFD_0, EXIF_TAG_XP_KEYWORDS).toString();
+    int level = 0;
+    while (level + 1 < ThumbnailStore::LEVELS && (ExifReader::thumbnailSize << level) < size)
+        ++level;
+    return level;
+}
 
+void ExifStorage::buildThumbnail(PhotoId id, int level)
+{
+    const quint64 key = levelKey(id, level);
+    {
+        QMutexLocker lock(&mMutex);
+        if (mBuilding.contains(key) || mFailedLevels.contains(key))
+            return;
+        mBuilding.insert(key);
+    }
+
+    mThumbnailBuilder.start([this, id, level, key](){
+        Exif::Orientation orientation;
+        const QByteArray bytes = ExifReader::thumbnail(id, ExifReader::thumbnailSize << level, &orientation);
+        if (!bytes.isEmpty())
+            mThumbnails.insert(id, level, bytes, orientation);
+
+        {
+            QMutexLocker lock(&mMutex);
+            mBuilding.remove(key);
+            if (bytes.isEmpty())
+                mFailedLevels.insert(key); // not tried again on every paint
+        }
+
+        if (!bytes.isEmpty())
+            emit thumbnailReady(id, level);
+    });
+}
+
+/// splits XP_KEYWORDS tag value and puts the keywords to the dictionary
+KeywordIdList ExifStorage::parseKeywords(const QString& tag)
+{
+    KeywordIdList ids;
+    if (tag.isEmpty())
+        return ids;
+
+    auto storage = instance();
+    for (const QStringRef& keyword: tag.splitRef(';'))
+    {
+        QString trimmed = keyword.trimmed().toString();
+        if (!trimmed.isEmpty())
+            ids.append(storage->mKeywordNames.insert(trimmed));
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+QString ExifStorage::keyword(KeywordId id)
+{
+    return instance()->mKeywordNames.value(id);
+}
+
+QStringList ExifStorage::keywords(const KeywordIdList& ids)
+{
     QStringList keywords;
-    if (!string.isEmpty())
-        for (QString& s: string.split(';'))
-            keywords.append(s.trimmed());
+    keywords.reserve(ids.size());
+    for (KeywordId id: ids)
+        keywords.append(keyword(id));
     return keywords;
 }
 
-QSet<QString> ExifStorage::byKeywords(const QStringList& keywords, Logic logic)
+QStringList ExifStorage::keywords()
+{
+    auto storage = instance();
+    QMutexLocker lock(&storage->mMutex);
+
+    return keywords(storage->mCatalog.keywords());
+}
+
+QStringList ExifStorage::keywords(PhotoId id)
+{
+    return keywords(keywordIds(id));
+}
+
+KeywordIdList ExifStorage::keywordIds(PhotoId id)
+{
+    if (auto photo = data(id))
+        return photo->keywords;
+
+    return parseKeywords(Exif::File(path(id), false).value(EXIF_IFD_0, EXIF_TAG_XP_KEYWORDS).toString());
+}
+
+Bitmap ExifStorage::byKeywords(const QStringList& keywords, Logic logic)
 {
     if (keywords.isEmpty())
         return {};
 
     auto storage = instance();
-    QMutexLocker lock(&storage->mMutex);
+    std::vector<CatalogQuery> operands;
+    operands.reserve(keywords.size());
+    for (const QString& keyword: keywords)
+        operands.push_back(CatalogQuery::tagged(storage->mKeywordNames.find(keyword)));
 
-    auto ret = storage->mKeywords.value(keywords[0]);
-    for (int i = 1; i < keywords.size(); ++i)
-    {
-        auto s = storage->mKeywords.value(keywords[i]);
-        if (logic == Logic::And)
-            ret.intersect(s);
-        else
-            ret.unite(s);
-    }
-    return ret;
+    return select(logic == Logic::And ? CatalogQuery::all(operands) : CatalogQuery::any(operands));
 }
 
 int ExifStorage::count(const QString& keyword)
 {
     auto storage = instance();
     QMutexLocker lock(&storage->mMutex);
-    return storage->mKeywords.value(keyword).size();
+    return storage->mCatalog.tagged(storage->mKeywordNames.find(keyword)).size();
+}
+
+Bitmap ExifStorage::select(const CatalogQuery& query)
+{
+    auto storage = instance();
+    QMutexLocker lock(&storage->mMutex);
+    return storage->mCatalog.select(query);
+}
+
+Period ExifStorage::timeRange()
+{
+    auto storage = instance();
+    QMutexLocker lock(&storage->mMutex);
+    return storage->mCatalog.timeIndex().range();
+}
+
+int ExifStorage::count(const Period& period)
+{
+    auto storage = instance();
+    QMutexLocker lock(&storage->mMutex);
+    return storage->mCatalog.timeIndex().count(period);
+}
+
+QVector<int> ExifStorage::histogram(const Period& period, int bins)
+{
+    auto storage = instance();
+    QMutexLocker lock(&storage->mMutex);
+    return storage->mCatalog.timeIndex().histogram(period, bins);
 }
@@ -1,26 +1,33 @@
 #ifndef EXIFSTORAGE_H
 #define EXIFSTORAGE_H
 
+#include <QImage>
 #include <QObject>
 #include <QMap>
 #include <QMutex>
-#include <QPixmap>
 #include <QPointF>
 #include <QSet>
 #include <QThread>
+#include <QThreadPool>
 #include <QStringList>
+#include <QVector>
 #include <QWaitCondition>
 
 #include "exif/file.h"
+#include "bitmap.h"
+#include "catalog.h"
+#include "photoid.h"
+#include "thumbnailstore.h"
 
 struct Photo
 {
-    QString path;
+    PhotoId id = INVALID_PHOTO_ID;
     QPointF position;
     Exif::Orientation orientation;
-    QString keywords;
-    QPixmap pix16, pix32;
-    QString pixBase64;
+    qint64 time = Catalog::INVALID_TIME; // msecs since epoch
+    KeywordIdList keywords; // sorted, unique
+    QByteArray thumbnail; // compressed by ExifReader, moved to the thumbnail store by ExifStorage
+    Exif::Orientation thumbnailOrientation; // to be applied when the thumbnail is decoded
 };
 
 bool operator ==(const ExifData& L, const ExifData& R);
@@ -29,17 +36,17 @@ bool operator !=(const ExifData& L, const ExifData& R);
 Q_DECLARE_METATYPE(QSharedPointer<Photo>)
 
 
-class ThreadSafeStringSet : private QSet<QString>
+class ThreadSafeIdSet : private QSet<PhotoId>
 {
-    using Super = QSet<QString>;
+    using Super = QSet<PhotoId>;
     mutable QMutex mMutex;
 
 public:
-    bool insert(const QString& s);
-    void remove(const QString& s);
+    bool insert(PhotoId id);
+    void remove(PhotoId id);
 
     void clear();
-    QString takeFirst();
+    PhotoId takeFirst();
 
     int size() const;
 };
@@ -70,20 +77,21 @@ class ExifReader : public QThread
 
 signals:
     void ready(const QSharedPointer<Photo>& photo);
-    void failed(const QString& path);
+    void failed(PhotoId id);
 
 public:
-    void parse(const QString& path);
+    void parse(PhotoId id);
 
-    explicit ExifReader(ThreadSafeStringSet* s, WaitCondition* c) : mPending(s), mCondition(c) {}
+    explicit ExifReader(ThreadSafeIdSet* s, WaitCondition* c) : mPending(s), mCondition(c) {}
     void run() override;
     void stop() { mTerminated = true; }
 
 public:
-    static QSharedPointer<Photo> load(const QString& path);
-    static int thumbnailSize;
+    static QSharedPointer<Photo> load(PhotoId id);
+    static QByteArray thumbnail(PhotoId id, int size, Exif::Orientation* orientation);
+    static int thumbnailSize; // level 0 of the thumbnail pyramid
 
-    ThreadSafeStringSet* mPending;
+    ThreadSafeIdSet* mPending;
     WaitCondition* mCondition;
     bool mTerminated = false;
 };
@@ -96,6 +104,8 @@ signals:
     void ready(const QSharedPointer<Photo>& photo);
     void remains(int count);
     void keywordAdded(const QString& keyword, int count);
+    /// the pyramid \a level of the photo is built, it was stood in for by a smaller one
+    void thumbnailReady(PhotoId id, int level);
 
 public:
     enum class Logic { And, Or };
@@ -103,29 +113,60 @@ public:
     static ExifStorage* instance();
     static void destroy();
 
-    static void parse(const QString& path);
-    static void cancel(const QString& path);
+    static PhotoId id(const QString& path);
+    /// the id of the \a path if it has been interned, INVALID_PHOTO_ID otherwise
+    static PhotoId find(const QString& path);
+    static QString path(PhotoId id);
+    static bool lessPath(PhotoId L, PhotoId R);
 
+    static void parse(PhotoId id);
+    static void cancel(PhotoId id);
+
+    static QSharedPointer<Photo> data(PhotoId id);
     static QSharedPointer<Photo> data(const QString& path);
 
+    static bool hasThumbnail(PhotoId id);
+    static QImage thumbnail(PhotoId id, int size);
+    static int thumbnailLevel(int size);
+
+    static KeywordIdList parseKeywords(const QString& tag);
+    static QString keyword(KeywordId id);
+    static QStringList keywords(const KeywordIdList& ids);
+
     static QStringList keywords();
-    static QStringList keywords(const QString& file);
-    static QSet<QString> byKeywords(const QStringList& keywords, Logic logic);
+    static QStringList keywords(PhotoId id);
+    static KeywordIdList keywordIds(PhotoId id);
+    static Bitmap byKeywords(const QStringList& keywords, Logic logic);
     static int count(const QString& keyword);
 
+    static Bitmap select(const CatalogQuery& query);
+
+    static Period timeRange();
+    static int count(const Period& period);
+    static QVector<int> histogram(const Period& period, int bins);
+
 private:
     ExifStorage();
    ~ExifStorage() override;
     void add(const QSharedPointer<Photo>& photo);
-    void fail(const QString& path);
+    void fail(PhotoId id);
+    void buildThumbnail(PhotoId id, int level);
 
     ExifReader mThread;
-    ThreadSafeStringSet mPending;
+    ThreadSafeIdSet mPending;
     WaitCondition mCondition;
 
+    StringPool mPaths;
+    StringPool mKeywordNames;
+
     QMutex mMutex;
-    QMap<QString, QSharedPointer<Photo>> mData;
-    QMap<QString, QSet<QString>> mKeywords;
+    QVector<QSharedPointer<Photo>> mData; // indexed by PhotoId
+    Catalog mCatalog;                     // columns of the loaded photos
+
+    ThumbnailStore mThumbnails;           // has its own lock
+    QThreadPool mThumbnailBuilder;        // makes the pyramid levels above 0
+    QSet<quint64> mBuilding;              // (id, level) queued to mThumbnailBuilder
+    QSet<quint64> mFailedLevels;          // (id, level) failed to build, until the photo is parsed again
 
 };
 
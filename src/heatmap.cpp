@@ -0,0 +1,185 @@
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numeric>
+
+#include "heatmap.h"
+
+constexpr int Heatmap::MAX_LEVEL;
+constexpr int Heatmap::BINS;
+constexpr int Heatmap::BLUR;
+
+namespace
+{
+
+constexpr int TILE_BITS = 8;    // log2(Mercator::TILE)
+constexpr int BIN_BITS = 3;     // log2(Mercator::TILE / Heatmap::BINS)
+constexpr int SPAN = Heatmap::BINS + 2 * Heatmap::BLUR;
+
+/// normalized Gaussian weights, sigma = BLUR / 2
+std::array<float, 2 * Heatmap::BLUR + 1> kernel()
+{
+    std::array<float, 2 * Heatmap::BLUR + 1> weights;
+    const double sigma = Heatmap::BLUR / 2.0;
+    for (int i = -Heatmap::BLUR; i <= Heatmap::BLUR; ++i)
+        weights[i + Heatmap::BLUR] = static_cast<float>(std::exp(-i * i / (2 * sigma * sigma)));
+
+    const float sum = std::accumulate(weights.cbegin(), weights.cend(), 0.0f);
+    for (float& w: weights)
+        w /= sum;
+    return weights;
+}
+
+} // namespace
+
+Heatmap::Heatmap()
+{
+    clear();
+}
+
+void Heatmap::add(Mercator::Point point, int weight)
+{
+    ++mStamp;
+    for (int z = 0; z <= MAX_LEVEL; ++z)
+        add(mLevels[z], z, point, weight, mStamp);
+}
+
+void Heatmap::add(const QVector<Mercator::Point>& points, int weight)
+{
+    if (points.isEmpty())
+        return;
+
+    const quint64 stamp = ++mStamp;
+
+    // the levels share nothing, so every one is binned by its own thread without locks
+    QVector<int> levels(MAX_LEVEL + 1);
+    std::iota(levels.begin(), levels.end(), 0);
+    Level* data = mLevels.data();
+    QtConcurrent::blockingMap(levels, [data, &points, weight, stamp](int z){
+        for (const Mercator::Point& point: points)
+            add(data[z], z, point, weight, stamp);
+    });
+}
+
+void Heatmap::clear()
+{
+    mLevels.clear();
+    mLevels.resize(MAX_LEVEL + 1);
+    ++mStamp; // the cleared tiles are gone with their stamps
+}
+
+QVector<float> Heatmap::density(int level, int x, int y) const
+{
+    // the tile with the borders of the tiles around, the blur reaches that far
+    const Tile* around[3][3];
+    bool empty = true;
+    for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx)
+        {
+            const Tile* t = tile(level, x + dx, y + dy);
+            around[dy + 1][dx + 1] = t;
+            empty = empty && (!t || t->total == 0);
+        }
+
+    if (empty)
+        return {};
+
+    QVector<float> source(SPAN * SPAN, 0.0f);
+    for (int v = 0; v < SPAN; ++v)
+    {
+        const int by = v - BLUR + BINS;     // in the 3 x 3 tiles
+        for (int u = 0; u < SPAN; ++u)
+        {
+            const int bx = u - BLUR + BINS;
+            const Tile* t = around[by / BINS][bx / BINS];
+            if (t)
+                source[v * SPAN + u] = t->bins.at((by % BINS) * BINS + bx % BINS);
+        }
+    }
+
+    static const auto weights = kernel();
+
+    // rows first, then columns
+    QVector<float> rows(SPAN * BINS);
+    for (int v = 0; v < SPAN; ++v)
+    {
+        const float* in = source.constData() + v * SPAN;
+        float* out = rows.data() + v * BINS;
+        for (int u = 0; u < BINS; ++u)
+        {
+            float sum = 0;
+            for (int i = 0; i <= 2 * BLUR; ++i)
+                sum += weights[i] * in[u + i];
+            out[u] = sum;
+        }
+    }
+
+    QVector<float> result(BINS * BINS);
+    for (int v = 0; v < BINS; ++v)
+    {
+        float* out = result.data() + v * BINS;
+        for (int u = 0; u < BINS; ++u)
+        {
+            float sum = 0;
+            for (int i = 0; i <= 2 * BLUR; ++i)
+                sum += weights[i] * rows.at((v + i) * BINS + u);
+            out[u] = sum;
+        }
+    }
+
+    return result;
+}
+
+quint64 Heatmap::stamp(int level, int x, int y) const
+{
+    quint64 result = mLevels.at(level).dropped;
+    for (int dy = -1; dy <= 1; ++dy)
+        for (int dx = -1; dx <= 1; ++dx)
+            if (const Tile* t = tile(level, x + dx, y + dy))
+                result = std::max(result, t->stamp);
+    return result;
+}
+
+void Heatmap::add(Level& level, int z, Mercator::Point point, int weight, quint64 stamp)
+{
+    // world pixels are the ones of zoom WORLD_ZOOM, a tile of the level z is 2^(WORLD_ZOOM + TILE_BITS - z) of them
+    const int tileShift = Mercator::WORLD_ZOOM + TILE_BITS - z;
+    const int binShift = tileShift - TILE_BITS + BIN_BITS;
+    const int x = static_cast<int>(static_cast<quint64>(point.x) >> tileShift);
+    const int y = static_cast<int>(static_cast<quint64>(point.y) >> tileShift);
+
+    auto it = level.tiles.find(key(x, y));
+    if (it == level.tiles.end())
+    {
+        it = level.tiles.insert(key(x, y), Tile());
+        it->bins.fill(0, BINS * BINS);
+    }
+
+    Tile& tile = *it;
+    const int u = (point.x >> binShift) & (BINS - 1);
+    const int v = (point.y >> binShift) & (BINS - 1);
+    tile.bins[v * BINS + u] += weight;
+    tile.total += weight;
+    tile.stamp = stamp;
+
+    // the tiles around can't tell a tile gone from one never there, so the whole level changes
+    if (tile.total == 0)
+    {
+        level.tiles.erase(it);
+        level.dropped = stamp;
+    }
+}
+
+const Heatmap::Tile* Heatmap::tile(int level, int x, int y) const
+{
+    const int n = tiles(level);
+    if (y < 0 || y >= n)
+        return nullptr;
+
+    x = (x % n + n) % n;
+    const QHash<quint64, Tile>& tiles = mLevels.at(level).tiles;
+    auto it = tiles.constFind(key(x, y));
+    return it == tiles.cend() ? nullptr : &*it;
+}
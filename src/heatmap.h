@@ -0,0 +1,62 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <QHash>
+#include <QVector>
+
+#include "clusters.h"
+
+/// Photo density of the map tiles of the levels up to MAX_LEVEL, for the zooms where markers tell nothing.
+/// A TILE x TILE px tile of a level is a grid of BINS x BINS counters; a photo adds to its bin at every level,
+/// so ingesting or filtering out a photo is O(levels); a batch of photos is binned in parallel, a level per thread.
+/// density() blurs the counters of a tile with a separable Gaussian, reading the borders of the tiles around,
+/// so its cost depends on the tile size only, not on the number of photos.
+/// Only the tiles with photos are kept, a tile whose last photo is removed is dropped.
+class Heatmap
+{
+public:
+    static constexpr int MAX_LEVEL = 8;
+    static constexpr int BINS = 32;     // per tile side, a bin is 8 px
+    static constexpr int BLUR = 2;      // radius, in bins
+
+    Heatmap();
+
+    void add(Mercator::Point point, int weight = 1);
+    void remove(Mercator::Point point) { add(point, -1); }
+    void add(const QVector<Mercator::Point>& points, int weight = 1);
+    void clear();
+
+    /// the tiles per side of the \a level
+    static int tiles(int level) { return 1 << level; }
+
+    /// \return the BINS x BINS blurred counters of the tile (\a x, \a y) of the \a level, row by row;
+    /// empty if there are no photos around; \a x wraps around the antimeridian
+    QVector<float> density(int level, int x, int y) const;
+
+    /// \return a number changing with every change of density() of the tile, 0 if it has never changed;
+    /// dropping a tile changes the numbers of the whole level
+    quint64 stamp(int level, int x, int y) const;
+
+private:
+    struct Tile
+    {
+        QVector<qint32> bins;
+        qint64 total = 0;
+        quint64 stamp = 0;              // of the last change
+    };
+
+    struct Level
+    {
+        QHash<quint64, Tile> tiles;
+        quint64 dropped = 0;            // the stamp of the last tile dropped
+    };
+
+    static quint64 key(int x, int y) { return (static_cast<quint64>(y) << 32) | static_cast<quint32>(x); }
+    static void add(Level& level, int z, Mercator::Point point, int weight, quint64 stamp);
+    const Tile* tile(int level, int x, int y) const;
+
+    QVector<Level> mLevels;
+    quint64 mStamp = 0;
+};
+
+#endif // HEATMAP_H
@@ -0,0 +1,139 @@
+#include <QColor>
+#include <QPainter>
+
+#include <algorithm>
+#include <cmath>
+
+#include "heatmap.h"
+#include "heatmaplayer.h"
+
+constexpr int HeatmapLayer::CACHE_KB;
+constexpr int HeatmapLayer::SATURATION;
+
+HeatmapLayer::HeatmapLayer(QQuickItem* parent) : Super(parent), mPictures(CACHE_KB)
+{
+}
+
+void HeatmapLayer::setModel(MapPhotoListModel* model)
+{
+    if (model == mModel)
+        return;
+
+    if (mModel)
+        mModel->disconnect(this);
+
+    mModel = model;
+    if (mModel)
+        connect(mModel, &MapPhotoListModel::heatmapChanged, this, [this](){ update(); });
+
+    mPictures.clear();
+    update();
+    emit modelChanged();
+}
+
+void HeatmapLayer::setZoom(qreal zoom)
+{
+    if (qFuzzyCompare(zoom, mZoom))
+        return;
+
+    mZoom = zoom;
+    update();
+    emit zoomChanged();
+}
+
+void HeatmapLayer::setCenter(const QGeoCoordinate& center)
+{
+    if (center == mCenter)
+        return;
+
+    mCenter = center;
+    update();
+    emit centerChanged();
+}
+
+void HeatmapLayer::paint(QPainter* painter)
+{
+    if (!mModel || !mCenter.isValid())
+        return;
+
+    const int level = std::max(0, std::min(static_cast<int>(std::floor(mZoom)), Heatmap::MAX_LEVEL));
+    const int tiles = Heatmap::tiles(level);
+    const qreal size = Mercator::TILE * Mercator::scale(mZoom - level);  // of a tile on the screen
+
+    // the level pixel at the item top left corner
+    const QPointF center = Mercator::project({ mCenter.latitude(), mCenter.longitude() }) * Mercator::scale(mZoom);
+    const QPointF origin = center - QPointF(width() / 2, height() / 2);
+
+    const int x0 = static_cast<int>(std::floor(origin.x() / size));
+    const int x1 = static_cast<int>(std::floor((origin.x() + width()) / size));
+    const int y0 = std::max(0, static_cast<int>(std::floor(origin.y() / size)));
+    const int y1 = std::min(tiles - 1, static_cast<int>(std::floor((origin.y() + height()) / size)));
+
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    for (int y = y0; y <= y1; ++y)
+    {
+        for (int x = x0; x <= x1; ++x)
+        {
+            // x wraps around the antimeridian
+            const QImage& image = picture(level, (x % tiles + tiles) % tiles, y);
+            if (!image.isNull())
+                painter->drawImage(QRectF(QPointF(x * size, y * size) - origin, QSizeF(size, size)), image);
+        }
+    }
+}
+
+quint64 HeatmapLayer::tileKey(int level, int x, int y)
+{
+    return (static_cast<quint64>(level) << 48) | (static_cast<quint64>(y) << 24) | static_cast<quint64>(x);
+}
+
+/// logarithmic, so a few photos are seen next to thousands: transparent blue to opaque red
+QImage HeatmapLayer::colorize(const QVector<float>& density)
+{
+    QImage image(Heatmap::BINS, Heatmap::BINS, QImage::Format_ARGB32_Premultiplied);
+    const float top = std::log1p(static_cast<float>(SATURATION));
+
+    for (int v = 0; v < Heatmap::BINS; ++v)
+    {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(v));
+        for (int u = 0; u < Heatmap::BINS; ++u)
+        {
+            const float d = density.at(v * Heatmap::BINS + u);
+            if (d < 0.01f)
+            {
+                line[u] = 0;
+                continue;
+            }
+
+            const float heat = std::min(1.0f, std::log1p(d) / top);
+            const QColor color = QColor::fromHsvF((1 - heat) * 240 / 360.0, 1, 1, 0.3 + 0.5 * std::sqrt(heat));
+            line[u] = qPremultiply(color.rgba());
+        }
+    }
+
+    return image;
+}
+
+/// the tile picture, drawn again if the photos around it have changed since
+const QImage& HeatmapLayer::picture(int level, int x, int y)
+{
+    const Heatmap& heatmap = mModel->heatmap();
+    const quint64 key = tileKey(level, x, y);
+    const quint64 stamp = heatmap.stamp(level, x, y);
+
+    Picture* picture = mPictures.object(key);
+    if (!picture || picture->stamp != stamp)
+    {
+        const QVector<float> density = heatmap.density(level, x, y);
+        if (density.isEmpty())
+        {
+            mPictures.remove(key);
+            return mEmpty;
+        }
+
+        picture = new Picture{ colorize(density), stamp };
+        mPictures.insert(key, picture, std::max(1, static_cast<int>(picture->image.sizeInBytes() / 1024)));
+    }
+
+    return picture->image;
+}
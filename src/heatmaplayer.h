@@ -0,0 +1,61 @@
+#ifndef HEATMAPLAYER_H
+#define HEATMAPLAYER_H
+
+#include <QCache>
+#include <QGeoCoordinate>
+#include <QImage>
+#include <QPointer>
+#include <QQuickPaintedItem>
+
+#include "model.h"
+
+/// Draws the Heatmap of MapPhotoListModel over the map, shown instead of the markers at small zooms.
+/// Only the tiles of the screen are drawn, each a small density picture scaled up smoothly,
+/// so the cost is the same for a hundred photos and for a million of them.
+/// Tile pictures are cached until the photos around them change.
+class HeatmapLayer : public QQuickPaintedItem
+{
+    using Super = QQuickPaintedItem;
+    Q_OBJECT
+
+    Q_PROPERTY(MapPhotoListModel* model MEMBER mModel WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(qreal zoom MEMBER mZoom WRITE setZoom NOTIFY zoomChanged)
+    Q_PROPERTY(QGeoCoordinate center MEMBER mCenter WRITE setCenter NOTIFY centerChanged)
+
+signals:
+    void modelChanged();
+    void zoomChanged();
+    void centerChanged();
+
+public:
+    static constexpr int CACHE_KB = 16 * 1024;
+    static constexpr int SATURATION = 256;      // photos per bin drawn at the full heat
+
+    explicit HeatmapLayer(QQuickItem* parent = nullptr);
+
+    void setModel(MapPhotoListModel* model);
+    void setZoom(qreal zoom);
+    void setCenter(const QGeoCoordinate& center);
+
+    void paint(QPainter* painter) override;
+
+private:
+    struct Picture
+    {
+        QImage image;
+        quint64 stamp = 0;              // Heatmap::stamp() it is drawn for
+    };
+
+    static quint64 tileKey(int level, int x, int y);
+    static QImage colorize(const QVector<float>& density);
+    const QImage& picture(int level, int x, int y);
+
+    QPointer<MapPhotoListModel> mModel;
+    qreal mZoom = 0;
+    QGeoCoordinate mCenter;
+
+    QCache<quint64, Picture> mPictures; // cost in KB
+    QImage mEmpty;
+};
+
+#endif // HEATMAPLAYER_H
@@ -4,13 +4,13 @@
 #include <QFileDialog>
 #include <QFileSystemModel>
 #include <QGeoCoordinate>
-#include <QImageReader>
 #include <QMessageBox>
 #include <QPainter>
 #include <QPushButton>
 #include <QQmlContext>
 #include <QQmlEngine>
 #include <QQmlError>
+#include <QScreen>
 #include <QSortFilterProxyModel>
 #include <QStandardPaths>
 #include <QStringListModel>
@@ -18,18 +18,29 @@
 #include <QTableView>
 #include <QTimer>
 #include <QToolTip>
+#include <QWheelEvent>
 
+#include <algorithm>
 #include <cmath>
+#include <iterator>
 
 #include "exif/file.h"
 
 #include "abstractsettings.h"
 #include "exifstorage.h"
+#include "heatmaplayer.h"
 #include "keywordsdialog.h"
 #include "model.h"
 #include "mainwindow.h"
+#include "markerlayer.h"
 #include "pics.h"
+#include "previewloader.h"
 #include "qtcompat.h"
+#include "thumbnailatlas.h"
+#include "thumbnaildelegate.h"
+#include "tileserver.h"
+#include "tileview.h"
+#include "timeline.h"
 #include "tooltip.h"
 #include "ui_mainwindow.h"
 
@@ -48,8 +59,20 @@ struct Settings : AbstractSettings
         struct { State state = "window/treeSplitter.state"; } treeSplitter;
         struct { State state = "window/centralSplitter.state"; } centralSplitter;
         struct { State state = "window/header.state"; } header;
+        Tag<int> listIconSize = "window/listIconSize";
     } window;
 
+    struct {
+        Tag<qreal> heatmapZoom = "map/heatmapZoom";
+        struct {
+            Tag<QString> upstream = "map/tiles/upstream";       // a URL template, or TileServer::STAND_IN
+            Tag<int> cacheMB = "map/tiles/cacheMB";
+            Tag<int> seedZoom = "map/tiles/seedZoom";           // 0 seeds nothing
+            Tag<int> latency = "map/tiles/latency";             // of the stand-in, ms
+            Tag<bool> prefetch = "map/tiles/prefetch";          // the tiles around the viewport and along the animations
+        } tiles;
+    } map;
+
     struct {
         Geometry geometry = "keywordDialog/geometry";
         Tag<bool> overwriteSilently = "keywordDialog/overwriteSilently";
@@ -75,9 +98,9 @@ public:
     }
 };
 
-class SLPreviewDelegate : public QStyledItemDelegate
+class SLPreviewDelegate : public ThumbnailDelegate
 {
-    using Super = QStyledItemDelegate;
+    using Super = ThumbnailDelegate;
 
     // TODO use FileTreeModel with proxy model without any delegate
     QFileSystemModel* mSourceModel = nullptr;
@@ -93,13 +116,12 @@ public:
 protected:
     void initStyleOption(QStyleOptionViewItem* option, const QModelIndex& index) const override {
         Super::initStyleOption(option, index);
-        QString path = IFileListModel::path(index);
-        if (auto photo = ExifStorage::data(path))
-            option->icon = photo->pix32;
-        else
-            option->icon = qvariant_cast<QIcon>(mSourceModel->data(mSourceModel->index(path), Qt::DecorationRole));
-        if (!option->icon.isNull())
-            option->features |= QStyleOptionViewItem::HasDecoration;
+        if (!ExifStorage::hasThumbnail(IFileListModel::id(index)))
+        {
+            option->icon = qvariant_cast<QIcon>(mSourceModel->data(mSourceModel->index(IFileListModel::path(index)), Qt::DecorationRole));
+            if (!option->icon.isNull())
+                option->features |= QStyleOptionViewItem::HasDecoration;
+        }
     }
 };
 
@@ -195,6 +217,7 @@ MainWindow::MainWindow(QWidget *parent)
     , mCheckedModel(new PhotoListModel(this))
     , mMapModel(new MapPhotoListModel)
     , mMapSelectionModel(new MapSelectionModel(mMapModel))
+    , mPreview(new PreviewLoader(this))
 {
     ui->setupUi(this);
 
@@ -208,6 +231,7 @@ MainWindow::MainWindow(QWidget *parent)
     QList<QAction*> actions = { ui->actionCheck, ui->actionUncheck,
                                 ui->actionSeparator1,
                                 ui->actionEditKeywords,
+                                ui->actionInspect,
                                 ui->actionSeparator2,
                                 ui->actionIconView, ui->actionTreeView };
     ui->tree->addActions(actions);
@@ -217,7 +241,9 @@ MainWindow::MainWindow(QWidget *parent)
     ui->root->setItemDelegate(comboDelegate);
     connect(comboDelegate, &ItemButtonDelegate::buttonPressed, ui->root, &QComboBox::removeItem);
 
+    ui->tree->setItemDelegateForColumn(FileTreeModel::COLUMN_NAME, new ThumbnailDelegate(this));
     ui->tree->setItemDelegateForColumn(FileTreeModel::COLUMN_COORDS, new GeoCoordinateDelegate(this));
+    ui->list->setItemDelegate(new ThumbnailDelegate(this));
     ui->checked->setItemDelegate(new SLPreviewDelegate(mTreeModel, this));
 
     ui->tree->setModel(mTreeModel);
@@ -234,8 +260,6 @@ MainWindow::MainWindow(QWidget *parent)
     connect(ui->checked->selectionModel(), &QItemSelectionModel::currentChanged, this, &MainWindow::syncCurrentIndex);
     connect(mMapSelectionModel, &MapSelectionModel::currentChanged, this, &MainWindow::syncCurrentIndex);
 
-    connect(mMapModel, &MapPhotoListModel::updated, mMapSelectionModel, &MapSelectionModel::clear);
-
     connect(ui->list, &QListView::doubleClicked, this, &MainWindow::on_tree_doubleClicked);
 
     connect(ui->map, &QQuickWidget::statusChanged, [this](QQuickWidget::Status status){
@@ -256,19 +280,46 @@ MainWindow::MainWindow(QWidget *parent)
     */
 
     connect(mTreeModel, &FileTreeModel::itemChecked, this, [this](const QString& path, bool checked){
+        PhotoId id = ExifStorage::id(path);
         if (checked) {
-            ExifStorage::parse(path);
-            mMapModel->insert(path);
-            mCheckedModel->insert(path);
+            ExifStorage::parse(id);
+            mMapModel->insert(id);
+            mCheckedModel->insert(id);
         } else {
-            ExifStorage::cancel(path);
-            mMapModel->remove(path);
-            mCheckedModel->remove(path);
+            ExifStorage::cancel(id);
+            mMapModel->remove(id);
+            mCheckedModel->remove(id);
         }
     });
 
+    // stale cells must be dropped before the models ask for the new ones
+    connect(ExifStorage::instance(), &ExifStorage::ready, this, [](const QSharedPointer<Photo>& photo){
+        ThumbnailAtlas::remove(photo->id); });
     connect(ExifStorage::instance(), &ExifStorage::ready, mMapModel, &MapPhotoListModel::update);
+    connect(ExifStorage::instance(), &ExifStorage::ready, mCheckedModel, &PhotoListModel::update);
+    connect(ExifStorage::instance(), &ExifStorage::ready, ui->timeline, &Timeline::refresh);
+
+    connect(mPreview, &PreviewLoader::loaded, this, [this](PhotoId /*id*/, const QImage& image){
+        ui->picture->setImage(image); });
+
+    // a bigger pyramid level replaces its smaller stand-in; the atlas cells of the other levels are kept
+    connect(ExifStorage::instance(), &ExifStorage::thumbnailReady, this, [this](PhotoId id, int level){
+        ThumbnailAtlas::refresh(id, level);
+        ui->checked->viewport()->update(); });
+
+    connect(ui->timeline, &Timeline::periodChanged, this, [this](const Period& period){
+        mMapModel->setPeriod(period);
+        mCheckedModel->setPeriod(period);
+    });
     connect(ExifStorage::instance(), &ExifStorage::remains, this, [this](int count){
+        // all the photos are known now: their area is fetched ahead for offline use, if wanted;
+        // a photo parsed again, e.g. after saving its keywords, rarely moves the area
+        if (count == 0 && Settings().map.tiles.seedZoom > 0 && mMapModel->bounds() != mSeeded)
+        {
+            mSeeded = mMapModel->bounds();
+            mTiles->seed(mSeeded, Settings().map.tiles.seedZoom);
+        }
+
         static QElapsedTimer timer;
         if (count && timer.isValid() && timer.elapsed() < 500)
             return;
@@ -279,10 +330,21 @@ MainWindow::MainWindow(QWidget *parent)
     ui->map->installEventFilter(this);
     ui->tree->installEventFilter(this);
     ui->list->installEventFilter(this);
+    ui->list->viewport()->installEventFilter(this);
+
+    // QML-used, so not parented, as the map model
+    Settings settings;
+    const QString cache = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QDir().mkpath(cache);
+    mTiles = new TileServer(cache + "/tiles.pack", settings.map.tiles.cacheMB(256) * 1024 * 1024 / TilePack::SLOT_SIZE,
+                            settings.map.tiles.upstream(TileServer::OSM), settings.map.tiles.latency(0), settings.map.tiles.prefetch(false));
 
+    qmlRegisterType<MarkerLayer>("GeoViewer", 1, 0, "MarkerLayer");
+    qmlRegisterType<HeatmapLayer>("GeoViewer", 1, 0, "HeatmapLayer");
     QQmlEngine* engine = ui->map->engine();
     engine->rootContext()->setContextProperty("controller", mMapModel);
     engine->rootContext()->setContextProperty("selection", mMapSelectionModel);
+    engine->rootContext()->setContextProperty("tiles", mTiles);
     ui->map->setSource(QUrl("qrc:/map.qml"));
     loadSettings();
 
@@ -313,6 +375,16 @@ bool MainWindow::eventFilter(QObject* o, QEvent* e)
         showTooltip(static_cast<QHelpEvent*>(e)->globalPos(), ui->tree);
     if (o == ui->list && e->type() == QEvent::ToolTip)
         showTooltip(static_cast<QHelpEvent*>(e)->globalPos(), ui->list);
+    if (o == ui->list->viewport() && e->type() == QEvent::Wheel)
+    {
+        auto wheel = static_cast<QWheelEvent*>(e);
+        if (wheel->modifiers() & Qt::ControlModifier)
+        {
+            const int size = ui->list->iconSize().width();
+            setListIconSize(wheel->angleDelta().y() > 0 ? size * 2 : size / 2);
+            return true;
+        }
+    }
     return QObject::eventFilter(o, e);
 }
 
@@ -332,6 +404,8 @@ void MainWindow::loadSettings()
     setHistory(settings.dirs.history);
     ui->root->setCurrentText(settings.dirs.root(QSP::writableLocation(QSP::PicturesLocation)));
     ui->filter->setText(settings.filter("*.jpg;*.jpeg"));
+    setListIconSize(settings.window.listIconSize(ExifReader::thumbnailSize));
+    mMapModel->setHeatmapZoom(settings.map.heatmapZoom(MapPhotoListModel::HEATMAP_ZOOM));
 }
 
 void MainWindow::saveSettings()
@@ -348,6 +422,8 @@ void MainWindow::saveSettings()
     settings.dirs.history = history();
     settings.dirs.root = ui->root->currentText();
     settings.filter = ui->filter->text();
+    settings.window.listIconSize = ui->list->iconSize().width();
+    settings.map.heatmapZoom = mMapModel->heatmapZoom();
 
     if (auto dialog = keywordsDialog(CreateOption::Never))
     {
@@ -361,13 +437,13 @@ void MainWindow::showMapTooltip(const QPoint& pos)
     int row = mMapSelectionModel->howeredRow();
 
     QModelIndex index = mMapModel->index(row, 0);
-    QStringList files = mMapModel->data(index, MapPhotoListModel::Role::Files).toStringList();
+    PhotoIdList files = mMapModel->data(index, MapPhotoListModel::Role::Files).value<PhotoIdList>();
     if (files.isEmpty())
         return;
 
     if (files.size() == 1)
     {
-        QToolTip::showText(pos, files.first(), this);
+        QToolTip::showText(pos, ExifStorage::path(files.first()), this);
         return;
     }
 
@@ -378,10 +454,8 @@ void MainWindow::showMapTooltip(const QPoint& pos)
         connect(widget->selectionModel(), &QItemSelectionModel::selectionChanged, this, &MainWindow::syncSelection);
         connect(widget->selectionModel(), &QItemSelectionModel::currentChanged, this, &MainWindow::syncCurrentIndex);
         connect(widget, &GridToolTip::doubleClicked, this, [this](const QModelIndex& index){
-            if (auto photo = ExifStorage::data(IFileListModel::path(index))) {
-                mMapModel->setZoom(18);
-                mMapModel->setCenter(photo->position);
-            }
+            if (auto photo = ExifStorage::data(IFileListModel::id(index)))
+                mMapModel->flyTo(photo->position, 18);
         });
     }
 
@@ -399,10 +473,19 @@ void MainWindow::showTooltip(const QPoint& pos, QAbstractItemView* view)
     static auto widget = new LabelTooltip(this);
 
     Exif::File exif(path);
-    widget->setPixmap(exif.thumbnail(300, 200));
+    widget->setPixmap(QPixmap::fromImage(exif.thumbnail(300, 200)));
     widget->showAt(pos, 2);
 }
 
+/// Ctrl + wheel steps through the thumbnail pyramid levels
+void MainWindow::setListIconSize(int size)
+{
+    const int min = ExifReader::thumbnailSize;
+    const int max = ExifReader::thumbnailSize << (ThumbnailStore::LEVELS - 1);
+    size = std::max(min, std::min(size, max));
+    ui->list->setIconSize(QSize(size, size));
+}
+
 QStringList MainWindow::history() const
 {
     QStringList hist;
@@ -446,7 +529,7 @@ KeywordsDialog* MainWindow::keywordsDialog(CreateOption createOption)
     connect(dialog, &KeywordsDialog::apply, this, &MainWindow::saveKeywords);
 
     if (currentView()->selectionModel()->hasSelection())
-        updateKeywordsDialog(mTreeModel->path(currentSelection()));
+        updateKeywordsDialog(IFileListModel::id(currentSelection()));
 
 
     return dialog;
@@ -458,50 +541,58 @@ void MainWindow::keywordsChanged()
     {
         QStringList keywords = keywordsDialog()->model()->values(Qt::Checked); // TODO encapsulate
         auto logic = keywordsDialog()->button(KeywordsDialog::Button::Or)->isChecked() ? ExifStorage::Logic::Or : ExifStorage::Logic::And;
-        auto files = ExifStorage::byKeywords(keywords, logic);
-        auto checked = QtCompat::toSet(mCheckedModel->stringList());
+        Bitmap files = ExifStorage::byKeywords(keywords, logic);
+        Bitmap checked;
+        for (PhotoId id: mCheckedModel->ids())
+            checked.insert(id);
 
-        auto toCheck = files - checked;
-        auto toUncheck = checked - files;
+        (files - checked).forEach([this](PhotoId id){
+            mTreeModel->setData(mTreeModel->index(id), Qt::Checked, Qt::CheckStateRole); });
 
-        for (const auto& path: toCheck)
-            mTreeModel->setData(mTreeModel->index(path), Qt::Checked, Qt::CheckStateRole);
-
-        for (const auto& path: toUncheck)
-            mTreeModel->setData(mTreeModel->index(path), Qt::Unchecked, Qt::CheckStateRole);
+        (checked - files).forEach([this](PhotoId id){
+            mTreeModel->setData(mTreeModel->index(id), Qt::Unchecked, Qt::CheckStateRole); });
     }
 }
 
-void MainWindow::updateKeywordsDialog(const QStringList& selectedFiles)
+void MainWindow::updateKeywordsDialog(const PhotoIdList& selectedFiles)
 {
     if (auto dialog = keywordsDialog(CreateOption::Never)) {
         if (dialog->mode() == KeywordsDialog::Mode::Edit) {
 
-            QSet<QString> all, common, partially;
-
-            for (const QString& path: selectedFiles) {
-                if (QFileInfo(path).isDir()) continue;
-                QString keywordsTag;
-                if (auto photo = ExifStorage::data(path))
-                    keywordsTag = photo->keywords;
-                else
-                    keywordsTag = Exif::File(path, false).value(EXIF_IFD_0, EXIF_TAG_XP_KEYWORDS).toString();
-
-                QSet<QString> keywords;
+            KeywordIdList all, common;
+            bool first = true;
 
-                for (QString& s: keywordsTag.split(';'))
-                    keywords.insert(s.trimmed());
+            // the ids are photos only, the directories have none
+            for (PhotoId id: selectedFiles) {
+                KeywordIdList keywords = ExifStorage::keywordIds(id);
 
-                if (all.isEmpty()) {
+                if (first) {
                     all = common = keywords;
+                    first = false;
                 } else {
-                    all.unite(keywords);
-                    common.intersect(keywords);
-                    partially = all - common;
+                    // both lists are sorted, so merging them is linear
+                    KeywordIdList merged;
+                    std::set_union(all.cbegin(), all.cend(), keywords.cbegin(), keywords.cend(), std::back_inserter(merged));
+                    all.swap(merged);
+
+                    KeywordIdList intersected;
+                    std::set_intersection(common.cbegin(), common.cend(), keywords.cbegin(), keywords.cend(), std::back_inserter(intersected));
+                    common.swap(intersected);
                 }
             }
 
-            dialog->model()->setChecked(common, partially);
+            KeywordIdList rest;
+            std::set_difference(all.cbegin(), all.cend(), common.cbegin(), common.cend(), std::back_inserter(rest));
+
+            QSet<QString> partially;
+            for (const QString& keyword: ExifStorage::keywords(rest))
+                partially.insert(keyword);
+
+            QSet<QString> checked;
+            for (const QString& keyword: ExifStorage::keywords(common))
+                checked.insert(keyword);
+
+            dialog->model()->setChecked(checked, partially);
             dialog->button(KeywordsDialog::Button::Apply)->setEnabled(false);
         }
     }
@@ -514,7 +605,7 @@ void MainWindow::saveKeywords()
     if (!currentView()->selectionModel()->hasSelection())
         return;
 
-    QStringList selectedFiles = mTreeModel->path(currentSelection());
+    PhotoIdList selectedFiles = IFileListModel::id(currentSelection());
 
     if (!settings.keywordDialog.overwriteSilently) {
         using QMBox = QMessageBox;
@@ -528,8 +619,8 @@ void MainWindow::saveKeywords()
 
     QGuiApplication::setOverrideCursor(Qt::WaitCursor);
 
-    for (const auto& path: selectedFiles) {
-        if (QFileInfo(path).isDir()) continue;
+    for (PhotoId id: selectedFiles) {
+        QString path = ExifStorage::path(id);
         Exif::File file;
         if (!file.load(path)) {
             QMessageBox::warning(this, "", tr("Load '%1' failed: %2").arg(path, file.errorString()));
@@ -543,7 +634,7 @@ void MainWindow::saveKeywords()
             return;
         }
 
-        ExifStorage::parse(path);
+        ExifStorage::parse(id);
     }
 
     QGuiApplication::restoreOverrideCursor();
@@ -552,25 +643,25 @@ void MainWindow::saveKeywords()
     keywordsDialog()->model()->setExtraFlags(Qt::NoItemFlags); // reset
 }
 
-void MainWindow::updatePicture(const QString& path)
+/// shows the cached preview or the biggest thumbnail at once, the decoded preview replaces it when it is ready
+void MainWindow::updatePicture(const QString& path, const PhotoIdList& neighbours)
 {
     if (path.isEmpty() || QFileInfo(path).isDir())
     {
+        mPreview->show(INVALID_PHOTO_ID, {});
         ui->picture->setPath("");
-        ui->picture->setPixmap({});
+        ui->picture->setImage({});
         return;
     }
 
     ui->picture->setPath(path);
 
-    Exif::Orientation orientation;
-    if (auto photo = ExifStorage::data(path))
-        orientation = photo->orientation;
-    else
-        orientation = Exif::File(path, false).orientation();
+    const PhotoId id = ExifStorage::id(path);
+    QImage image = mPreview->show(id, ui->picture->screen()->size() * ui->picture->devicePixelRatioF(), neighbours);
+    if (image.isNull())
+        image = ExifStorage::thumbnail(id, ExifReader::thumbnailSize << (ThumbnailStore::LEVELS - 1));
 
-    QImageReader reader(path);
-    ui->picture->setPixmap(Pics::fromImageReader(&reader, orientation));
+    ui->picture->setImage(image);
 }
 
 void MainWindow::syncSelection()
@@ -583,7 +674,7 @@ void MainWindow::syncSelection()
         {
             previousSelection = currentSelection;
 
-            QStringList selectedFiles = IFileListModel::path(currentSelection);
+            PhotoIdList selectedFiles = IFileListModel::id(currentSelection);
 
             // qDebug() << __func__ << "from" << source->objectName() << selectedFiles;
 
@@ -601,12 +692,12 @@ void MainWindow::syncSelection()
     }
 }
 
-void MainWindow::applySelection(QAbstractItemView* to, const QStringList& selectedFiles)
+void MainWindow::applySelection(QAbstractItemView* to, const PhotoIdList& selectedFiles)
 {
     applySelection(to->selectionModel(), selectedFiles);
 }
 
-void MainWindow::applySelection(QItemSelectionModel* to, const QStringList& selectedFiles)
+void MainWindow::applySelection(QItemSelectionModel* to, const PhotoIdList& selectedFiles)
 {
     if (!to || !to->model())
     {
@@ -617,11 +708,11 @@ void MainWindow::applySelection(QItemSelectionModel* to, const QStringList& sele
     if (auto model = dynamic_cast<IFileListModel*>(to->model()))
     {
         QModelIndexList selection;
-        for (const QString& path: selectedFiles)
+        for (PhotoId id: selectedFiles)
         {
-            auto i = model->index(path);
+            auto i = model->index(id);
             if (i.isValid())
-                selection.append(model->index(path));
+                selection.append(i);
         }
 
         QModelIndexList& previousSelection = mSelection[to];
@@ -650,31 +741,40 @@ void MainWindow::syncCurrentIndex(const QModelIndex& currentIndex)
         {
 
             previousIndex = currentIndex;
-            QString path = IFileListModel::path(currentIndex);
+            PhotoId id = IFileListModel::id(currentIndex);
 
-            // qDebug() << __func__ << "from" << source->objectName() << path;
+            // qDebug() << __func__ << "from" << source->objectName() << id;
 
             if (source != ui->tree->selectionModel())
-                applyCurrentIndex(ui->tree, path);
+                applyCurrentIndex(ui->tree, id);
             if (source != ui->list->selectionModel())
-                applyCurrentIndex(ui->list, path);
+                applyCurrentIndex(ui->list, id);
             if (source != ui->checked->selectionModel())
-                applyCurrentIndex(ui->checked, path);
+                applyCurrentIndex(ui->checked, id);
             if (source != mMapSelectionModel)
-                applyCurrentIndex(mMapSelectionModel, path);
+                applyCurrentIndex(mMapSelectionModel, id);
+
+            // stepping through a folder goes to one of them; its subfolders are no previews
+            PhotoIdList neighbours;
+            for (int step: { -1, 1 })
+            {
+                const QModelIndex neighbour = currentIndex.sibling(currentIndex.row() + step, currentIndex.column());
+                if (IFileListModel::isPhoto(neighbour))
+                    neighbours.append(IFileListModel::id(neighbour));
+            }
 
-            updatePicture(path);
+            updatePicture(ExifStorage::path(id), neighbours);
         }
 
     }
 }
 
-void MainWindow::applyCurrentIndex(QAbstractItemView* to, const QString& path)
+void MainWindow::applyCurrentIndex(QAbstractItemView* to, PhotoId id)
 {
-    applyCurrentIndex(to->selectionModel(), path, to);
+    applyCurrentIndex(to->selectionModel(), id, to);
 }
 
-void MainWindow::applyCurrentIndex(QItemSelectionModel* to, const QString& path, QAbstractItemView* view)
+void MainWindow::applyCurrentIndex(QItemSelectionModel* to, PhotoId id, QAbstractItemView* view)
 {
     if (!to || !to->model())
     {
@@ -685,12 +785,12 @@ void MainWindow::applyCurrentIndex(QItemSelectionModel* to, const QString& path,
     if (auto model = dynamic_cast<IFileListModel*>(to->model()))
     {
         QModelIndex& previous = mCurrentIndex[to];
-        QModelIndex current = model->index(path);
+        QModelIndex current = model->index(id);
         if (previous != current)
         {
             using QSM = QItemSelectionModel;
 
-            // qDebug() << __func__ << "to" << to->objectName() << path;
+            // qDebug() << __func__ << "to" << to->objectName() << id;
 
             previous = current;
 
@@ -782,10 +882,7 @@ void MainWindow::on_tree_doubleClicked(const QModelIndex& index)
 
     auto coords = index.siblingAtColumn(FileTreeModel::COLUMN_COORDS).data().toPointF();
     if (!coords.isNull())
-    {
-        mMapModel->setZoom(18);
-        mMapModel->setCenter(coords);
-    }
+        mMapModel->flyTo(coords, 18);
 }
 
 void MainWindow::on_actionCheck_triggered()
@@ -808,11 +905,34 @@ void MainWindow::on_actionEditKeywords_triggered(bool checked)
     if (keywordsDialog()->mode() == KeywordsDialog::Mode::Filter)
         keywordsDialog()->model()->setChecked({}, {});
     else
-        updateKeywordsDialog(mTreeModel->path(currentSelection()));
+        updateKeywordsDialog(IFileListModel::id(currentSelection()));
 
     keywordsDialog()->show();
 }
 
+void MainWindow::on_actionInspect_triggered()
+{
+    const QString path = ExifStorage::path(IFileListModel::id(currentView()->currentIndex()));
+    if (path.isEmpty() || QFileInfo(path).isDir())
+        return;
+
+    tileView()->setPath(path);
+    tileView()->show();
+    tileView()->raise();
+    tileView()->activateWindow();
+}
+
+TileView* MainWindow::tileView()
+{
+    if (!mTileView)
+    {
+        mTileView = new TileView(this);
+        mTileView->setWindowFlag(Qt::Window);
+        mTileView->resize(size());
+    }
+    return mTileView;
+}
+
 void MainWindow::on_actionIconView_toggled(bool toggled)
 {
     ui->stackedWidget->setCurrentWidget(toggled ? ui->pageList : ui->pageTree);
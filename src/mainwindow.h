@@ -1,10 +1,13 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QGeoRectangle>
 #include <QImage>
 #include <QItemDelegate>
 #include <QMainWindow>
 
+#include "photoid.h"
+
 QT_BEGIN_NAMESPACE
 namespace Ui {
 class MainWindow;
@@ -21,6 +24,9 @@ class KeywordsDialog;
 class PhotoListModel;
 class MapPhotoListModel;
 class MapSelectionModel;
+class PreviewLoader;
+class TileServer;
+class TileView;
 
 /// combobox item with [x] button
 class ItemButtonDelegate : public QItemDelegate
@@ -73,6 +79,7 @@ private:
 
     void showMapTooltip(const QPoint& pos);
     void showTooltip(const QPoint& pos, QAbstractItemView* view);
+    void setListIconSize(int size);
 
     QStringList history() const;
     void setHistory(const QStringList& history);
@@ -80,18 +87,20 @@ private:
     enum class CreateOption { Never, IfNotExists };
     KeywordsDialog* keywordsDialog(CreateOption createOption = CreateOption::IfNotExists);
     void keywordsChanged();
-    void updateKeywordsDialog(const QStringList& selectedFiles);
+    void updateKeywordsDialog(const PhotoIdList& selectedFiles);
     void saveKeywords();
 
-    void updatePicture(const QString& path);
+    TileView* tileView();
+
+    void updatePicture(const QString& path, const PhotoIdList& neighbours = {});
 
     void syncSelection();
-    void applySelection(QAbstractItemView* to, const QStringList& selectedFiles);
-    void applySelection(QItemSelectionModel* to, const QStringList& selectedFiles);
+    void applySelection(QAbstractItemView* to, const PhotoIdList& selectedFiles);
+    void applySelection(QItemSelectionModel* to, const PhotoIdList& selectedFiles);
 
     void syncCurrentIndex(const QModelIndex& currentIndex);
-    void applyCurrentIndex(QAbstractItemView* to, const QString& path);
-    void applyCurrentIndex(QItemSelectionModel* to, const QString& path, QAbstractItemView* view = nullptr);
+    void applyCurrentIndex(QAbstractItemView* to, PhotoId id);
+    void applyCurrentIndex(QItemSelectionModel* to, PhotoId id, QAbstractItemView* view = nullptr);
 
     QAbstractItemView* currentView() const;
     QModelIndexList currentSelection() const;
@@ -106,6 +115,7 @@ private slots:
     void on_actionCheck_triggered();
     void on_actionUncheck_triggered();
     void on_actionEditKeywords_triggered(bool checked);
+    void on_actionInspect_triggered();
     void on_actionIconView_toggled(bool toggled);
 
 private:
@@ -114,6 +124,10 @@ private:
     PhotoListModel* mCheckedModel = nullptr;
     MapPhotoListModel* mMapModel = nullptr;
     MapSelectionModel* mMapSelectionModel = nullptr;
+    PreviewLoader* mPreview = nullptr;
+    TileServer* mTiles = nullptr;
+    QGeoRectangle mSeeded;              // the area of the photos the tiles were seeded for
+    TileView* mTileView = nullptr;      // created on the first inspection
 
     QMap<QItemSelectionModel*, QModelIndexList> mSelection;
     QMap<QItemSelectionModel*, QModelIndex> mCurrentIndex;
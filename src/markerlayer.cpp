@@ -0,0 +1,198 @@
+#include <QMouseEvent>
+#include <QPainter>
+
+#include <cmath>
+
+#include "clusters.h"
+#include "markerlayer.h"
+#include "thumbnailatlas.h"
+
+namespace
+{
+
+const QColor SELECTED(0, 0, 0x40, 0x40);
+
+} // namespace
+
+MarkerLayer::MarkerLayer(QQuickItem* parent) : Super(parent)
+{
+    setAcceptedMouseButtons(Qt::LeftButton);
+    setAcceptHoverEvents(true);
+
+    connect(ThumbnailAtlas::instance(), &ThumbnailAtlas::changed, this, [this](){ update(); });
+}
+
+void MarkerLayer::setModel(MapPhotoListModel* model)
+{
+    if (model == mModel)
+        return;
+
+    if (mModel)
+        mModel->disconnect(this);
+
+    mModel = model;
+    if (mModel)
+    {
+        connect(mModel, &QAbstractItemModel::rowsInserted, this, [this](){ update(); });
+        connect(mModel, &QAbstractItemModel::rowsRemoved, this, [this](){ update(); });
+        connect(mModel, &QAbstractItemModel::dataChanged, this, [this](){ update(); });
+        connect(mModel, &QAbstractItemModel::modelReset, this, [this](){ update(); });
+    }
+
+    update();
+    emit modelChanged();
+}
+
+void MarkerLayer::setSelectionModel(MapSelectionModel* selection)
+{
+    if (selection == mSelection)
+        return;
+
+    if (mSelection)
+        mSelection->disconnect(this);
+
+    mSelection = selection;
+    if (mSelection)
+        connect(mSelection, &QItemSelectionModel::currentChanged, this, [this](){ update(); });
+
+    update();
+    emit selectionModelChanged();
+}
+
+void MarkerLayer::setZoom(qreal zoom)
+{
+    if (qFuzzyCompare(zoom, mZoom))
+        return;
+
+    mZoom = zoom;
+    update();
+    emit zoomChanged();
+}
+
+void MarkerLayer::setCenter(const QGeoCoordinate& center)
+{
+    if (center == mCenter)
+        return;
+
+    mCenter = center;
+    update();
+    emit centerChanged();
+}
+
+void MarkerLayer::paint(QPainter* painter)
+{
+    if (!mModel || !mCenter.isValid())
+        return;
+
+    const int size = MapPhotoListModel::THUMBNAIL_SIZE;
+    const qreal scale = Mercator::scale(mZoom);
+    const QPointF center = centerPoint();
+    const QPointF middle(width() / 2, height() / 2);
+    const QRectF visible = boundingRect().adjusted(-size, -size, size, size);
+    const int current = mSelection ? mSelection->currentRow() : -1;
+
+    for (int row = 0, rows = mModel->rowCount(); row < rows; ++row)
+    {
+        const ClusterIndex::Cluster* bucket = mModel->bucket(row);
+        if (!bucket)
+            continue;
+
+        // the copy of the world nearest to the center
+        QPointF offset = bucket->projected() - center;
+        if (offset.x() > Mercator::TILE / 2)
+            offset.rx() -= Mercator::TILE;
+        else if (offset.x() < -Mercator::TILE / 2)
+            offset.rx() += Mercator::TILE;
+
+        const QPointF position = middle + offset * scale;
+        if (!visible.contains(position))
+            continue;
+
+        QRect target;
+        if (bucket->photos.size() == 1)
+        {
+            // the model packs the photos of its rows, a photo not packed yet is drawn as a bubble
+            const ThumbnailAtlas::Handle handle = ThumbnailAtlas::handle(bucket->photos.first(), size);
+            target = QRect(QPoint(), handle.rect.size());
+            target.moveCenter(position.toPoint());
+            if (handle.isNull() || !ThumbnailAtlas::paint(painter, target, handle))
+            {
+                const QImage& image = bubble(1);
+                target = QRect(QPoint(), image.size());
+                target.moveCenter(position.toPoint());
+                painter->drawImage(target, image);
+            }
+        }
+        else
+        {
+            const QImage& image = bubble(bucket->photos.size());
+            target = QRect(QPoint(), image.size());
+            target.moveCenter(position.toPoint());
+            painter->drawImage(target, image);
+        }
+
+        if (row == current)
+            painter->fillRect(target, SELECTED);
+    }
+}
+
+int MarkerLayer::rowAt(const QPointF& point) const
+{
+    if (!mModel || !mCenter.isValid())
+        return -1;
+
+    QPointF projected = centerPoint() + (point - QPointF(width() / 2, height() / 2)) / Mercator::scale(mZoom);
+    projected.rx() = std::fmod(projected.x(), Mercator::TILE);
+    if (projected.x() < 0)
+        projected.rx() += Mercator::TILE;
+
+    return mModel->rowAt(projected, mZoom);
+}
+
+void MarkerLayer::mousePressEvent(QMouseEvent* e)
+{
+    mPressed = rowAt(e->localPos());
+    if (mPressed == -1)
+        e->ignore(); // the map pans
+}
+
+void MarkerLayer::mouseReleaseEvent(QMouseEvent* e)
+{
+    const int row = rowAt(e->localPos());
+    if (row != -1 && row == mPressed)
+        emit clicked(row);
+    mPressed = -1;
+}
+
+void MarkerLayer::hoverMoveEvent(QHoverEvent* e)
+{
+    setHovered(rowAt(e->posF()));
+}
+
+void MarkerLayer::hoverLeaveEvent(QHoverEvent* /*e*/)
+{
+    setHovered(-1);
+}
+
+/// the map center in zoom 0 pixels
+QPointF MarkerLayer::centerPoint() const
+{
+    return Mercator::project({ mCenter.latitude(), mCenter.longitude() });
+}
+
+void MarkerLayer::setHovered(int row)
+{
+    if (row == mHovered)
+        return;
+
+    mHovered = row;
+    emit hovered(row);
+}
+
+const QImage& MarkerLayer::bubble(int count)
+{
+    auto it = mBubbles.find(count);
+    if (it == mBubbles.end())
+        it = mBubbles.insert(count, Bubbles::generate(count, MapPhotoListModel::THUMBNAIL_SIZE, Qt::darkBlue));
+    return *it;
+}
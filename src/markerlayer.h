@@ -0,0 +1,72 @@
+#ifndef MARKERLAYER_H
+#define MARKERLAYER_H
+
+#include <QGeoCoordinate>
+#include <QHash>
+#include <QImage>
+#include <QPointer>
+#include <QQuickPaintedItem>
+
+#include "model.h"
+
+/// Draws the buckets of MapPhotoListModel over the map, all of them into one image:
+/// a single scene graph node instead of a delegate with an image, a shader and a mouse area per bucket,
+/// which renders the same on the software backend. Thumbnails are painted from ThumbnailAtlas pages.
+/// The layer follows the \a zoom and \a center of the map it covers (no bearing or tilt).
+/// Clicks and hover are resolved against the cluster index; a press outside the markers
+/// is left to the map below, so it still pans.
+class MarkerLayer : public QQuickPaintedItem
+{
+    using Super = QQuickPaintedItem;
+    Q_OBJECT
+
+    Q_PROPERTY(MapPhotoListModel* model MEMBER mModel WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(MapSelectionModel* selectionModel MEMBER mSelection WRITE setSelectionModel NOTIFY selectionModelChanged)
+    Q_PROPERTY(qreal zoom MEMBER mZoom WRITE setZoom NOTIFY zoomChanged)
+    Q_PROPERTY(QGeoCoordinate center MEMBER mCenter WRITE setCenter NOTIFY centerChanged)
+
+signals:
+    void modelChanged();
+    void selectionModelChanged();
+    void zoomChanged();
+    void centerChanged();
+
+    void clicked(int row);
+    /// the row under the cursor, -1 when it leaves the markers
+    void hovered(int row);
+
+public:
+    explicit MarkerLayer(QQuickItem* parent = nullptr);
+
+    void setModel(MapPhotoListModel* model);
+    void setSelectionModel(MapSelectionModel* selection);
+    void setZoom(qreal zoom);
+    void setCenter(const QGeoCoordinate& center);
+
+    void paint(QPainter* painter) override;
+
+    /// \return the topmost row drawn at the item \a point, -1 if none
+    Q_INVOKABLE int rowAt(const QPointF& point) const;
+
+protected:
+    void mousePressEvent(QMouseEvent* e) override;
+    void mouseReleaseEvent(QMouseEvent* e) override;
+    void hoverMoveEvent(QHoverEvent* e) override;
+    void hoverLeaveEvent(QHoverEvent* e) override;
+
+private:
+    QPointF centerPoint() const;
+    void setHovered(int row);
+    const QImage& bubble(int count);
+
+    QPointer<MapPhotoListModel> mModel;
+    QPointer<MapSelectionModel> mSelection;
+    qreal mZoom = 0;
+    QGeoCoordinate mCenter;
+
+    int mPressed = -1;
+    int mHovered = -1;
+    QHash<int, QImage> mBubbles;    // by count
+};
+
+#endif // MARKERLAYER_H
@@ -7,7 +7,9 @@
 #include <QPixmap>
 #include <QThread>
 
+#include <algorithm>
 #include <cmath>
+#include <utility>
 
 #include "exif/file.h"
 #include "exif/utils.h"
@@ -15,10 +17,11 @@
 #include "exifstorage.h"
 #include "model.h"
 #include "pics.h"
+#include "thumbnailatlas.h"
 
 bool operator ==(const Photo& L, const Photo& R)
 {
-    return L.path == R.path && L.pixBase64 == R.pixBase64 && L.position == R.position;
+    return L.id == R.id && L.position == R.position;
 }
 
 bool operator !=(const Photo& L, const Photo& R)
@@ -100,14 +103,35 @@ QString IFileListModel::path(const QModelIndex& index)
     return index.data(FilePathRole).toString();
 }
 
-QStringList IFileListModel::path(const QModelIndexList& indexes)
+PhotoId IFileListModel::id(const QModelIndex& index)
 {
-    QStringList list;
+    QVariant id = index.data(PhotoIdRole);
+    return id.isValid() ? id.value<PhotoId>() : INVALID_PHOTO_ID;
+}
+
+bool IFileListModel::isPhoto(const QModelIndex& index)
+{
+    if (!index.isValid())
+        return false;
+
+    // the file system model knows it without a stat
+    if (auto model = qobject_cast<const QFileSystemModel*>(index.model()))
+        if (model->isDir(index))
+            return false;
+
+    return id(index) != INVALID_PHOTO_ID;
+}
+
+PhotoIdList IFileListModel::id(const QModelIndexList& indexes)
+{
+    PhotoIdList list;
+    QSet<PhotoId> unique;
     for (const auto& i: indexes)
     {
-        QString p = path(i);
-        if (!list.contains(p))
+        PhotoId p = id(i);
+        if (p != INVALID_PHOTO_ID && !unique.contains(p))
         {
+            unique.insert(p);
             list.append(p);
         }
     }
@@ -119,12 +143,27 @@ FileTreeModel::FileTreeModel(QObject *parent)
 {
     qDebug() << "main thread ID is" << QThread::currentThreadId();
 
+    // the name filters hide the other files, so the listed ones are the photos
+    connect(this, &QFileSystemModel::rowsInserted, this, [this](const QModelIndex& parent, int first, int last){
+        for (int row = first; row <= last; ++row)
+        {
+            const QModelIndex i = index(row, COLUMN_NAME, parent);
+            if (!isDir(i))
+                ExifStorage::id(filePath(i));
+        }
+    });
+
     connect(ExifStorage::instance(), &ExifStorage::ready, this, [this](const QSharedPointer<Photo>& photo){
-        QModelIndex i = index(photo->path);
+        QModelIndex i = index(photo->id);
         if (i.isValid()) {
-            emit dataChanged(i.siblingAtColumn(COLUMN_COORDS), i.siblingAtColumn(COLUMN_KEYWORDS), { Qt::DisplayRole });
+            emit dataChanged(i.siblingAtColumn(COLUMN_NAME), i.siblingAtColumn(COLUMN_KEYWORDS), { Qt::DisplayRole, Qt::DecorationRole });
         }
     });
+    connect(ExifStorage::instance(), &ExifStorage::thumbnailReady, this, [this](PhotoId id){
+        QModelIndex i = index(id);
+        if (i.isValid())
+            emit dataChanged(i, i, { Qt::DecorationRole });
+    });
 }
 
 int FileTreeModel::columnCount(const QModelIndex& /*parent*/) const
@@ -142,6 +181,10 @@ QVariant FileTreeModel::data(const QModelIndex& index, int role) const
     if (role == Qt::CheckStateRole)
         return Checker::checkState(index);
 
+    // the files are interned as they are listed, a lookup must not grow the pool
+    if (role == PhotoIdRole)
+        return index.isValid() ? QVariant::fromValue(isDir(index) ? INVALID_PHOTO_ID : ExifStorage::find(filePath(index))) : QVariant();
+
     if ((role == Qt::DisplayRole || role == Qt::EditRole) && index.column() != COLUMN_NAME)
     {
         if (isDir(index))
@@ -154,17 +197,13 @@ QVariant FileTreeModel::data(const QModelIndex& index, int role) const
             case COLUMN_COORDS:
                 return photo->position;
             case COLUMN_KEYWORDS:
-                return photo->keywords;
+                return ExifStorage::keywords(photo->keywords).join("; ");
             }
         }
 
         return {};
     }
 
-    if (role == Qt::DecorationRole && index.column() == 0 && !isDir(index))
-        if (auto photo = ExifStorage::data(filePath(index)))
-            return Pics::createIcon(photo->pix32, photo->pix16);
-
     return Super::data(index, role);
 }
 
@@ -191,9 +230,9 @@ QVariant FileTreeModel::headerData(int section, Qt::Orientation orientation, int
     return Super::headerData(section, orientation, role);
 }
 
-QModelIndex FileTreeModel::index(const QString& path) const
+QModelIndex FileTreeModel::index(PhotoId id) const
 {
-    return Super::index(path);
+    return id == INVALID_PHOTO_ID ? QModelIndex() : Super::index(ExifStorage::path(id));
 }
 
 bool FileTreeModel::setCheckState(const QModelIndex& index, const QVariant& value)
@@ -233,51 +272,164 @@ const QStringList FileTreeModel::entryList(const QString &dir, const QStringList
     return all;
 }
 
+int PhotoListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : mVisible.size();
+}
+
 QVariant PhotoListModel::data(const QModelIndex& index, int role) const
 {
-    if (role == FilePathRole)
-        return Super::data(index, Qt::DisplayRole);
-    return Super::data(index, role);
+    if (!index.isValid() || index.row() >= mVisible.size())
+        return {};
+
+    PhotoId id = mVisible.at(index.row());
+
+    if (role == PhotoIdRole)
+        return QVariant::fromValue(id);
+
+    if (role == FilePathRole || role == Qt::DisplayRole || role == Qt::EditRole)
+        return ExifStorage::path(id);
+
+    return {};
+}
+
+QModelIndex PhotoListModel::index(PhotoId id) const
+{
+    auto i = lowerBound(mVisible, id);
+    return i != mVisible.cend() && *i == id ? Super::index(static_cast<int>(std::distance(mVisible.cbegin(), i))) : QModelIndex();
 }
 
-QModelIndex PhotoListModel::index(const QString& data) const
+void PhotoListModel::insert(PhotoId id)
 {
-    int row = stringList().indexOf(data);
-    return row == -1 ? QModelIndex() : Super::index(row);
+    auto i = lowerBound(mData, id);
+    if (i != mData.cend() && *i == id)
+        return;
+
+    mData.insert(static_cast<int>(std::distance(mData.cbegin(), i)), id);
+
+    if (accepts(id))
+    {
+        int row = static_cast<int>(std::distance(mVisible.cbegin(), lowerBound(mVisible, id)));
+        beginInsertRows({}, row, row);
+        mVisible.insert(row, id);
+        endInsertRows();
+    }
 }
 
-void PhotoListModel::insert(const QString& line)
+void PhotoListModel::remove(PhotoId id)
 {
-    auto sl = stringList();
-    if (sl.contains(line))
+    auto i = lowerBound(mData, id);
+    if (i == mData.cend() || *i != id)
         return;
 
-    int row = 0;
-    while (row < sl.size() && line > sl[row])
-        ++row;
+    mData.removeAt(static_cast<int>(std::distance(mData.cbegin(), i)));
 
-    insertRow(row);
-    setData(index(row), line);
+    QModelIndex row = index(id);
+    if (row.isValid())
+    {
+        beginRemoveRows({}, row.row(), row.row());
+        mVisible.removeAt(row.row());
+        endRemoveRows();
+    }
 }
 
-void PhotoListModel::remove(const QString& line)
+/// shows or hides the photo when its capture time becomes known
+void PhotoListModel::update(const QSharedPointer<Photo>& photo)
 {
-    int row = stringList().indexOf(line);
-    if (row != -1)
-        removeRow(row);
+    if (mPeriod.isNull())
+        return;
+
+    auto i = lowerBound(mData, photo->id);
+    if (i == mData.cend() || *i != photo->id)
+        return;
+
+    QModelIndex row = index(photo->id);
+    if (row.isValid() == mPeriod.accepts(photo->time))
+        return;
+
+    if (row.isValid())
+    {
+        beginRemoveRows({}, row.row(), row.row());
+        mVisible.removeAt(row.row());
+        endRemoveRows();
+    }
+    else
+    {
+        int row = static_cast<int>(std::distance(mVisible.cbegin(), lowerBound(mVisible, photo->id)));
+        beginInsertRows({}, row, row);
+        mVisible.insert(row, photo->id);
+        endInsertRows();
+    }
+}
+
+void PhotoListModel::setPeriod(const Period& period)
+{
+    if (period == mPeriod)
+        return;
+
+    beginResetModel();
+
+    mPeriod = period;
+    if (mPeriod.isNull())
+    {
+        mVisible = mData;
+    }
+    else
+    {
+        Bitmap taken = ExifStorage::select(CatalogQuery::between(mPeriod.from, mPeriod.to));
+        mVisible.clear();
+        for (PhotoId id: mData)
+            if (taken.contains(id))
+                mVisible.append(id);
+    }
+
+    endResetModel();
+}
+
+PhotoIdList::const_iterator PhotoListModel::lowerBound(const PhotoIdList& list, PhotoId id)
+{
+    return std::lower_bound(list.cbegin(), list.cend(), id, &ExifStorage::lessPath);
+}
+
+bool PhotoListModel::accepts(PhotoId id) const
+{
+    if (mPeriod.isNull())
+        return true;
+
+    auto photo = ExifStorage::data(id);
+    return photo && mPeriod.accepts(photo->time);
 }
 
 // QML-used objects must be destoyed after QML engine so don't pass parent here
-MapPhotoListModel::MapPhotoListModel() : mBuckets(this), mBubbles(THUMBNAIL_SIZE, Qt::darkBlue)
+MapPhotoListModel::MapPhotoListModel()
+    : mClusters(new ClusterIndex::Level), mWorking(THUMBNAIL_SIZE)
 {
+    // mZoom is initialized after mLevel
+    mLevel = ClusterIndex::level(mZoom);
+    mClustersLevel = mLevel;
     ExifReader::thumbnailSize = THUMBNAIL_SIZE;
+    mPool.setMaxThreadCount(1);
+
+    mFrame.setSingleShot(true);
+    mFrame.setInterval(FRAME_MS);
+    mSettle.setSingleShot(true);
+    mSettle.setInterval(SETTLE_MS);
+    connect(&mFrame, &QTimer::timeout, this, &MapPhotoListModel::frame);
+    connect(&mSettle, &QTimer::timeout, this, &MapPhotoListModel::settled);
+
+    connect(this, &MapPhotoListModel::zoomChanged, this, &MapPhotoListModel::moved);
+}
 
-    connect(this, &MapPhotoListModel::zoomChanged, this, &MapPhotoListModel::updateBuckets);
+MapPhotoListModel::~MapPhotoListModel()
+{
+    mGeneration.ref();
+    mPool.clear();
+    mPool.waitForDone();
 }
 
 int MapPhotoListModel::rowCount(const QModelIndex& index) const
 {
-    return index.isValid() ? 0 : mBuckets.size();
+    return index.isValid() ? 0 : mRows.size();
 }
 
 QVariant MapPhotoListModel::data(const QModelIndex& index, int role) const
@@ -286,22 +438,24 @@ QVariant MapPhotoListModel::data(const QModelIndex& index, int role) const
     if (!ok)
         return {};
 
-    const Bucket& bucket = mBuckets.at(index.row());
-
-    if (role == Role::Pixmap)
-        return bucket.photos.size() == 1 ? bucket.photos.first()->pixBase64 : mBubbles.bubble(bucket.photos.size());
+    const ClusterIndex::Cluster* bucket = this->bucket(index.row());
+    if (!bucket)
+        return {};
 
     if (role == Role::Path)
-        return bucket.photos.size() ? QVariant(bucket.photos.first()->path) : QVariant();
+        return bucket->photos.size() ? QVariant(ExifStorage::path(bucket->photos.first())) : QVariant();
+
+    if (role == PhotoIdRole)
+        return bucket->photos.size() ? QVariant::fromValue(bucket->photos.first()) : QVariant();
 
     if (role == Role::Files)
-        return bucket.files();
+        return QVariant::fromValue(bucket->photos);
 
     if (role == Role::Latitude)
-        return bucket.position.x();
+        return bucket->position().x();
 
     if (role == Role::Longitude)
-        return bucket.position.y();
+        return bucket->position().y();
 
     return {};
 }
@@ -309,7 +463,6 @@ QVariant MapPhotoListModel::data(const QModelIndex& index, int role) const
 QHash<int, QByteArray> MapPhotoListModel::roleNames() const
 {
     QHash<int, QByteArray> roles;
-    roles[Role::Pixmap] = "_pixmap_";
     roles[Role::Path] = "_path_";
     roles[Role::Files] = "_files_";
     roles[Role::Latitude] = "_latitude_";
@@ -319,31 +472,96 @@ QHash<int, QByteArray> MapPhotoListModel::roleNames() const
 
 void MapPhotoListModel::clear()
 {
+    beginResetModel();
     mKeys.clear();
-    mBuckets.clear();
+    mPositions.clear();
+    mHeatmap.clear();
+    mClusters.reset(new ClusterIndex::Level);
+    mClustersLevel = mLevel;
+    mRows.clear();
+    mRowOf.clear();
+    endResetModel();
+
+    mChanges.clear();
+    mReset = true;
+    recluster();
+}
+
+void MapPhotoListModel::insert(PhotoId id)
+{
+    mKeys.insert(id);
+    show(ExifStorage::data(id));
 }
 
-void MapPhotoListModel::insert(const QString& path)
+void MapPhotoListModel::remove(PhotoId id)
 {
-    mKeys.append(path);
-    if (auto photo = ExifStorage::data(path))
-        mBuckets.insert(photo, mZoom);
+    if (mKeys.remove(id)) // TODO remove data?
+        hide(id);
 }
 
-void MapPhotoListModel::remove(const QString& path)
+void MapPhotoListModel::update(const QSharedPointer<Photo>& photo)
 {
-    int i = mKeys.indexOf(path);
-    if (i != -1)
+    if (!mKeys.contains(photo->id))
+        return;
+
+    auto it = mPositions.constFind(photo->id);
+    if (it != mPositions.cend() && *it == photo->position && accepts(photo))
     {
-        mKeys.removeAt(i); // TODO remove data?
-        mBuckets.remove(path);
+        // its cell was dropped, the atlas announces the new one
+        auto row = mRowOf.constFind(photo->id);
+        if (row != mRowOf.cend() && mRows.at(*row).count == 1)
+            ThumbnailAtlas::pack({ photo->id }, THUMBNAIL_SIZE);
+        return;
     }
+
+    // the photo has moved or got its thumbnail
+    hide(photo->id);
+    show(photo);
 }
 
-void MapPhotoListModel::update(const QSharedPointer<Photo>& photo)
+/// shows only the photos taken in the \a period
+void MapPhotoListModel::setPeriod(const Period& period)
 {
-    if (mKeys.contains(photo->path))
-        mBuckets.insert(photo, mZoom);
+    if (period == mPeriod)
+        return;
+
+    mPeriod = period;
+
+    Bitmap taken;
+    if (!mPeriod.isNull())
+        taken = ExifStorage::select(CatalogQuery::between(mPeriod.from, mPeriod.to));
+
+    // only the photos entering or leaving the period are touched, the other buckets keep their identities
+    QVector<Mercator::Point> gone, come;
+    for (PhotoId id: mKeys)
+    {
+        auto it = mPositions.find(id);
+        if (!mPeriod.isNull() && !taken.contains(id))
+        {
+            if (it == mPositions.end())
+                continue;
+            gone.append(Mercator::world(*it));
+            mPositions.erase(it);
+            mChanges.insert(id, QPointF());
+        }
+        else if (it == mPositions.end())
+        {
+            auto photo = ExifStorage::data(id);
+            if (!accepts(photo))
+                continue;
+            mPositions.insert(id, photo->position);
+            mChanges.insert(id, photo->position);
+            come.append(Mercator::world(photo->position));
+        }
+    }
+
+    if (gone.isEmpty() && come.isEmpty())
+        return;
+
+    // a period may hold most of the library, those are binned in parallel
+    mHeatmap.add(gone, -1);
+    mHeatmap.add(come);
+    recluster();
 }
 
 void MapPhotoListModel::setZoom(qreal zoom)
@@ -363,233 +581,378 @@ void MapPhotoListModel::setCenter(const QGeoCoordinate& center)
     }
 }
 
-void MapPhotoListModel::setCenter(const QPointF& center)
+void MapPhotoListModel::flyTo(const QPointF& position, qreal zoom)
 {
-    setCenter(QGeoCoordinate(center.x(), center.y()));
+    emit flightRequested(QGeoCoordinate(position.x(), position.y()), zoom);
 }
 
-QModelIndex MapPhotoListModel::index(const QString& path) const
+QGeoRectangle MapPhotoListModel::bounds() const
 {
-    for (int row = 0; row < mBuckets.size(); ++row)
+    if (mPositions.isEmpty())
+        return {};
+
+    const QPointF first = *mPositions.cbegin();
+    qreal top = first.x(), bottom = first.x(), left = first.y(), right = first.y();
+    for (const QPointF& position: mPositions)
     {
-        for (const auto& photo: mBuckets.at(row).photos)
-        {
-            if (photo && photo->path == path)
-            {
-                return index(row, 0);
-            }
-        }
+        top = std::max(top, position.x());
+        bottom = std::min(bottom, position.x());
+        left = std::min(left, position.y());
+        right = std::max(right, position.y());
     }
 
-    return {};
+    return QGeoRectangle(QGeoCoordinate(top, left), QGeoCoordinate(bottom, right));
 }
 
-void MapPhotoListModel::updateBuckets()
+void MapPhotoListModel::setHeatmapZoom(qreal zoom)
 {
-    BucketList buckets;
-    for (const Bucket& b: mBuckets)
-        for (const auto& p: b.photos)
-            buckets.insert(p, mZoom);
+    zoom = std::max<qreal>(0, std::min<qreal>(zoom, Heatmap::MAX_LEVEL + 1));
+    if (!qFuzzyCompare(zoom, mHeatmapZoom))
+    {
+        mHeatmapZoom = zoom;
+        emit heatmapZoomChanged();
+    }
+}
+
+void MapPhotoListModel::setViewport(const QGeoRectangle& viewport)
+{
+    if (viewport == mViewport)
+        return;
+
+    mViewport = viewport;
+    mRegion.clear();
+    mVisible = {};
 
-    if (buckets != mBuckets)
+    if (mViewport.isValid() && !mViewport.isEmpty())
     {
-        mBuckets.updateFrom(buckets);
-        emit updated();
+        const QGeoCoordinate topLeft = mViewport.topLeft(), bottomRight = mViewport.bottomRight();
+        QPointF from = Mercator::project({ topLeft.latitude(), topLeft.longitude() });
+        QPointF to = Mercator::project({ bottomRight.latitude(), bottomRight.longitude() });
+
+        // crossing the antimeridian
+        if (to.x() < from.x())
+            to.rx() += Mercator::TILE;
+
+        mVisible = QRectF(from, to);
+        const QPointF margin = (to - from) * VIEWPORT_MARGIN;
+        const QRectF rect(from - margin, to + margin);
+        mRegion.append(rect);
+        if (rect.right() > Mercator::TILE)
+            mRegion.append(rect.translated(-Mercator::TILE, 0));
+        if (rect.left() < 0)
+            mRegion.append(rect.translated(Mercator::TILE, 0));
     }
+
+    moved();
+    emit viewportChanged();
 }
 
-MapPhotoListModel::Bucket::Bucket(const QSharedPointer<Photo> &photo)
+QModelIndex MapPhotoListModel::index(PhotoId id) const
 {
-    insert(photo);
+    const int cluster = mClusters->cluster(id);
+    if (cluster == -1)
+        return {};
+
+    const int row = mRowOf.value(mClusters->clusters().at(cluster).photos.first(), -1);
+    return row == -1 ? QModelIndex() : index(row, 0);
 }
 
-bool MapPhotoListModel::Bucket::insert(const QSharedPointer<Photo> &photo)
+/// the map animates the zoom and the center frame by frame: the changes are gathered into a frame
+void MapPhotoListModel::moved()
 {
-    if (!isValid(photo))
-        return false;
+    mSettle.start();
+    if (!mFrame.isActive())
+        mFrame.start();
+}
 
-    for (const auto& item: photos)
-        if (item->path == photo->path)
-            return false;
+/// while moving the rows stay as long as they cover the viewport; zooming in keeps the coarser level,
+/// its buckets only get further apart on the screen, and zooming out switches to the next one right away
+void MapPhotoListModel::frame()
+{
+    const int level = std::min(mLevel, ClusterIndex::level(mZoom));
+    if (level == mLevel && covered())
+        return;
 
-    position *= photos.size();
-    photos.append(photo);
-    position += photo->position;
-    position /= photos.size();
+    mLevel = level;
+    if (mClustersLevel == mLevel)
+        updateRows();
+    else
+        recluster();
+}
 
-    return true;
+/// selects the precomputed level of the zoom and the buckets of the viewport, once the map has stopped
+void MapPhotoListModel::settled()
+{
+    mFrame.stop();
+
+    const int level = ClusterIndex::level(mZoom);
+    if (level == mLevel && mRegion == mRowsRegion)
+        return;
+
+    mLevel = level;
+    if (mClustersLevel == mLevel)
+        updateRows();
+    else
+        recluster();
 }
 
-bool MapPhotoListModel::Bucket::remove(const QString& path)
+/// the viewport is inside the region the rows were made for
+bool MapPhotoListModel::covered() const
 {
-    for (int i = 0; i < photos.size(); ++i)
+    if (mRowsRegion.isEmpty())
+        return true; // the world
+
+    return !mRegion.isEmpty() && std::any_of(mRowsRegion.cbegin(), mRowsRegion.cend(), [this](const QRectF& rect){ return rect.contains(mVisible); });
+}
+
+
+/// applies the difference between the rows and the visible buckets:
+/// the rows of the buckets gone are removed in contiguous ranges, the rows of the buckets still there
+/// are kept (and announced if they show something else now), the new buckets are appended;
+/// the order of the rows means nothing to the map, so nothing is moved
+void MapPhotoListModel::updateRows()
+{
+    mRowsRegion = mRegion;
+    const QVector<int> visible = visibleClusters();
+
+    QHash<PhotoId, Row> wanted;
+    wanted.reserve(visible.size());
+    for (int cluster: visible)
+    {
+        const Row r = row(cluster);
+        wanted.insert(r.seed, r);
+    }
+
+    for (int last = mRows.size() - 1; last >= 0; )
     {
-        if (const auto& photo = photos[i])
+        if (wanted.contains(mRows.at(last).seed))
         {
-            if (photo->path == path)
-            {
-                QPointF pos = position * photos.size();
-                pos -= photo->position;
-                photos.removeAt(i);
-                pos /= photos.size();
-                return true;
-            }
+            --last;
+            continue;
         }
+
+        int first = last;
+        while (first > 0 && !wanted.contains(mRows.at(first - 1).seed))
+            --first;
+
+        beginRemoveRows({}, first, last);
+        mRows.remove(first, last - first + 1);
+        endRemoveRows();
+
+        last = first - 1;
     }
 
-    return false;
-}
+    mRowOf.clear();
+    for (int i = 0, first = -1; i <= mRows.size(); ++i)
+    {
+        bool changed = false;
+        if (i < mRows.size())
+        {
+            Row& r = mRows[i];
+            mRowOf.insert(r.seed, i);
 
-bool MapPhotoListModel::Bucket::isValid(const QSharedPointer<Photo> &photo)
-{
-    return photo && !photo->path.isEmpty() && !photo->pixBase64.isEmpty() && !photo->position.isNull();
+            const Row& now = wanted.value(r.seed);
+            changed = now.count != r.count || now.point != r.point;
+            r = now;
+        }
+
+        if (changed && first == -1)
+            first = i;
+
+        if (!changed && first != -1)
+        {
+            emit dataChanged(index(first), index(i - 1), { Role::Latitude, Role::Longitude, Role::Files });
+            first = -1;
+        }
+    }
+
+    QVector<Row> added;
+    for (int cluster: visible)
+    {
+        const Row r = row(cluster);
+        if (!mRowOf.contains(r.seed))
+            added.append(r);
+    }
+
+    if (!added.isEmpty())
+    {
+        beginInsertRows({}, mRows.size(), mRows.size() + added.size() - 1);
+        for (const Row& r: added)
+        {
+            mRowOf.insert(r.seed, mRows.size());
+            mRows.append(r);
+        }
+        endInsertRows();
+    }
+
+    packThumbnails();
 }
 
-QStringList MapPhotoListModel::Bucket::files() const
+/// packs the thumbnails of the single photo rows, MarkerLayer only looks them up
+void MapPhotoListModel::packThumbnails()
 {
-    QStringList list;
-    list.reserve(photos.size());
-    for (const auto& photo: photos)
-        list.append(photo->path);
-    return list;
+    QVector<PhotoId> ids;
+    for (const Row& r: mRows)
+        if (r.count == 1)
+            ids.append(r.seed);
+
+    ThumbnailAtlas::pack(ids, THUMBNAIL_SIZE);
 }
 
-bool MapPhotoListModel::Bucket::operator ==(const Bucket& other)
+QVector<int> MapPhotoListModel::visibleClusters() const
 {
-    return photos == other.photos;
+    QVector<int> visible;
+
+    if (mRegion.isEmpty())
+    {
+        const QVector<ClusterIndex::Cluster>& clusters = mClusters->clusters();
+        for (int i = 0; i < clusters.size(); ++i)
+            if (!clusters.at(i).isEmpty())
+                visible.append(i);
+        return visible;
+    }
+
+    for (const QRectF& rect: mRegion)
+        mClusters->forIn(rect, [&visible](int cluster){ visible.append(cluster); });
+
+    // the parts of the region overlap when the whole world is seen
+    std::sort(visible.begin(), visible.end());
+    visible.erase(std::unique(visible.begin(), visible.end()), visible.end());
+    return visible;
 }
 
-bool MapPhotoListModel::Bucket::operator !=(const Bucket& other)
+const ClusterIndex::Cluster* MapPhotoListModel::bucket(int row) const
 {
-    return photos != other.photos;
+    const int cluster = mClusters->cluster(mRows.at(row).seed);
+    return cluster == -1 ? nullptr : &mClusters->clusters().at(cluster);
 }
 
-Bubbles::Bubbles(int size, const QColor& color) : mSize(size), mColor(color)
+/// the later rows are drawn over the earlier ones
+int MapPhotoListModel::rowAt(const QPointF& point, qreal zoom) const
 {
+    const qreal half = THUMBNAIL_SIZE / 2.0 / Mercator::scale(zoom);
+    const QRectF rect(point - QPointF(half, half), point + QPointF(half, half));
 
+    int found = -1;
+    for (const QRectF& r: { rect, rect.translated(-Mercator::TILE, 0), rect.translated(Mercator::TILE, 0) })
+        mClusters->forIn(r, [this, &found](int cluster){
+            found = std::max(found, mRowOf.value(mClusters->clusters().at(cluster).photos.first(), -1)); });
+    return found;
 }
 
-QString Bubbles::bubble(int value)
+MapPhotoListModel::Row MapPhotoListModel::row(int cluster) const
 {
-    auto i = mData.constFind(value);
-    if (i != mData.constEnd())
-        return *i;
-
-    QString generated = Pics::toBase64(generate(value, mSize, mColor), "PNG");
-    mData.insert(value, generated);
-    return generated;
+    const ClusterIndex::Cluster& bucket = mClusters->clusters().at(cluster);
+    return { bucket.photos.first(), bucket.photos.size(), bucket.point };
 }
 
-QPixmap Bubbles::generate(int value, int size, const QColor& color)
+bool MapPhotoListModel::accepts(const QSharedPointer<Photo>& photo) const
 {
-    QPixmap pix(size, size);
-    pix.fill(Qt::transparent);
-    QRect rect = pix.rect().adjusted(1, 1, -1, -1);
-    QPainter painter(&pix);
-    painter.setPen({ color, 2 });
-    painter.setBrush(Qt::white);
-    painter.drawEllipse(rect);
-    QFont font("Tahoma");
-    font.setPixelSize(value >= 100 ? size * 4 / 10 : size / 2);
-    painter.setFont(font);
-    rect.adjust(-1,-1,0,0);
-    painter.drawText(rect, Qt::AlignCenter, QString::number(value));
-    return pix;
+    return photo && photo->id != INVALID_PHOTO_ID && ExifStorage::hasThumbnail(photo->id) && !photo->position.isNull()
+            && mPeriod.accepts(photo->time);
 }
 
-bool MapPhotoListModel::BucketList::insert(const QSharedPointer<Photo>& photo, double zoom)
+void MapPhotoListModel::show(const QSharedPointer<Photo>& photo)
 {
-    if (!photo)
-        return false;
-
-    QGeoCoordinate position(photo->position.x(), photo->position.y());
-    for (int row = 0; row < size(); ++row)
-    {
-        Bucket& bucket = (*this)[row];
-        double dist = QGeoCoordinate(bucket.position.x(), bucket.position.y()).distanceTo(position);
-
-        // https://wiki.openstreetmap.org/wiki/Zoom_levels
-        static constexpr double C = 40075016.686 / 2.0;
-        double pixel_size = C * std::abs(std::cos(bucket.position.x())) / std::pow(2, zoom + 8);
-        double thumb_size = pixel_size * 32; // TODO magic constant
-        if (dist < thumb_size)
-        {
-            if (!bucket.insert(photo))
-                return false;
-
-            if (mModel)
-            {
-                QModelIndex index = mModel->index(row, 0);
-                emit mModel->dataChanged(index, index, { Role::Latitude, Role::Longitude, Role::Pixmap });
-            }
+    if (!accepts(photo))
+        return;
 
-            return true;
-        }
-    }
+    hide(photo->id);
+    mPositions.insert(photo->id, photo->position);
+    mChanges.insert(photo->id, photo->position);
+    mHeatmap.add(Mercator::world(photo->position));
+    recluster();
+}
 
-    if (mModel) mModel->beginInsertRows({}, size(), size());
-    append(photo);
-    if (mModel) mModel->endInsertRows();
+void MapPhotoListModel::hide(PhotoId id)
+{
+    auto it = mPositions.find(id);
+    if (it == mPositions.end())
+        return;
 
-    return true;
+    mHeatmap.remove(Mercator::world(*it));
+    mPositions.erase(it);
+    mChanges.insert(id, QPointF());
+    recluster();
 }
 
-bool MapPhotoListModel::BucketList::remove(const QString& path)
+/// the pool thread keeps a ClusterIndex of the shown photos: a request hands it the photos shown or hidden
+/// since the previous one, and it publishes a shared copy of the wanted level only;
+/// cancels the clustering running or finished but not applied yet, and queues a new one;
+/// all the changes made until the control returns to the event loop go to a single request,
+/// a request without changes only publishes the wanted level
+void MapPhotoListModel::recluster()
 {
-    for (int row = 0; row < size(); ++row)
-    {
-        Bucket& bucket = (*this)[row];
-        if (bucket.remove(path))
-        {
-            if (bucket.photos.isEmpty())
-            {
-                if (mModel) mModel->beginRemoveRows({}, row, row);
-                removeAt(row);
-                if (mModel) mModel->endRemoveRows();
-            }
-            else
-            {
-                if (mModel)
-                {
-                    QModelIndex idx = mModel->index(row);
-                    emit mModel->dataChanged(idx, idx, { Role::Latitude, Role::Longitude, Role::Pixmap });
-                }
-            }
+    mGeneration.ref();
 
-            return true;
-        }
-    }
+    if (mScheduled)
+        return;
 
-    return false;
+    mScheduled = true;
+    QMetaObject::invokeMethod(this, &MapPhotoListModel::startClustering, Qt::QueuedConnection);
 }
 
-void MapPhotoListModel::BucketList::updateFrom(const BucketList &other)
+void MapPhotoListModel::startClustering()
 {
-    if (mModel) mModel->beginResetModel();
+    mScheduled = false;
 
-    QList<Bucket>::clear();
-    QList<Bucket>::append(other);
+    QHash<PhotoId, QPointF> changes;
+    changes.swap(mChanges);
+    const bool reset = std::exchange(mReset, false);
+    if (reset || !changes.isEmpty())
+        emit heatmapChanged();
 
-    if (mModel) mModel->endResetModel();
-}
+    const int level = mLevel;
+    const int generation = mGeneration.loadAcquire();
 
-void MapPhotoListModel::BucketList::clear()
-{
-    if (mModel) mModel->beginResetModel();
+    // the requests run in order and an older one only hands its changes on, so none is lost;
+    // what a cancelled one has applied stays applied, the rest waits in mPending
+    mPool.start([this, changes, reset, level, generation](){
+        if (reset)
+        {
+            mWorking.clear();
+            mPending.clear();
+        }
 
-    QList<Bucket>::clear();
+        for (auto it = changes.cbegin(); it != changes.cend(); ++it)
+            mPending.insert(it.key(), it.value());
 
-    if (mModel) mModel->endResetModel();
+        if (!mWorking.apply(&mPending, [this, generation](){ return mGeneration.loadAcquire() != generation; }))
+            return;
+
+        // a shallow copy, the next change here detaches this level alone
+        QSharedPointer<const ClusterIndex::Level> clusters(new ClusterIndex::Level(mWorking.at(level)));
+        QMetaObject::invokeMethod(this, [this, generation, level, clusters](){ clustered(generation, level, clusters); }, Qt::QueuedConnection);
+    });
 }
 
-bool MapPhotoListModel::BucketList::operator ==(const BucketList& other) const
+/// swaps the finished level in and diffs the rows against it, unless a newer request has been made meanwhile;
+/// a bucket is identified by its first photo, so its row survives the photos coming and going
+void MapPhotoListModel::clustered(int generation, int level, const QSharedPointer<const ClusterIndex::Level>& clusters)
 {
-    return QList<Bucket>::operator ==(other);
+    if (generation != mGeneration.loadAcquire())
+        return;
+
+    mClusters = clusters;
+    mClustersLevel = level;
+    updateRows();
 }
 
-bool MapPhotoListModel::BucketList::operator !=(const BucketList& other) const
+QImage Bubbles::generate(int value, int size, const QColor& color)
 {
-    return !(*this == other);
+    QImage pix(size, size, QImage::Format_ARGB32_Premultiplied);
+    pix.fill(Qt::transparent);
+    QRect rect = pix.rect().adjusted(1, 1, -1, -1);
+    QPainter painter(&pix);
+    painter.setPen({ color, 2 });
+    painter.setBrush(Qt::white);
+    painter.drawEllipse(rect);
+    QFont font("Tahoma");
+    font.setPixelSize(value >= 100 ? size * 4 / 10 : size / 2);
+    painter.setFont(font);
+    rect.adjust(-1,-1,0,0);
+    painter.drawText(rect, Qt::AlignCenter, QString::number(value));
+    return pix;
 }
 
 void MapSelectionModel::setCurrentRow(int row)
@@ -1,32 +1,35 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <QAtomicInt>
 #include <QFileSystemModel>
 #include <QGeoCoordinate>
+#include <QGeoRectangle>
+#include <QImage>
 #include <QItemSelectionModel>
 #include <QPersistentModelIndex>
+#include <QSet>
+#include <QSharedPointer>
 #include <QSortFilterProxyModel>
-#include <QStringListModel>
+#include <QThreadPool>
+#include <QTimer>
 #include <QVector>
 
 #include "exif/file.h"
+#include "clusters.h"
+#include "heatmap.h"
+#include "photoid.h"
+#include "timeindex.h"
 
 struct Photo;
 
 
 /// Generates a circle with a number in the middle
 /// (42)
-/// format: base64-encoded PNG with alpha channel
 class Bubbles
 {
-    QHash<int, QString> mData;
-    const int mSize;
-    const QColor mColor;
-
 public:
-    Bubbles(int size, const QColor& color);
-    QString bubble(int value);
-    static QPixmap generate(int value, int size, const QColor& color);
+    static QImage generate(int value, int size, const QColor& color);
 };
 
 
@@ -46,14 +49,19 @@ private:
 };
 
 
-/// base class for a model containing files as their absolute paths
+/// base class for a model containing files;
+/// files are identified by PhotoId, the absolute path is available for display purposes;
+/// directories have no id, so a list of ids never needs a file system check
 class IFileListModel
 {
 public:
-    enum { FilePathRole = QFileSystemModel::FilePathRole };
-    virtual QModelIndex index(const QString& path) const = 0;
+    enum { FilePathRole = QFileSystemModel::FilePathRole, PhotoIdRole = Qt::UserRole + 100 };
+    virtual QModelIndex index(PhotoId id) const = 0;
     static QString path(const QModelIndex& index);
-    static QStringList path(const QModelIndexList& indexes);
+    static PhotoId id(const QModelIndex& index);
+    static PhotoIdList id(const QModelIndexList& indexes);
+    /// a file having an id, not a directory
+    static bool isPhoto(const QModelIndex& index);
 };
 
 
@@ -75,7 +83,7 @@ public:
     QVariant data(const QModelIndex& index, int role) const override;
     bool setData(const QModelIndex& index, const QVariant& value, int role) override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
-    QModelIndex index(const QString& path) const override;
+    QModelIndex index(PhotoId id) const override;
     using Super::index;
 
     static const QStringList entryList(const QString& dir, const QStringList& nameFilters);
@@ -86,43 +94,67 @@ private:
 };
 
 
-class PhotoListModel : public QStringListModel, public IFileListModel
+/// flat list of photos sorted by path; only the photos taken in the period are shown
+class PhotoListModel : public QAbstractListModel, public IFileListModel
 {
-    using Super = QStringListModel;
+    using Super = QAbstractListModel;
     Q_OBJECT
 
 public:
     using Super::Super;
 
+    int rowCount(const QModelIndex& parent = {}) const override;
     QVariant data(const QModelIndex& index, int role) const override;
-    QModelIndex index(const QString& data) const override;
+    QModelIndex index(PhotoId id) const override;
     using Super::index;
 
-    void insert(const QString& line);
-    void remove(const QString& line);
+    /// all the photos including hidden ones
+    const PhotoIdList& ids() const { return mData; }
+
+    void insert(PhotoId id);
+    void remove(PhotoId id);
+    void update(const QSharedPointer<Photo>& photo);
+
+    void setPeriod(const Period& period);
+
+private:
+    static PhotoIdList::const_iterator lowerBound(const PhotoIdList& list, PhotoId id);
+    bool accepts(PhotoId id) const;
+
+    PhotoIdList mData;
+    PhotoIdList mVisible; // rows
+    Period mPeriod;
 };
 
 
 /// main QML model
-/// combines nearby photos into one bucket, so it breaking the rule '1 QModelIndex <=> 1 file'
+/// combines nearby photos into one bucket, so it breaking the rule '1 QModelIndex <=> 1 file';
+/// the rows are the buckets of the shown level inside the viewport, updated by a diff, never reset
 class MapPhotoListModel : public QAbstractListModel, public IFileListModel
 {
     Q_OBJECT
 
-    // TODO extract zoom & center to avoid qml -> cpp -> qml signal loop
     Q_PROPERTY(qreal zoom MEMBER mZoom WRITE setZoom NOTIFY zoomChanged)
     Q_PROPERTY(QGeoCoordinate center MEMBER mCenter WRITE setCenter NOTIFY centerChanged)
+    Q_PROPERTY(QGeoRectangle viewport MEMBER mViewport WRITE setViewport NOTIFY viewportChanged)
     Q_PROPERTY(int thumbnailSize MEMBER THUMBNAIL_SIZE CONSTANT)
+    Q_PROPERTY(qreal heatmapZoom MEMBER mHeatmapZoom WRITE setHeatmapZoom NOTIFY heatmapZoomChanged)
 
 signals:
     void zoomChanged();
     void centerChanged();
-    void updated();
+    void viewportChanged();
+    void heatmapZoomChanged();
+    /// the map is asked to fly to the \a center at the \a zoom
+    void flightRequested(const QGeoCoordinate& center, qreal zoom);
+    /// the shown photos have changed, emitted once for many changes
+    void heatmapChanged();
 
 public:
-    struct Role { enum { Pixmap = Qt::DecorationRole, Path = FilePathRole, Files, Latitude, Longitude }; };
+    struct Role { enum { Path = FilePathRole, Files, Latitude, Longitude }; };
 
     MapPhotoListModel();
+    ~MapPhotoListModel() override;
 
     Q_INVOKABLE int rowCount(const QModelIndex& index = {}) const override;
     Q_INVOKABLE QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
@@ -130,67 +162,95 @@ public:
 
     void clear();
 
-    void insert(const QString& path);
-    void remove(const QString& path);
+    void insert(PhotoId id);
+    void remove(PhotoId id);
     void update(const QSharedPointer<Photo>& data);
 
+    void setPeriod(const Period& period);
+
     void setZoom(qreal zoom);
     void setCenter(const QGeoCoordinate& center);
-    void setCenter(const QPointF& center);
+    /// moves the map to the \a position (latitude, longitude) at the \a zoom;
+    /// the map writes the zoom and the center back, the model never does
+    void flyTo(const QPointF& position, qreal zoom);
+    void setViewport(const QGeoRectangle& viewport);
+    /// below the \a zoom the map shows the heatmap instead of the markers
+    void setHeatmapZoom(qreal zoom);
+    qreal heatmapZoom() const { return mHeatmapZoom; }
+
+    /// the density of the shown photos
+    const Heatmap& heatmap() const { return mHeatmap; }
+    /// the area of the shown photos, invalid if there are none
+    QGeoRectangle bounds() const;
 
     using QAbstractListModel::index;
-    QModelIndex index(const QString& path) const override;
+    QModelIndex index(PhotoId id) const override;
+
+    /// the bucket of the \a row at the current level; none, if its first photo has just gone
+    const ClusterIndex::Cluster* bucket(int row) const;
+    /// \return the topmost row whose marker covers the \a point of zoom 0 pixels at the \a zoom, -1 if none
+    int rowAt(const QPointF& point, qreal zoom) const;
 
     static constexpr int THUMBNAIL_SIZE = 32;
+    static constexpr qreal VIEWPORT_MARGIN = 0.25;  // of the viewport size, on every side
+    static constexpr qreal HEATMAP_ZOOM = 5;
+    static constexpr int FRAME_MS = 16;
+    static constexpr int SETTLE_MS = 250;          // without a zoom or viewport change
 
 private:
-    void updateBuckets();
-
-    struct Bucket
-    {
-        QVector<QSharedPointer<Photo>> photos;
-        QPointF position;
-
-        Bucket() = default;
-        Bucket(const QSharedPointer<Photo>& photo);
-
-        bool insert(const QSharedPointer<Photo>& photo);
-        bool remove(const QString& path);
-        static bool isValid(const QSharedPointer<Photo>& photo);
-
-        QStringList files() const;
-
-        bool operator ==(const Bucket& other);
-        bool operator !=(const Bucket& other);
-    };
-
-    class BucketList : private QList<Bucket>
+    /// what a row shows, to tell whether it has changed
+    struct Row
     {
-        MapPhotoListModel* mModel = nullptr;
-    public:
-        BucketList(MapPhotoListModel* model = nullptr) : mModel(model) {}
-
-        bool insert(const QSharedPointer<Photo>& photo, double zoom);
-        bool remove(const QString& path);
-        void updateFrom(const BucketList& other);
-
-        void clear();
-
-        bool operator ==(const BucketList& other) const;
-        bool operator !=(const BucketList& other) const;
-
-        using QList<Bucket>::size;
-        using QList<Bucket>::at;
-        using QList<Bucket>::begin;
-        using QList<Bucket>::end;
+        PhotoId seed;           // the first photo of the bucket
+        int count;
+        Mercator::Point point;
     };
 
-    QStringList mKeys;
-    BucketList mBuckets;
-    mutable Bubbles mBubbles;
+    void moved();
+    void frame();
+    void settled();
+    bool covered() const;
+    void updateRows();
+    void packThumbnails();
+    QVector<int> visibleClusters() const;
+    Row row(int cluster) const;
+
+    bool accepts(const QSharedPointer<Photo>& photo) const;
+    void show(const QSharedPointer<Photo>& photo);
+    void hide(PhotoId id);
+
+    void recluster();
+    void startClustering();
+    void clustered(int generation, int level, const QSharedPointer<const ClusterIndex::Level>& clusters);
+
+    QSet<PhotoId> mKeys;
+    QHash<PhotoId, QPointF> mPositions;             // of the shown photos, what is clustered
+    Heatmap mHeatmap;                               // of mPositions, kept up to date in place
+    QHash<PhotoId, QPointF> mChanges;               // of mPositions since the last request, null if hidden
+    bool mReset = false;                            // the worker starts over
+    QSharedPointer<const ClusterIndex::Level> mClusters;    // the latest result, never modified
+    int mClustersLevel = 0;
+    int mLevel = 0;                                 // wanted, mClusters may still be of another one
+
+    QThreadPool mPool;                  // a single thread
+    ClusterIndex mWorking;              // used by the pool thread only
+    QHash<PhotoId, QPointF> mPending;   // the changes not applied to mWorking yet, used by the pool thread only
+    QAtomicInt mGeneration;             // of the latest request, the older ones are cancelled
+    bool mScheduled = false;            // startClustering() is queued
+    QVector<Row> mRows;
+    QHash<PhotoId, int> mRowOf; // seed -> row
+    Period mPeriod;
+
+    QGeoRectangle mViewport;
+    QVector<QRectF> mRegion;    // projected viewport with the margin, split at the antimeridian; the world if empty
+    QRectF mVisible;            // projected viewport, without the margin
+    QVector<QRectF> mRowsRegion;    // the region of the rows, mRegion when they were last updated
+    QTimer mFrame;
+    QTimer mSettle;
 
     qreal mZoom = 5;
     QGeoCoordinate mCenter;
+    qreal mHeatmapZoom = HEATMAP_ZOOM;
 };
 
 
@@ -0,0 +1,19 @@
+#ifndef PHOTOID_H
+#define PHOTOID_H
+
+#include <QVector>
+
+#include "stringpool.h"
+
+/// dense index of a photo path interned by ExifStorage;
+/// paths are materialized only when they are needed for the UI or the file system
+using PhotoId = StringPool::Id;
+using PhotoIdList = QVector<PhotoId>;
+
+static constexpr PhotoId INVALID_PHOTO_ID = StringPool::InvalidId;
+
+/// index in ExifStorage's keyword dictionary
+using KeywordId = StringPool::Id;
+using KeywordIdList = QVector<KeywordId>;
+
+#endif // PHOTOID_H
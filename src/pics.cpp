@@ -1,83 +1,186 @@
-#include <QBuffer>
 #include <QIcon>
+#include <QImage>
 #include <QImageReader>
 #include <QPixmap>
+#include <QTransform>
+#include <QVector>
+
+#include <algorithm>
 
 #include "exif/file.h" // TODO extract Orientation
 #include "pics.h"
 
+namespace
+{
+
+/// opaque images are 32-bit RGB, the ones with alpha are premultiplied for fast painting
+QImage normalized(const QImage& image)
+{
+    if (image.format() == QImage::Format_RGB32 || image.format() == QImage::Format_ARGB32_Premultiplied)
+        return image;
+    return image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+}
+
+/// JPEG is decoded at 1/1, 1/2, 1/4 or 1/8 of its size almost for free (only the low DCT frequencies are used);
+/// \return the smallest of these sizes not less than \a needed
+QSize dctScaled(const QSize& size, const QSize& needed)
+{
+    int d = 8;
+    while (d > 1 && ((size.width() + d - 1) / d < needed.width() || (size.height() + d - 1) / d < needed.height()))
+        d /= 2;
+    return QSize((size.width() + d - 1) / d, (size.height() + d - 1) / d);
+}
+
+/// \return where the pixel (\a u, \a v) of a \a w x \a h picture goes when the EXIF \a orientation is applied
+inline QPoint oriented(int u, int v, int w, int h, Exif::Orientation orientation)
+{
+    switch (orientation)
+    {
+    case Exif::Orientation::MirrorHorizontal:               return QPoint(w - 1 - u, v);
+    case Exif::Orientation::Rotate180:                      return QPoint(w - 1 - u, h - 1 - v);
+    case Exif::Orientation::MirrorVertical:                 return QPoint(u, h - 1 - v);
+    case Exif::Orientation::MirrorHorizontalAndRotate270CW: return QPoint(v, u);
+    case Exif::Orientation::Rotate90CW:                     return QPoint(h - 1 - v, u);
+    case Exif::Orientation::MirrorHorizontalAndRotate90CW:  return QPoint(h - 1 - v, w - 1 - u);
+    case Exif::Orientation::Rotate270CW:                    return QPoint(v, w - 1 - u);
+    default:                                                return QPoint(u, v);
+    }
+}
+
+} // namespace
+
 namespace Pics
 {
 
-QPixmap thumbnail(const QPixmap& pixmap, int size)
+QImage thumbnail(const QImage& image, int size)
 {
-    QPixmap pic = (pixmap.width() > pixmap.height()) ? pixmap.scaledToHeight(size) : pixmap.scaledToWidth(size);
+    QImage pic = (image.width() > image.height()) ? image.scaledToHeight(size) : image.scaledToWidth(size);
     return pic.copy((pic.width() - size) / 2, (pic.height() - size) / 2, size, size);
 }
 
-QString toBase64(const QPixmap& pixmap, const char* format)
+QImage resample(const QImage& source, const QRect& crop, int width, int height, Exif::Orientation orientation)
 {
-    QByteArray raw;
-    QBuffer buff(&raw);
-    buff.open(QIODevice::WriteOnly);
-    pixmap.save(&buff, format);
-
-    QString base64("data:image/jpg;base64,");
-    base64.append(QString::fromLatin1(raw.toBase64().data()));
-    return base64;
+    const QRect rect = crop & source.rect();
+    if (rect.isEmpty() || width <= 0 || height <= 0)
+        return {};
+
+    const QImage image = normalized(source);
+
+    // the size before orientation
+    const int w = orientation.isRotated() ? height : width;
+    const int h = orientation.isRotated() ? width : height;
+
+    QImage result(width, height, image.format());
+
+    QVector<uchar*> lines(height);
+    for (int y = 0; y < height; ++y)
+        lines[y] = result.scanLine(y);
+
+    // source columns of every destination column; a box is at least one pixel wide, so it works for upscaling too
+    QVector<int> columns(w + 1);
+    for (int u = 0; u <= w; ++u)
+        columns[u] = rect.x() + static_cast<int>(1LL * u * rect.width() / w);
+
+    // sums of the box rows, per channel; rows of 32-bit pixels are summed bytewise, which vectorizes well
+    const int bytes = rect.width() * 4;
+    QVector<quint32> sums(bytes);
+
+    for (int v = 0; v < h; ++v)
+    {
+        const int y0 = rect.y() + static_cast<int>(1LL * v * rect.height() / h);
+        const int y1 = std::max(y0 + 1, rect.y() + static_cast<int>(1LL * (v + 1) * rect.height() / h));
+
+        std::fill(sums.begin(), sums.end(), 0);
+        quint32* sum = sums.data();
+        for (int y = y0; y < y1; ++y)
+        {
+            const uchar* line = image.constScanLine(y) + rect.x() * 4;
+            for (int i = 0; i < bytes; ++i)
+                sum[i] += line[i];
+        }
+
+        for (int u = 0; u < w; ++u)
+        {
+            const int x0 = columns.at(u);
+            const int x1 = std::max(x0 + 1, columns.at(u + 1));
+            const quint32 count = static_cast<quint32>((x1 - x0) * (y1 - y0));
+
+            quint32 pixel[4] = { 0, 0, 0, 0 };
+            for (const quint32* s = sum + (x0 - rect.x()) * 4, *end = sum + (x1 - rect.x()) * 4; s < end; s += 4)
+            {
+                pixel[0] += s[0];
+                pixel[1] += s[1];
+                pixel[2] += s[2];
+                pixel[3] += s[3];
+            }
+
+            const QPoint p = oriented(u, v, w, h, orientation);
+            uchar* out = lines.at(p.y()) + p.x() * 4;
+            for (int c = 0; c < 4; ++c)
+                out[c] = static_cast<uchar>((pixel[c] + count / 2) / count);
+        }
+    }
+
+    return result;
 }
 
-QPixmap fromImageReader(QImageReader* reader, int width, int height, Exif::Orientation orientation)
+QTransform transform(Exif::Orientation orientation, const QSize& size)
 {
-    if (orientation.isRotated())
-        std::swap(width, height);
-
-    QPixmap pic = fromImageReader(reader, width, height);
-
-    QTransform transformation;
-
-    if (orientation == Exif::Orientation::MirrorHorizontal) {
-        transformation.scale(1, -1);
-    } else if (orientation == Exif::Orientation::Rotate180) {
-        transformation.rotate(180);
-    } else if (orientation == Exif::Orientation::MirrorVertical) {
-        transformation.scale(-1, 1);
-    } else if (orientation == Exif::Orientation::MirrorHorizontalAndRotate270CW) {
-        transformation.scale(1, -1).rotate(270);
-    } else if (orientation == Exif::Orientation::Rotate90CW) {
-        transformation.rotate(90);
-    } else if (orientation == Exif::Orientation::MirrorHorizontalAndRotate90CW) {
-        transformation.scale(1, -1).rotate(90);
-    } else if (orientation == Exif::Orientation::Rotate270CW) {
-        transformation.rotate(270);
-    } else {
-        return pic;
+    const qreal w = size.width(), h = size.height();
+
+    switch (orientation)
+    {
+    case Exif::Orientation::MirrorHorizontal:               return QTransform(-1, 0, 0, 1, w, 0);
+    case Exif::Orientation::Rotate180:                      return QTransform(-1, 0, 0, -1, w, h);
+    case Exif::Orientation::MirrorVertical:                 return QTransform(1, 0, 0, -1, 0, h);
+    case Exif::Orientation::MirrorHorizontalAndRotate270CW: return QTransform(0, 1, 1, 0, 0, 0);
+    case Exif::Orientation::Rotate90CW:                     return QTransform(0, 1, -1, 0, h, 0);
+    case Exif::Orientation::MirrorHorizontalAndRotate90CW:  return QTransform(0, -1, -1, 0, h, w);
+    case Exif::Orientation::Rotate270CW:                    return QTransform(0, -1, 1, 0, 0, w);
+    default:                                                return QTransform();
     }
+}
 
-    return pic.transformed(transformation);
+QImage fromImageReader(QImageReader* reader, int width, int height, Exif::Orientation orientation)
+{
+    const bool rotated = orientation.isRotated();
+    const QSize size = reader->size();
+
+    // the wanted size before orientation, the whole picture if no size given
+    QSize target = (width && height) ? (rotated ? QSize(height, width) : QSize(width, height)) : size;
+
+    if (size.isValid() && target.isValid() && reader->format() == "jpeg")
+    {
+        const double factor = std::max(1.0 * target.width() / size.width(), 1.0 * target.height() / size.height());
+        reader->setScaledSize(dctScaled(size, (size * std::min(factor, 1.0)).expandedTo(QSize(1, 1))));
+    }
+
+    QImage image = reader->read();
+    if (image.isNull())
+        return image;
+
+    if (!target.isValid())
+        target = image.size();
+
+    // the centered part filling the target aspect ratio
+    QRect crop(QPoint(), target.scaled(image.size(), Qt::KeepAspectRatio));
+    crop.moveCenter(image.rect().center());
+
+    const QSize result = rotated ? target.transposed() : target;
+    if (crop == image.rect() && target == image.size() && (orientation == Exif::Orientation::Unknown || orientation == Exif::Orientation::Normal))
+        return normalized(image);
+
+    return resample(image, crop, result.width(), result.height(), orientation);
 }
 
-QPixmap fromImageReader(QImageReader *reader, Exif::Orientation orientation)
+QImage fromImageReader(QImageReader *reader, Exif::Orientation orientation)
 {
     return fromImageReader(reader, 0, 0, orientation);
 }
 
-QPixmap fromImageReader(QImageReader *reader, int width, int height)
+QImage fromImageReader(QImageReader *reader, int width, int height)
 {
-    if (width == 0 || height == 0)
-        return QPixmap::fromImageReader(reader);
-
-    QSize size = reader->size();
-
-    double dw = 1.0 * width / size.width();
-    double dh = 1.0 * height / size.height();
-    QSize cropped_size = size * std::max(dw, dh);
-    reader->setScaledSize(cropped_size);
-    reader->setScaledClipRect(QRect((cropped_size.width() - width) / 2,
-                                    (cropped_size.height() - height) / 2,
-                                    width,
-                                    height));
-    return QPixmap::fromImageReader(reader);
+    return fromImageReader(reader, width, height, Exif::Orientation::Normal);
 }
 
 QIcon createIcon(const QPixmap& pix1, const QPixmap& pix2)
@@ -89,4 +192,3 @@ QIcon createIcon(const QPixmap& pix1, const QPixmap& pix2)
 }
 
 } // namespace Pics
-
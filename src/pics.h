@@ -1,8 +1,12 @@
 #ifndef PICS_H
 #define PICS_H
 
+class QImage;
 class QImageReader;
 class QPixmap;
+class QRect;
+class QSize;
+class QTransform;
 class QString;
 class QIcon;
 
@@ -11,13 +15,22 @@ namespace Exif { class Orientation; }
 namespace Pics
 {
 
-QPixmap thumbnail(const QPixmap& pixmap, int size);
+// decoding works with QImage only, so it's safe in any thread;
+// convert the result to QPixmap in the GUI thread when it's going to be shown
 
-QString toBase64(const QPixmap& pixmap, const char* format);
+QImage thumbnail(const QImage& image, int size);
 
-QPixmap fromImageReader(QImageReader* reader, int width, int height, Exif::Orientation orientation);
-QPixmap fromImageReader(QImageReader* reader, Exif::Orientation orientation);
-QPixmap fromImageReader(QImageReader* reader, int width, int height);
+/// crops, orients and area-averages the \a image to \a width x \a height (the size after orientation)
+/// in one pass over the \a crop pixels
+QImage resample(const QImage& image, const QRect& crop, int width, int height, Exif::Orientation orientation);
+
+/// maps the stored \a size picture to its displayed orientation, the same way resample() does
+QTransform transform(Exif::Orientation orientation, const QSize& size);
+
+/// decodes JPEG at the nearest DCT scale and finishes with resample()
+QImage fromImageReader(QImageReader* reader, int width, int height, Exif::Orientation orientation);
+QImage fromImageReader(QImageReader* reader, Exif::Orientation orientation);
+QImage fromImageReader(QImageReader* reader, int width, int height);
 
 QIcon createIcon(const QPixmap& pix1, const QPixmap& pix2);
 
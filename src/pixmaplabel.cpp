@@ -1,11 +1,52 @@
 #include "pixmaplabel.h"
 
+#include <QApplication>
 #include <QMouseEvent>
 #include <QDesktopServices>
+#include <QPointer>
+#include <QThreadPool>
 
-QPixmap PixmapLabel::scaledPixmap() const
+#include "exif/file.h"
+#include "pics.h"
+
+constexpr int PixmapLabel::MIN_LEVEL_SIZE;
+constexpr int PixmapLabel::SETTLE_MS;
+
+/// \return the smallest level still covering \a size
+const QImage& PixmapLabel::level(const QSize& size) const
+{
+    for (int i = mLevels.size() - 1; i > 0; --i)
+        if (mLevels.at(i).width() >= size.width() && mLevels.at(i).height() >= size.height())
+            return mLevels.at(i);
+    return mImage;
+}
+
+/// the image fitted into the label, in device pixels
+QSize PixmapLabel::scaledSize() const
+{
+    return mImage.size().scaled(size() * devicePixelRatioF(), Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+}
+
+void PixmapLabel::rescale(Qt::TransformationMode mode)
+{
+    if (mImage.isNull())
+        return;
+
+    const QSize size = scaledSize();
+    const QImage& source = level(size);
+
+    QPixmap pixmap = QPixmap::fromImage(source.size() == size ? source : source.scaled(size, Qt::IgnoreAspectRatio, mode));
+    pixmap.setDevicePixelRatio(devicePixelRatioF());
+    QLabel::setPixmap(pixmap);
+}
+
+void PixmapLabel::setLevels(int generation, const QVector<QImage>& levels)
 {
-    return mPixmap.isNull() ? mPixmap : mPixmap.scaled(size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    if (generation != mGeneration)
+        return;
+
+    mLevels = levels;
+    rescale(Qt::SmoothTransformation);
 }
 
 PixmapLabel::PixmapLabel(QWidget* parent) :
@@ -14,12 +55,43 @@ PixmapLabel::PixmapLabel(QWidget* parent) :
     setMinimumSize(1,1);
     setScaledContents(false);
     setAlignment(Qt::AlignCenter);
+
+    mSettle.setSingleShot(true);
+    mSettle.setInterval(SETTLE_MS);
+    connect(&mSettle, &QTimer::timeout, this, [this](){ rescale(Qt::SmoothTransformation); });
 }
 
-void PixmapLabel::setPixmap(const QPixmap &pixmap)
+void PixmapLabel::setImage(const QImage& image)
 {
-    mPixmap = pixmap;
-    QLabel::setPixmap(scaledPixmap());
+    const int generation = ++mGeneration;
+    mImage = image;
+    mLevels = { image };
+    mSettle.stop();
+
+    if (image.isNull())
+    {
+        QLabel::clear();
+        return;
+    }
+
+    // the chain isn't there yet
+    rescale(Qt::FastTransformation);
+
+    QPointer<PixmapLabel> self(this);
+    QThreadPool::globalInstance()->start([self, generation, image](){
+        QVector<QImage> levels = { image };
+        for (QImage last = image; last.width() / 2 >= MIN_LEVEL_SIZE && last.height() / 2 >= MIN_LEVEL_SIZE; )
+        {
+            last = Pics::resample(last, last.rect(), last.width() / 2, last.height() / 2, Exif::Orientation::Normal);
+            levels.append(last);
+        }
+
+        // self is only looked at in the GUI thread
+        QMetaObject::invokeMethod(qApp, [self, generation, levels](){
+            if (self)
+                self->setLevels(generation, levels);
+        }, Qt::QueuedConnection);
+    });
 }
 
 void PixmapLabel::setPath(const QString& path)
@@ -43,13 +115,16 @@ QSize PixmapLabel::sizeHint() const
 
 void PixmapLabel::resizeEvent(QResizeEvent* /*e*/)
 {
-    if(!mPixmap.isNull())
-        QLabel::setPixmap(scaledPixmap());
+    if (mImage.isNull())
+        return;
+
+    rescale(Qt::FastTransformation);
+    mSettle.start();
 }
 
 int PixmapLabel::heightForWidth(int width) const
 {
-    return mPixmap.isNull() ? height() : 1.0 * mPixmap.height() * width / mPixmap.width();
+    return mImage.isNull() ? height() : 1.0 * mImage.height() * width / mImage.width();
 }
 
 void PixmapLabel::mousePressEvent(QMouseEvent* e)
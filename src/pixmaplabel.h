@@ -1,19 +1,35 @@
 #ifndef PIXMAPLABEL_H
 #define PIXMAPLABEL_H
 
+#include <QImage>
 #include <QLabel>
+#include <QTimer>
+#include <QVector>
 
+/// Shows a picture fitted into the label.
+/// A mip chain (the picture halved again and again) is built off the GUI thread once per picture,
+/// every size is scaled from the nearest larger level: fast while the label is being resized,
+/// smooth once the resizing has settled for SETTLE_MS.
 class PixmapLabel : public QLabel
 {
-    QPixmap mPixmap;
+    QImage mImage;
+    QVector<QImage> mLevels;     // mImage first
+    int mGeneration = 0;         // bumped by setImage(), older chains are dropped
+    QTimer mSettle;
     QString mPath;
 
-    QPixmap scaledPixmap() const;
+    const QImage& level(const QSize& size) const;
+    QSize scaledSize() const;
+    void rescale(Qt::TransformationMode mode);
+    void setLevels(int generation, const QVector<QImage>& levels);
 
 public:
+    static constexpr int MIN_LEVEL_SIZE = 128;
+    static constexpr int SETTLE_MS = 150;
+
     explicit PixmapLabel(QWidget* parent = nullptr);
 
-    void setPixmap(const QPixmap& pixmap);
+    void setImage(const QImage& image);
     void setPath(const QString& path);
     void clear();
 
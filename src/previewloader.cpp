@@ -0,0 +1,130 @@
+#include <QDir>
+#include <QImageReader>
+#include <QMutexLocker>
+
+#include "exif/file.h"
+#include "exifstorage.h"
+#include "pics.h"
+#include "previewloader.h"
+
+constexpr int PreviewLoader::CACHE_SIZE;
+constexpr int PreviewLoader::THREADS;
+
+PreviewLoader::PreviewLoader(QObject* parent) : PreviewLoader(&PreviewLoader::decode, parent)
+{
+
+}
+
+PreviewLoader::PreviewLoader(const Decoder& decoder, QObject* parent) : QObject(parent), mDecoder(decoder), mCache(CACHE_SIZE)
+{
+    mPool.setMaxThreadCount(THREADS);
+}
+
+PreviewLoader::~PreviewLoader()
+{
+    mPool.clear();
+    mPool.waitForDone();
+}
+
+QImage PreviewLoader::show(PhotoId id, const QSize& size, const PhotoIdList& neighbours)
+{
+    // the requests of the previous photo not started yet are useless now
+    mPool.clear();
+
+    QMutexLocker lock(&mMutex);
+
+    if (size != mSize)
+    {
+        mSize = size;
+        mCache.clear();
+    }
+
+    mShown = id;
+    mWanted = QSet<PhotoId>(neighbours.cbegin(), neighbours.cend());
+    mWanted.insert(id);
+
+    // those were dropped by clear()
+    mQueued.clear();
+
+    QImage cached;
+    if (auto image = mCache.object(id))
+        cached = *image;
+    else if (id != INVALID_PHOTO_ID)
+        enqueue(id, true);
+
+    for (PhotoId neighbour: neighbours)
+        if (neighbour != INVALID_PHOTO_ID && !mCache.contains(neighbour))
+            enqueue(neighbour, false);
+
+    return cached;
+}
+
+QImage PreviewLoader::decode(PhotoId id, const QSize& size)
+{
+    const QString path = QDir::toNativeSeparators(ExifStorage::path(id));
+
+    Exif::Orientation orientation;
+    if (auto photo = ExifStorage::data(id))
+        orientation = photo->orientation;
+    else
+        orientation = Exif::File(path, false).orientation();
+
+    QImageReader reader(path);
+    QSize picture = reader.size();
+    if (!picture.isValid())
+        return Pics::fromImageReader(&reader, orientation);
+
+    if (orientation.isRotated())
+        picture.transpose();
+
+    // fitting, not filling, so nothing is cropped; never upscaled
+    const QSize fitted = picture.scaled(size, Qt::KeepAspectRatio).boundedTo(picture);
+    return Pics::fromImageReader(&reader, fitted.width(), fitted.height(), orientation);
+}
+
+/// the lock must be held by the caller
+void PreviewLoader::enqueue(PhotoId id, bool announce)
+{
+    if (mQueued.contains(id) || mRunning.contains(id))
+        return;
+    mQueued.insert(id);
+
+    const QSize size = mSize;
+    mPool.start([this, id, size](){
+        {
+            QMutexLocker lock(&mMutex);
+            mQueued.remove(id);
+            if (!mWanted.contains(id) || size != mSize)
+                return;
+            mRunning.insert(id);
+        }
+
+        const QImage image = mDecoder(id, size);
+
+        QMetaObject::invokeMethod(this, [this, id, size, image](){ finish(id, size, image); }, Qt::QueuedConnection);
+    }, announce ? 1 : 0);
+}
+
+void PreviewLoader::finish(PhotoId id, const QSize& size, const QImage& image)
+{
+    bool shown = false;
+    {
+        QMutexLocker lock(&mMutex);
+        mRunning.remove(id);
+
+        // enqueue() has skipped the photo while it was running
+        if (size != mSize)
+        {
+            if (mWanted.contains(id))
+                enqueue(id, id == mShown);
+            return;
+        }
+
+        if (!image.isNull())
+            mCache.insert(id, new QImage(image));
+        shown = id == mShown;
+    }
+
+    if (shown)
+        emit loaded(id, image);
+}
@@ -0,0 +1,63 @@
+#ifndef PREVIEWLOADER_H
+#define PREVIEWLOADER_H
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QSize>
+#include <QThreadPool>
+
+#include <functional>
+
+#include "photoid.h"
+
+/// Decodes screen-sized previews off the GUI thread.
+/// The shown photo goes first, its neighbours are prefetched after it;
+/// a few previews are kept, so stepping back and forth through a folder doesn't decode anything.
+/// A request the user has moved away from is dropped before it is decoded,
+/// one being decoded already is finished and cached, but not announced;
+/// one decoded for the previous size is dropped and decoded again, if it's still wanted.
+class PreviewLoader : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void loaded(PhotoId id, const QImage& image);
+
+public:
+    static constexpr int CACHE_SIZE = 5;     // previews
+    static constexpr int THREADS = 2;
+
+    /// makes the preview of the photo fitting the size, called in the pool threads
+    using Decoder = std::function<QImage(PhotoId id, const QSize& size)>;
+
+    /// decodes the photo files with decode()
+    explicit PreviewLoader(QObject* parent = nullptr);
+    explicit PreviewLoader(const Decoder& decoder, QObject* parent = nullptr);
+    ~PreviewLoader() override;
+
+    /// \return the cached preview or a null image, then loaded() is emitted later
+    QImage show(PhotoId id, const QSize& size, const PhotoIdList& neighbours = {});
+
+    /// the picture fitting \a size, decoded at the nearest DCT scale
+    static QImage decode(PhotoId id, const QSize& size);
+
+private:
+    void enqueue(PhotoId id, bool announce);
+    void finish(PhotoId id, const QSize& size, const QImage& image);
+
+    Decoder mDecoder;
+    QThreadPool mPool;
+
+    mutable QMutex mMutex;                   // guards everything below
+    QCache<PhotoId, QImage> mCache;
+    QSet<PhotoId> mWanted;                   // the shown photo and its neighbours
+    QSet<PhotoId> mQueued;                   // waiting in mPool
+    QSet<PhotoId> mRunning;                  // being decoded
+    PhotoId mShown = INVALID_PHOTO_ID;
+    QSize mSize;
+};
+
+#endif // PREVIEWLOADER_H
@@ -0,0 +1,134 @@
+#include <QHash>
+
+#include <algorithm>
+#include <cstring>
+
+#include "stringpool.h"
+
+constexpr StringPool::Id StringPool::InvalidId;
+
+StringPool::Id StringPool::insert(const QString& string)
+{
+    const QByteArray utf8 = string.toUtf8();
+    const uint hash = qHash(utf8);
+
+    {
+        QReadLocker lock(&mLock);
+        int i = slot(utf8.constData(), utf8.size(), hash);
+        if (i != -1 && mTable.at(i) != InvalidId)
+            return mTable.at(i);
+    }
+
+    QWriteLocker lock(&mLock);
+
+    // keep the load factor below 3/4
+    if ((mHashes.size() + 1) * 4 > mTable.size() * 3)
+        rehash(std::max(64, mTable.size() * 2));
+
+    int i = slot(utf8.constData(), utf8.size(), hash);
+    if (mTable.at(i) != InvalidId) // inserted by another thread in the meantime
+        return mTable.at(i);
+
+    Id id = static_cast<Id>(mHashes.size());
+    mArena.append(utf8);
+    mOffsets.append(static_cast<quint32>(mArena.size()));
+    mHashes.append(hash);
+    mTable[i] = id;
+
+    return id;
+}
+
+StringPool::Id StringPool::find(const QString& string) const
+{
+    const QByteArray utf8 = string.toUtf8();
+
+    QReadLocker lock(&mLock);
+    int i = slot(utf8.constData(), utf8.size(), qHash(utf8));
+    return i == -1 ? InvalidId : mTable.at(i);
+}
+
+QString StringPool::value(Id id) const
+{
+    QReadLocker lock(&mLock);
+    if (id >= static_cast<Id>(mHashes.size()))
+        return {};
+
+    int size = 0;
+    const char* data = at(id, &size);
+    return QString::fromUtf8(data, size);
+}
+
+/// compares two interned strings without decoding them;
+/// UTF-8 byte order is the same as Unicode code point order
+int StringPool::compare(Id L, Id R) const
+{
+    if (L == R)
+        return 0;
+
+    QReadLocker lock(&mLock);
+
+    int sizeL = 0, sizeR = 0;
+    const char* dataL = at(L, &sizeL);
+    const char* dataR = at(R, &sizeR);
+
+    int cmp = std::memcmp(dataL, dataR, static_cast<size_t>(std::min(sizeL, sizeR)));
+    return cmp ? cmp : sizeL - sizeR;
+}
+
+int StringPool::size() const
+{
+    QReadLocker lock(&mLock);
+    return mHashes.size();
+}
+
+/// \return the slot holding the string or the empty slot where it should be inserted;
+/// -1 if the table is not allocated yet. The lock must be held by the caller.
+int StringPool::slot(const char* data, int size, uint hash) const
+{
+    if (mTable.isEmpty())
+        return -1;
+
+    const int mask = mTable.size() - 1;
+    for (int i = static_cast<int>(hash) & mask; ; i = (i + 1) & mask)
+    {
+        Id id = mTable.at(i);
+        if (id == InvalidId)
+            return i;
+
+        if (mHashes.at(id) == hash)
+        {
+            int len = 0;
+            const char* s = at(id, &len);
+            if (len == size && std::memcmp(s, data, static_cast<size_t>(size)) == 0)
+                return i;
+        }
+    }
+}
+
+const char* StringPool::at(Id id, int* size) const
+{
+    if (id >= static_cast<Id>(mHashes.size()))
+    {
+        *size = 0;
+        return "";
+    }
+
+    quint32 begin = mOffsets.at(id);
+    *size = static_cast<int>(mOffsets.at(id + 1) - begin);
+    return mArena.constData() + begin;
+}
+
+/// rebuilds the table using the stored hashes; no string is hashed again
+void StringPool::rehash(int capacity)
+{
+    mTable.fill(InvalidId, capacity);
+
+    const int mask = capacity - 1;
+    for (Id id = 0; id < static_cast<Id>(mHashes.size()); ++id)
+    {
+        int i = static_cast<int>(mHashes.at(id)) & mask;
+        while (mTable.at(i) != InvalidId)
+            i = (i + 1) & mask;
+        mTable[i] = id;
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#include <QByteArray>
+#include <QReadWriteLock>
+#include <QString>
+#include <QVector>
+
+/// Interning table for strings that are stored and compared many times (e.g. absolute paths).
+/// Every distinct string gets a dense 32-bit id; ids are never reused, so they can index plain arrays.
+/// Strings are kept once, UTF-8 encoded, in a contiguous arena and hashed only on insertion.
+/// All the functions are thread-safe.
+class StringPool
+{
+public:
+    using Id = quint32;
+    static constexpr Id InvalidId = 0xFFFFFFFF;
+
+    Id insert(const QString& string);
+    Id find(const QString& string) const;
+
+    QString value(Id id) const;
+    int compare(Id L, Id R) const;
+
+    int size() const;
+
+private:
+    int slot(const char* data, int size, uint hash) const;
+    const char* at(Id id, int* size) const;
+    void rehash(int capacity);
+
+    mutable QReadWriteLock mLock;
+
+    QByteArray mArena;
+    QVector<quint32> mOffsets = { 0 }; // string N is [mOffsets[N], mOffsets[N + 1])
+    QVector<uint> mHashes;
+    QVector<Id> mTable; // open addressing, size is a power of 2, InvalidId marks an empty slot
+};
+
+#endif // STRINGPOOL_H
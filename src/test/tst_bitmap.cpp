@@ -0,0 +1,83 @@
+#include <QSet>
+
+#include <algorithm>
+
+#include <gtest/gtest.h>
+
+#include "bitmap.h"
+
+static QVector<quint32> sorted(const QSet<quint32>& set)
+{
+    QVector<quint32> values;
+    for (quint32 value: set)
+        values.append(value);
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+TEST(Bitmap, insertRemove)
+{
+    Bitmap bitmap;
+    EXPECT_TRUE(bitmap.isEmpty());
+
+    EXPECT_TRUE(bitmap.insert(1));
+    EXPECT_TRUE(bitmap.insert(70000));
+    EXPECT_FALSE(bitmap.insert(1));
+    EXPECT_EQ(2, bitmap.size());
+
+    EXPECT_TRUE(bitmap.contains(70000));
+    EXPECT_FALSE(bitmap.contains(2));
+
+    EXPECT_TRUE(bitmap.remove(70000));
+    EXPECT_FALSE(bitmap.remove(70000));
+    EXPECT_EQ(QVector<quint32>({ 1 }), bitmap.values());
+}
+
+TEST(Bitmap, denseChunks)
+{
+    // more than 4096 values in a chunk switch it to a bitset and back
+    Bitmap bitmap;
+    for (quint32 i = 0; i < 10000; ++i)
+        bitmap.insert(i * 2);
+    EXPECT_EQ(10000, bitmap.size());
+    EXPECT_TRUE(bitmap.contains(19998));
+    EXPECT_FALSE(bitmap.contains(19999));
+
+    for (quint32 i = 0; i < 9000; ++i)
+        bitmap.remove(i * 2);
+    EXPECT_EQ(1000, bitmap.size());
+    EXPECT_EQ(18000u, bitmap.values().first());
+}
+
+TEST(Bitmap, setOperations)
+{
+    Bitmap a, b;
+    QSet<quint32> sa, sb;
+
+    quint32 seed = 42;
+    auto random = [&seed]{ seed = seed * 1103515245 + 12345; return (seed >> 8) % 200000; };
+
+    for (int i = 0; i < 30000; ++i)
+    {
+        quint32 v = random();
+        a.insert(v);
+        sa.insert(v);
+    }
+
+    for (int i = 0; i < 5000; ++i)
+    {
+        quint32 v = random();
+        b.insert(v);
+        sb.insert(v);
+    }
+
+    EXPECT_EQ(sorted(QSet<quint32>(sa).intersect(sb)), (a & b).values());
+    EXPECT_EQ(sorted(QSet<quint32>(sa).unite(sb)), (a | b).values());
+    EXPECT_EQ(sorted(QSet<quint32>(sa).subtract(sb)), (a - b).values());
+    EXPECT_EQ(sorted(QSet<quint32>(sb).subtract(sa)), (b - a).values());
+
+    Bitmap c = a;
+    c |= b;
+    c -= b;
+    EXPECT_EQ(a - b, c);
+}
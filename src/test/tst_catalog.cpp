@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include "catalog.h"
+#include "exifstorage.h"
+
+static Photo photo(PhotoId id, const QPointF& position, qint64 time, const KeywordIdList& keywords)
+{
+    Photo photo;
+    photo.id = id;
+    photo.position = position;
+    photo.time = time;
+    photo.keywords = keywords;
+    return photo;
+}
+
+TEST(Catalog, columns)
+{
+    Catalog catalog;
+    QMap<KeywordId, int> counts;
+
+    catalog.set(photo(70000, { 55.75, 37.61 }, 1000, { 1, 3 }), &counts);
+    EXPECT_EQ(1, counts.value(3));
+
+    EXPECT_TRUE(catalog.contains(70000));
+    EXPECT_FALSE(catalog.contains(0));
+    EXPECT_EQ(QPointF(55.75, 37.61), catalog.position(70000));
+    EXPECT_EQ(1000, catalog.time(70000));
+    EXPECT_EQ(Catalog::INVALID_TIME, catalog.time(1));
+
+    // parsed again after editing: the old keywords are dropped from the index
+    counts.clear();
+    catalog.set(photo(70000, {}, 1000, { 2 }), &counts);
+    EXPECT_EQ(0, counts.value(1));
+    EXPECT_EQ(1, counts.value(2));
+    EXPECT_EQ(KeywordIdList({ 2 }), catalog.keywords(70000));
+    EXPECT_EQ(KeywordIdList({ 2 }), catalog.keywords());
+    EXPECT_TRUE(catalog.position(70000).isNull());
+}
+
+TEST(Catalog, select)
+{
+    Catalog catalog;
+    for (PhotoId id = 0; id < 1000; ++id)
+        catalog.set(photo(id, { id % 10 * 10.0 + 1, id % 7 * 20.0 + 1 }, id * 100, { id % 3 }));
+
+    const auto inside = CatalogQuery::within(QRectF(QPointF(0, 0), QPointF(20, 20)));
+    const auto early = CatalogQuery::between(0, 50000);
+    const auto tagged = CatalogQuery::tagged(0);
+
+    QVector<quint32> expected;
+    for (PhotoId id = 0; id < 500; ++id)
+        if (id % 10 < 2 && id % 7 == 0 && id % 3 != 0)
+            expected.append(id);
+
+    auto result = catalog.select(CatalogQuery::all({ inside, early, CatalogQuery::negate(tagged) }));
+    EXPECT_EQ(expected, result.values());
+
+    EXPECT_EQ(1000, catalog.select(CatalogQuery::any({ tagged, CatalogQuery::negate(tagged) })).size());
+    EXPECT_EQ(500, catalog.select(early).size());
+}
+
+TEST(Catalog, keywordQuery)
+{
+    enum : KeywordId { family, friends, work };
+
+    Catalog catalog;
+    catalog.set(photo(0, {}, 0, { family }));
+    catalog.set(photo(1, {}, 0, { friends }));
+    catalog.set(photo(2, {}, 0, { family, work }));
+    catalog.set(photo(3, {}, 0, { work }));
+    catalog.set(photo(4, {}, 0, {}));
+
+    const auto tagged = [](KeywordId keyword){ return CatalogQuery::tagged(keyword); };
+
+    // (family OR friends) AND NOT work
+    const auto query = CatalogQuery::all({ CatalogQuery::any({ tagged(family), tagged(friends) }), CatalogQuery::negate(tagged(work)) });
+    EXPECT_EQ(QVector<quint32>({ 0, 1 }), catalog.select(query).values());
+
+    // NOT alone is the complement against the loaded photos, AND of NOTs only subtracts from them
+    EXPECT_EQ(QVector<quint32>({ 1, 3, 4 }), catalog.select(CatalogQuery::negate(tagged(family))).values());
+    EXPECT_EQ(QVector<quint32>({ 1, 4 }), catalog.select(CatalogQuery::all({ CatalogQuery::negate(tagged(family)), CatalogQuery::negate(tagged(work)) })).values());
+
+    // (family AND work) OR NOT (family OR work)
+    const auto nested = CatalogQuery::any({ CatalogQuery::all({ tagged(family), tagged(work) }),
+                                            CatalogQuery::negate(CatalogQuery::any({ tagged(family), tagged(work) })) });
+    EXPECT_EQ(QVector<quint32>({ 1, 2, 4 }), catalog.select(nested).values());
+
+    EXPECT_TRUE(catalog.select(CatalogQuery::all({})).isEmpty());
+
+    // a photo parsed again moves between the keywords
+    catalog.set(photo(2, {}, 0, { friends }));
+    EXPECT_EQ(QVector<quint32>({ 0, 1, 2 }), catalog.select(query).values());
+    EXPECT_EQ(QVector<quint32>({ 3 }), catalog.select(tagged(work)).values());
+}
+
+TEST(Catalog, keywordSlices)
+{
+    Catalog catalog;
+    for (PhotoId id = 0; id < 100; ++id)
+        catalog.set(photo(id, {}, 0, { id }));
+
+    // the growing lists leave their old slices behind, enough of them to be compacted several times
+    for (KeywordId count = 2; count < 200; ++count)
+    {
+        KeywordIdList keywords;
+        for (KeywordId keyword = 0; keyword < count; ++keyword)
+            keywords.append(keyword);
+        catalog.set(photo(count % 100, {}, 0, keywords));
+    }
+
+    EXPECT_EQ(102, catalog.keywords(2).size());
+    EXPECT_EQ(101u, catalog.keywords(2).last());
+    EXPECT_EQ(199, catalog.keywords(99).size());
+    EXPECT_EQ(100, catalog.select(CatalogQuery::tagged(0)).size());
+    EXPECT_TRUE(catalog.select(CatalogQuery::tagged(INVALID_PHOTO_ID)).isEmpty());
+}
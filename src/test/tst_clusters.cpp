@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "clusters.h"
+
+TEST(Mercator, project)
+{
+    const QPointF center = Mercator::project({ 0, 0 });
+    EXPECT_DOUBLE_EQ(128, center.x());
+    EXPECT_NEAR(128, center.y(), 1e-9);
+
+    // the north is up, the east is right
+    const QPointF spb = Mercator::project({ 59.95, 30.32 });
+    EXPECT_GT(spb.x(), 128);
+    EXPECT_LT(spb.y(), 128);
+
+    const QPointF back = Mercator::unproject(spb);
+    EXPECT_NEAR(59.95, back.x(), 1e-9);
+    EXPECT_NEAR(30.32, back.y(), 1e-9);
+
+    // conformal: at 60 degrees, where cos is 1/2, a degree of latitude is as long as two degrees of longitude
+    const QPointF a = Mercator::project({ 60, 30 });
+    const QPointF b = Mercator::project({ 60.001, 30.002 });
+    EXPECT_NEAR(1.0, (b.x() - a.x()) / (a.y() - b.y()), 1e-3);
+}
+
+TEST(SpatialHash, nearest)
+{
+    // cells of 2^10 world pixels, distances in pixels of 2^4 world pixels
+    SpatialHash hash(10);
+    hash.insert(0, { 1000, 1000 });
+    hash.insert(1, { 1100, 1000 });
+    hash.insert(2, { 3000, 1000 });
+
+    EXPECT_EQ(1, hash.nearest({ 1090, 1000 }, 4, 32));
+    EXPECT_EQ(0, hash.nearest({ 1010, 1000 }, 4, 32));
+    EXPECT_EQ(-1, hash.nearest({ 2000, 1000 }, 4, 32));
+
+    // moving within a cell and across cells
+    hash.move(1, { 1100, 1000 }, { 1020, 1000 });
+    EXPECT_EQ(1, hash.nearest({ 1025, 1000 }, 4, 32));
+    hash.move(1, { 1020, 1000 }, { 2500, 1000 });
+    EXPECT_EQ(1, hash.nearest({ 2400, 1000 }, 4, 32));
+
+    EXPECT_TRUE(hash.remove(0, { 1000, 1000 }));
+    EXPECT_FALSE(hash.remove(0, { 1000, 1000 }));
+    EXPECT_EQ(-1, hash.nearest({ 1000, 1000 }, 4, 32));
+
+    QVector<int> found;
+    hash.forIn({ 2000, 0 }, { 2600, 2000 }, [&](int item){ found.append(item); });
+    EXPECT_EQ(QVector<int>({ 1 }), found);
+}
+
+TEST(SpatialHash, kernel)
+{
+    // the vectorized kernel finds the same points as the scalar one, ties included
+    QVector<Mercator::Point> points;
+    quint32 seed = 1;
+    const auto random = [&seed](){ seed = seed * 1664525 + 1013904223; return seed; };
+    for (int i = 0; i < 1000; ++i)
+        points.append({ 0x80000000u + (random() >> 20), 0x80000000u + (random() >> 20) });
+    points.append(points.at(500));
+
+    for (int i = 0; i < 200; ++i)
+    {
+        const Mercator::Point point = { 0x80000000u + (random() >> 20), 0x80000000u + (random() >> 20) };
+        for (int shift: { 0, 4, 8 })
+        {
+            quint32 d1 = 32 * 32, d2 = 32 * 32;
+            const int n = points.size() - i; // all the tail lengths
+            EXPECT_EQ(nearestScalar(points.constData(), n, point, shift, 32, &d1),
+                      nearest(points.constData(), n, point, shift, 32, &d2));
+            EXPECT_EQ(d1, d2);
+        }
+    }
+
+    quint32 d = 32 * 32;
+    EXPECT_EQ(500, nearest(points.constData(), points.size(), points.at(500), 0, 32, &d));
+    EXPECT_EQ(0u, d);
+}
+
+TEST(ClusterIndex, levels)
+{
+    ClusterIndex index(32);
+
+    // 0.01 degree apart: about 7 screen pixels at zoom 10, 58 at zoom 13
+    index.insert(1, { 59.95, 30.32 });
+    index.insert(2, { 59.95, 30.33 });
+    index.insert(3, { -33.9, 151.2 });
+    EXPECT_FALSE(index.insert(3, { 0, 0 }));
+    EXPECT_EQ(3, index.size());
+
+    const auto count = [&](int level){
+        return std::count_if(index.clusters(level).cbegin(), index.clusters(level).cend(),
+                             [](const ClusterIndex::Cluster& c){ return !c.isEmpty(); });
+    };
+
+    EXPECT_EQ(2, count(10));
+    EXPECT_EQ(3, count(13));
+    EXPECT_EQ(index.cluster(1, 10), index.cluster(2, 10));
+    EXPECT_NE(index.cluster(1, 13), index.cluster(2, 13));
+
+    const ClusterIndex::Cluster& spb = index.clusters(10).at(index.cluster(1, 10));
+    EXPECT_EQ(PhotoIdList({ 1, 2 }), spb.photos);
+    EXPECT_NEAR(30.325, spb.position().y(), 1e-6);
+
+    EXPECT_EQ(10, ClusterIndex::level(10.7));
+    EXPECT_EQ(ClusterIndex::MAX_LEVEL, ClusterIndex::level(30));
+
+    // the slot of a removed cluster is reused, the others stay
+    const int sydney = index.cluster(3, 13);
+    const int first = index.cluster(1, 13);
+    EXPECT_TRUE(index.remove(2));
+    EXPECT_FALSE(index.remove(2));
+    EXPECT_EQ(first, index.cluster(1, 13));
+    EXPECT_EQ(PhotoIdList({ 1 }), index.clusters(10).at(index.cluster(1, 10)).photos);
+    EXPECT_NEAR(30.32, index.clusters(10).at(index.cluster(1, 10)).position().y(), 1e-6);
+
+    EXPECT_TRUE(index.remove(3));
+    EXPECT_TRUE(index.clusters(13).at(sydney).isEmpty());
+    index.insert(4, { 10, 10 });
+    EXPECT_EQ(sydney, index.cluster(4, 13));
+    EXPECT_EQ(2, count(13));
+}
+
+TEST(ClusterIndex, removeFromCluster)
+{
+    ClusterIndex index(32);
+    for (PhotoId id = 1; id <= 4; ++id)
+        index.insert(id, { 59.95, 30.32 + id * 0.001 });
+
+    // the last photo takes the place of the removed one, the first one stays first
+    const int spb = index.cluster(1, 10);
+    EXPECT_TRUE(index.remove(2));
+    EXPECT_EQ(PhotoIdList({ 1, 4, 3 }), index.clusters(10).at(spb).photos);
+
+    EXPECT_TRUE(index.remove(1));
+    EXPECT_TRUE(index.remove(3));
+    EXPECT_EQ(PhotoIdList({ 4 }), index.clusters(10).at(spb).photos);
+    EXPECT_TRUE(index.remove(4));
+    EXPECT_TRUE(index.clusters(10).at(spb).isEmpty());
+    EXPECT_EQ(0, index.size());
+}
+
+TEST(ClusterIndex, forIn)
+{
+    ClusterIndex index(32);
+    index.insert(1, { 59.95, 30.32 });
+    index.insert(2, { 55.75, 37.62 });
+    index.insert(3, { -33.9, 151.2 });
+
+    // around Saint Petersburg and Moscow
+    const QRectF europe(Mercator::project({ 61, 29 }), Mercator::project({ 55, 38 }));
+    QVector<int> found;
+    index.forIn(12, europe, [&](int cluster){ found.append(cluster); });
+    std::sort(found.begin(), found.end());
+
+    QVector<int> expected = { index.cluster(1, 12), index.cluster(2, 12) };
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(expected, found);
+}
+
+TEST(ClusterIndex, apply)
+{
+    ClusterIndex index(32);
+    index.insert(1, { 59.95, 30.32 });
+    index.insert(2, { 59.95, 30.33 });
+    index.insert(3, { -33.9, 151.2 });
+
+    // 1 stays, 2 has gone, 3 has moved, 4 is new, 6 has never been there
+    QHash<PhotoId, QPointF> changes;
+    changes.insert(1, { 59.95, 30.32 });
+    changes.insert(2, {});
+    changes.insert(3, { 55.75, 37.62 });
+    changes.insert(4, { 59.95, 30.33 });
+    changes.insert(6, {});
+
+    const int spb = index.cluster(1, 13);
+    EXPECT_TRUE(index.apply(&changes));
+    EXPECT_TRUE(changes.isEmpty());
+    EXPECT_EQ(3, index.size());
+    EXPECT_EQ(spb, index.cluster(1, 13));
+    EXPECT_EQ(-1, index.cluster(2, 13));
+    EXPECT_EQ(index.cluster(1, 10), index.cluster(4, 10));
+    EXPECT_EQ(Mercator::world(QPointF(55.75, 37.62)), index.point(3));
+
+    // a cancelled update leaves the index consistent and the rest of the changes, the next call completes it
+    changes.insert(4, {});
+    changes.insert(5, { 10, 10 });
+    EXPECT_FALSE(index.apply(&changes, [](){ return true; }));
+    EXPECT_FALSE(changes.isEmpty());
+    EXPECT_TRUE(index.apply(&changes));
+    EXPECT_TRUE(changes.isEmpty());
+    EXPECT_EQ(3, index.size());
+    EXPECT_FALSE(index.contains(4));
+    EXPECT_TRUE(index.contains(5));
+}
+
+TEST(ClusterIndex, level)
+{
+    ClusterIndex index(32);
+    index.insert(1, { 59.95, 30.32 });
+
+    // a copy of a level keeps its clusters while the index changes
+    const ClusterIndex::Level level = index.at(10);
+    index.insert(2, { 59.95, 30.33 });
+    index.remove(1);
+
+    EXPECT_EQ(1, level.clusters().at(level.cluster(1)).photos.size());
+    EXPECT_EQ(-1, level.cluster(2));
+    EXPECT_EQ(-1, index.cluster(1, 10));
+    EXPECT_NE(-1, index.cluster(2, 10));
+
+    int found = 0;
+    level.forIn(QRectF(Mercator::project({ 61, 29 }), Mercator::project({ 59, 31 })), [&found](int){ ++found; });
+    EXPECT_EQ(1, found);
+}
@@ -90,6 +90,32 @@ TEST(ExifFile, removeTag)
     }
 }
 
+TEST(ExifFile, embeddedThumbnail)
+{
+    {
+        Exif::File exif;
+        EXPECT_TRUE(exif.embeddedThumbnail().isNull());
+    }
+
+    QString jpeg = TmpJpegFile::withGps();
+    ASSERT_FALSE(jpeg.isEmpty()) << TmpJpegFile::lastError();
+
+    Exif::File exif;
+    ASSERT_TRUE(exif.load(jpeg, false));
+
+    Exif::Thumbnail thumbnail = exif.embeddedThumbnail();
+    ASSERT_FALSE(thumbnail.isNull());
+
+    // the bytes are not copied
+    EXPECT_EQ(reinterpret_cast<const char*>(exif.data()->data), thumbnail.jpeg.constData());
+    EXPECT_TRUE(thumbnail.jpeg.startsWith("\xFF\xD8"));
+    EXPECT_EQ(QSize(256, 192), thumbnail.size);
+
+    // a square crop of a landscape thumbnail
+    EXPECT_EQ(QRect(32, 0, 192, 192), thumbnail.crop(32, 32));
+    EXPECT_EQ(QRect(0, 0, 256, 192), thumbnail.crop(0, 0));
+}
+
 TEST(ExifFile, readWrite)
 {
     double lat = 58.7203335774538746;
@@ -139,3 +165,22 @@ TEST(ExifFile, readWrite)
         }
     }
 }
+
+TEST(ExifUtils, fromDateTime)
+{
+    bool ok = false;
+    EXPECT_EQ(0, Exif::Utils::fromDateTime("1970:01:01 00:00:00", {}, &ok));
+    EXPECT_TRUE(ok);
+
+    // 2019-07-14 13:45:30.250 UTC
+    EXPECT_EQ(1563111930250LL, Exif::Utils::fromDateTime("2019:07:14 13:45:30", "25", &ok));
+    EXPECT_TRUE(ok);
+
+    EXPECT_EQ(-86400000LL, Exif::Utils::fromDateTime("1969:12:31 00:00:00", {}, &ok));
+    EXPECT_TRUE(ok);
+
+    Exif::Utils::fromDateTime("    :  :     :  :  ", {}, &ok);
+    EXPECT_FALSE(ok);
+    Exif::Utils::fromDateTime("2019:13:01 00:00:00", {}, &ok);
+    EXPECT_FALSE(ok);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <numeric>
+
+#include "heatmap.h"
+
+namespace
+{
+
+float sum(const QVector<float>& density)
+{
+    return std::accumulate(density.cbegin(), density.cend(), 0.0f);
+}
+
+} // namespace
+
+TEST(Heatmap, density)
+{
+    Heatmap heatmap;
+    EXPECT_TRUE(heatmap.density(0, 0, 0).isEmpty());
+
+    // in the middle of the world tile, the blur keeps all of it inside
+    const Mercator::Point center = Mercator::world(128, 128);
+    heatmap.add(center);
+    heatmap.add(center);
+    EXPECT_NEAR(2, sum(heatmap.density(0, 0, 0)), 1e-4);
+
+    // at the corner of 4 tiles of the other levels
+    const int middle = Heatmap::tiles(Heatmap::MAX_LEVEL) / 2;
+    float corner = 0;
+    for (int y = middle - 1; y <= middle; ++y)
+        for (int x = middle - 1; x <= middle; ++x)
+            corner += sum(heatmap.density(Heatmap::MAX_LEVEL, x, y));
+    EXPECT_NEAR(2, corner, 1e-4);
+
+    const QVector<float> density = heatmap.density(3, 4, 4);
+    EXPECT_EQ(Heatmap::BINS * Heatmap::BINS, density.size());
+    EXPECT_EQ(density.at(0), *std::max_element(density.cbegin(), density.cend()));
+    EXPECT_EQ(0, density.at(Heatmap::BINS * Heatmap::BINS - 1));
+
+    heatmap.remove(center);
+    heatmap.remove(center);
+    EXPECT_NEAR(0, sum(heatmap.density(0, 0, 0)), 1e-6);
+}
+
+TEST(Heatmap, borders)
+{
+    Heatmap heatmap;
+
+    // a photo at the left edge of the world spills over the antimeridian to the last tile
+    const quint64 before = heatmap.stamp(1, 1, 0);
+    heatmap.add(Mercator::world(0.1, 64));
+    EXPECT_GT(heatmap.stamp(1, 1, 0), before);
+    EXPECT_GT(sum(heatmap.density(1, 1, 0)), 0.01f);
+    EXPECT_NEAR(1, sum(heatmap.density(1, 0, 0)) + sum(heatmap.density(1, 1, 0)), 1e-4);
+    EXPECT_EQ(0, sum(heatmap.density(1, 1, 1)));
+}
+
+TEST(Heatmap, drop)
+{
+    Heatmap heatmap;
+
+    // two photos on both sides of the border of the tiles (0, 0) and (1, 0) of the level 1
+    const Mercator::Point left = Mercator::world(126, 64);
+    heatmap.add(left);
+    heatmap.add(Mercator::world(136, 64));
+    const quint64 before = heatmap.stamp(1, 1, 0);
+    const float right = sum(heatmap.density(1, 1, 0));
+
+    // the emptied tile is dropped, the one next to it still sees the change
+    heatmap.remove(left);
+    EXPECT_TRUE(heatmap.density(1, 0, 0).isEmpty());
+    EXPECT_NE(before, heatmap.stamp(1, 1, 0));
+    EXPECT_LT(sum(heatmap.density(1, 1, 0)), right);
+    EXPECT_NEAR(1, sum(heatmap.density(0, 0, 0)), 1e-4);
+}
+
+TEST(Heatmap, batch)
+{
+    QVector<Mercator::Point> points;
+    quint32 seed = 1;
+    const auto random = [&seed](){ seed = seed * 1664525 + 1013904223; return seed; };
+    for (int i = 0; i < 10000; ++i)
+        points.append({ random(), 0x80000000u + (random() >> 4) });
+
+    Heatmap one, batch;
+    for (const Mercator::Point& point: points)
+        one.add(point);
+    batch.add(points);
+
+    for (int level: { 0, 2, Heatmap::MAX_LEVEL })
+        for (int y = 0; y < Heatmap::tiles(level) && y < 8; ++y)
+            for (int x = 0; x < Heatmap::tiles(level) && x < 8; ++x)
+                EXPECT_EQ(one.density(level, x, y), batch.density(level, x, y));
+
+    batch.add(points, -1);
+    EXPECT_NEAR(0, sum(batch.density(0, 0, 0)), 1e-3);
+}
@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <functional>
+
+#include "exif/file.h"
+#include "exif/utils.h"
+#include "exifstorage.h"
+#include "model.h"
+#include "tmpjpegfile.h"
+
+namespace
+{
+
+const int TIMEOUT = 5000; // ms
+
+bool waitFor(const std::function<bool()>& done)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!done() && timer.elapsed() < TIMEOUT)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    return done();
+}
+
+qint64 msecs(int year)
+{
+    return QDateTime(QDate(year, 1, 1), QTime(0, 0), Qt::UTC).toMSecsSinceEpoch();
+}
+
+/// a copy of the test photo taken at the place and the time
+QString photo(const QTemporaryDir& dir, const QString& name, double lat, double lon, const QByteArray& time)
+{
+    const QString source = TmpJpegFile::withGps();
+    const QString path = dir.filePath(name);
+    if (source.isEmpty() || !QFile::copy(source, path))
+        return {};
+
+    Exif::File exif;
+    if (!exif.load(path, false))
+        return {};
+
+    exif.setValue(EXIF_IFD_GPS, Exif::Tag::GPS::LATITUDE, Exif::Utils::toDMS(lat));
+    exif.setValue(EXIF_IFD_GPS, Exif::Tag::GPS::LATITUDE_REF, Exif::Utils::toLatitudeRef(lat));
+    exif.setValue(EXIF_IFD_GPS, Exif::Tag::GPS::LONGITUDE, Exif::Utils::toDMS(lon));
+    exif.setValue(EXIF_IFD_GPS, Exif::Tag::GPS::LONGITUDE_REF, Exif::Utils::toLongitudeRef(lon));
+    exif.setValue(EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_ORIGINAL, time);
+    return exif.save(path) ? path : QString();
+}
+
+/// the row signals of the model since the last clear(); only the changes of the buckets are counted,
+/// not the ones of their thumbnails
+struct Signals
+{
+    int inserted = 0;
+    int removed = 0;
+    int changed = 0;
+    int reset = 0;
+
+    void connect(QAbstractItemModel* model)
+    {
+        QObject::connect(model, &QAbstractItemModel::rowsInserted, [this](const QModelIndex&, int first, int last){ inserted += last - first + 1; });
+        QObject::connect(model, &QAbstractItemModel::rowsRemoved, [this](const QModelIndex&, int first, int last){ removed += last - first + 1; });
+        QObject::connect(model, &QAbstractItemModel::dataChanged, [this](const QModelIndex& first, const QModelIndex& last, const QVector<int>& roles){
+            if (roles.contains(MapPhotoListModel::Role::Files))
+                changed += last.row() - first.row() + 1;
+        });
+        QObject::connect(model, &QAbstractItemModel::modelReset, [this](){ ++reset; });
+    }
+
+    void clear() { inserted = removed = changed = reset = 0; }
+};
+
+} // namespace
+
+TEST(MapPhotoListModel, updateRows)
+{
+    int argc = 1;
+    char name[] = "test";
+    char* argv[] = { name, nullptr };
+    QCoreApplication app(argc, argv);
+
+    // stops the reader thread, whatever the test ends with
+    struct Storage { ~Storage() { ExifStorage::destroy(); } } storage;
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+
+    // two photos a kilometer apart, one bucket on a country scale, and one in another country a year earlier
+    const QStringList paths = {
+        photo(dir, "a.jpg", 59.95, 30.30, "2020:06:01 12:00:00"),
+        photo(dir, "b.jpg", 59.95, 30.32, "2020:06:02 12:00:00"),
+        photo(dir, "c.jpg", 48.85, 2.35, "2019:06:01 12:00:00"),
+    };
+    ASSERT_FALSE(paths.contains(QString())) << TmpJpegFile::lastError();
+
+    PhotoIdList ids;
+    for (const QString& path: paths)
+    {
+        ids.append(ExifStorage::id(path));
+        ExifStorage::parse(ids.last());
+    }
+    ASSERT_TRUE(waitFor([&](){ return std::all_of(ids.cbegin(), ids.cend(), [](PhotoId id){ return ExifStorage::hasThumbnail(id); }); }));
+
+    MapPhotoListModel model;
+    Signals rows;
+    rows.connect(&model);
+
+    // the whole world at zoom 5
+    for (PhotoId id: ids)
+        model.insert(id);
+    ASSERT_TRUE(waitFor([&](){ return model.rowCount() == 2; }));
+    EXPECT_EQ(2, rows.inserted);
+    EXPECT_EQ(0, rows.removed);
+
+    // zooming in splits the bucket once the map settles: its row stays with one photo, the other one is added
+    rows.clear();
+    model.setZoom(17);
+    ASSERT_TRUE(waitFor([&](){ return model.rowCount() == 3; }));
+    EXPECT_EQ(1, rows.inserted);
+    EXPECT_EQ(0, rows.removed);
+    EXPECT_EQ(1, rows.changed);
+    for (int row = 0; row < model.rowCount(); ++row)
+        EXPECT_EQ(1, model.bucket(row)->photos.size());
+
+    // the period drops the older photo, the others keep their rows
+    rows.clear();
+    model.setPeriod({ msecs(2020), msecs(2021) });
+    ASSERT_TRUE(waitFor([&](){ return model.rowCount() == 2; }));
+    EXPECT_EQ(0, rows.inserted);
+    EXPECT_EQ(1, rows.removed);
+    EXPECT_EQ(0, rows.changed);
+    EXPECT_FALSE(model.index(ids.last()).isValid());
+    EXPECT_TRUE(model.index(ids.first()).isValid());
+
+    // and brings it back
+    rows.clear();
+    model.setPeriod({});
+    ASSERT_TRUE(waitFor([&](){ return model.rowCount() == 3; }));
+    EXPECT_EQ(1, rows.inserted);
+    EXPECT_EQ(0, rows.removed);
+
+    // zooming out joins the bucket at once
+    rows.clear();
+    model.setZoom(5);
+    ASSERT_TRUE(waitFor([&](){ return model.rowCount() == 2; }));
+    EXPECT_EQ(0, rows.inserted);
+    EXPECT_EQ(1, rows.removed);
+    EXPECT_EQ(1, rows.changed);
+    EXPECT_EQ(0, rows.reset);
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <QImage>
+
+#include "exif/file.h"
+#include "pics.h"
+
+namespace
+{
+
+/// 4x2 picture with a distinct color in every pixel
+QImage numbered()
+{
+    QImage image(4, 2, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); ++y)
+        for (int x = 0; x < image.width(); ++x)
+            image.setPixel(x, y, 0xff000000u | static_cast<quint32>(y * 4 + x));
+    return image;
+}
+
+} // namespace
+
+TEST(Pics, resampleOrients)
+{
+    const QImage image = numbered();
+
+    QImage same = Pics::resample(image, image.rect(), 4, 2, Exif::Orientation::Normal);
+    ASSERT_EQ(QSize(4, 2), same.size());
+    EXPECT_EQ(0xff000006u, same.pixel(2, 1));
+
+    QImage mirrored = Pics::resample(image, image.rect(), 4, 2, Exif::Orientation::MirrorHorizontal);
+    EXPECT_EQ(0xff000003u, mirrored.pixel(0, 0));
+
+    QImage flipped = Pics::resample(image, image.rect(), 4, 2, Exif::Orientation::MirrorVertical);
+    EXPECT_EQ(0xff000004u, flipped.pixel(0, 0));
+
+    // the left column goes up
+    QImage rotated = Pics::resample(image, image.rect(), 2, 4, Exif::Orientation::Rotate90CW);
+    ASSERT_EQ(QSize(2, 4), rotated.size());
+    EXPECT_EQ(0xff000004u, rotated.pixel(0, 0));
+    EXPECT_EQ(0xff000000u, rotated.pixel(1, 0));
+    EXPECT_EQ(0xff000003u, rotated.pixel(1, 3));
+
+    QImage counterRotated = Pics::resample(image, image.rect(), 2, 4, Exif::Orientation::Rotate270CW);
+    EXPECT_EQ(0xff000003u, counterRotated.pixel(0, 0));
+    EXPECT_EQ(0xff000000u, counterRotated.pixel(0, 3));
+    EXPECT_EQ(0xff000004u, counterRotated.pixel(1, 3));
+
+    QImage transposed = Pics::resample(image, image.rect(), 2, 4, Exif::Orientation::MirrorHorizontalAndRotate270CW);
+    EXPECT_EQ(0xff000001u, transposed.pixel(0, 1));
+    EXPECT_EQ(0xff000004u, transposed.pixel(1, 0));
+}
+
+TEST(Pics, resampleAverages)
+{
+    // 2x2 blocks of 0, 40, 80, 120 in every channel but alpha
+    QImage image(4, 4, QImage::Format_RGB32);
+    for (int y = 0; y < 4; ++y)
+        for (int x = 0; x < 4; ++x)
+            image.setPixel(x, y, 0xff000000u | 0x010101u * static_cast<quint32>(40 * (y / 2 * 2 + x / 2)));
+
+    QImage half = Pics::resample(image, image.rect(), 2, 2, Exif::Orientation::Normal);
+    EXPECT_EQ(0xff000000u, half.pixel(0, 0));
+    EXPECT_EQ(0xff282828u, half.pixel(1, 0));
+    EXPECT_EQ(0xff505050u, half.pixel(0, 1));
+    EXPECT_EQ(0xff787878u, half.pixel(1, 1));
+
+    QImage one = Pics::resample(image, image.rect(), 1, 1, Exif::Orientation::Normal);
+    EXPECT_EQ(0xff3c3c3cu, one.pixel(0, 0));
+
+    // only the cropped pixels are averaged
+    QImage cropped = Pics::resample(image, QRect(2, 0, 2, 2), 1, 1, Exif::Orientation::Normal);
+    EXPECT_EQ(0xff282828u, cropped.pixel(0, 0));
+
+    EXPECT_TRUE(Pics::resample(image, QRect(8, 8, 2, 2), 1, 1, Exif::Orientation::Normal).isNull());
+}
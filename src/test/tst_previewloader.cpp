@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSemaphore>
+#include <QVector>
+
+#include <functional>
+
+#include "previewloader.h"
+
+namespace
+{
+
+const QSize SIZE(64, 48);
+const int TIMEOUT = 5000; // ms
+
+/// runs the event loop of the test until \a done
+bool waitFor(const std::function<bool()>& done)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!done() && timer.elapsed() < TIMEOUT)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    return done();
+}
+
+/// decodes a flat image per photo, in the order it is asked to;
+/// the photos having a gate wait until it is opened
+class Decoder
+{
+public:
+    QImage operator()(PhotoId id, const QSize& size)
+    {
+        QSemaphore* gate = nullptr;
+        {
+            QMutexLocker lock(&mMutex);
+            mDecoded.append(id);
+            gate = mGates.value(id);
+        }
+
+        if (gate && !gate->tryAcquire(1, TIMEOUT))
+            return {};
+
+        QImage image(size, QImage::Format_RGB32);
+        image.fill(qRgb(id, 0, 0));
+        return image;
+    }
+
+    void close(PhotoId id) { mGates.insert(id, new QSemaphore); }
+    void open(PhotoId id) { mGates.value(id)->release(); }
+
+    PhotoIdList decoded() const
+    {
+        QMutexLocker lock(&mMutex);
+        return mDecoded;
+    }
+
+    ~Decoder() { qDeleteAll(mGates); }
+
+private:
+    mutable QMutex mMutex;
+    PhotoIdList mDecoded;
+    QHash<PhotoId, QSemaphore*> mGates;  // set up before the loader runs
+};
+
+/// the loaded() of the test loader
+struct Loaded
+{
+    PhotoIdList ids;
+
+    void connect(PreviewLoader* loader)
+    {
+        QObject::connect(loader, &PreviewLoader::loaded, [this](PhotoId id, const QImage& image){
+            EXPECT_EQ(qRgb(id, 0, 0), image.pixel(0, 0));
+            ids.append(id);
+        });
+    }
+};
+
+class PreviewLoaderTest : public testing::Test
+{
+protected:
+    int mArgc = 1;
+    char mName[5] = "test";
+    char* mArgv[2] = { mName, nullptr };
+    QCoreApplication mApp { mArgc, mArgv };
+};
+
+} // namespace
+
+TEST_F(PreviewLoaderTest, cache)
+{
+    Decoder decoder;
+    PreviewLoader loader(std::ref(decoder));
+    Loaded loaded;
+    loaded.connect(&loader);
+
+    // the neighbours are prefetched, only the shown photo is announced
+    EXPECT_TRUE(loader.show(1, SIZE, { 2 }).isNull());
+    ASSERT_TRUE(waitFor([&](){ return loaded.ids.size() == 1 && decoder.decoded().size() == 2; }));
+    EXPECT_EQ(PhotoIdList({ 1 }), loaded.ids);
+
+    // the prefetched neighbour is finished in the event loop as well
+    QCoreApplication::processEvents();
+    QImage image = loader.show(2, SIZE, { 1 });
+    if (image.isNull())
+        ASSERT_TRUE(waitFor([&](){ return loaded.ids.size() == 2; }));
+    else
+        EXPECT_EQ(SIZE, image.size());
+    EXPECT_EQ(2, decoder.decoded().size());
+
+    // stepping back decodes nothing
+    image = loader.show(1, SIZE);
+    EXPECT_EQ(qRgb(1, 0, 0), image.pixel(0, 0));
+    EXPECT_EQ(2, decoder.decoded().size());
+
+    // another size drops the cache
+    EXPECT_TRUE(loader.show(1, SIZE * 2).isNull());
+    ASSERT_TRUE(waitFor([&](){ return decoder.decoded().size() == 3; }));
+}
+
+TEST_F(PreviewLoaderTest, cancel)
+{
+    Decoder decoder;
+    decoder.close(1);
+    decoder.close(2);
+
+    PreviewLoader loader(std::ref(decoder));
+    Loaded loaded;
+    loaded.connect(&loader);
+
+    // both threads are busy with 1 and 2, 3 waits
+    loader.show(1, SIZE, { 2, 3 });
+    ASSERT_TRUE(waitFor([&](){ return decoder.decoded().size() == 2; }));
+
+    // moved away: 3 is dropped before it is decoded, 1 and 2 are finished but not announced
+    loader.show(4, SIZE);
+    decoder.open(1);
+    decoder.open(2);
+    ASSERT_TRUE(waitFor([&](){ return loaded.ids.size() == 1; }));
+    QCoreApplication::processEvents();
+
+    EXPECT_EQ(PhotoIdList({ 4 }), loaded.ids);
+    EXPECT_FALSE(decoder.decoded().contains(3));
+
+    // those are cached
+    EXPECT_FALSE(loader.show(1, SIZE).isNull());
+    EXPECT_EQ(3, decoder.decoded().size());
+}
+
+TEST_F(PreviewLoaderTest, resize)
+{
+    Decoder decoder;
+    decoder.close(1);
+
+    PreviewLoader loader(std::ref(decoder));
+    QVector<QSize> sizes;
+    QObject::connect(&loader, &PreviewLoader::loaded, [&sizes](PhotoId /*id*/, const QImage& image){ sizes.append(image.size()); });
+
+    loader.show(1, SIZE);
+    ASSERT_TRUE(waitFor([&](){ return decoder.decoded().size() == 1; }));
+
+    // resized while decoding: the old preview is dropped, the photo is decoded again at the new size
+    EXPECT_TRUE(loader.show(1, SIZE * 2).isNull());
+    decoder.open(1);
+    decoder.open(1);
+    ASSERT_TRUE(waitFor([&](){ return sizes.size() == 1; }));
+    EXPECT_EQ(QVector<QSize>({ SIZE * 2 }), sizes);
+    EXPECT_EQ(2, decoder.decoded().size());
+
+    EXPECT_EQ(SIZE * 2, loader.show(1, SIZE * 2).size());
+    EXPECT_EQ(2, decoder.decoded().size());
+}
+
+TEST_F(PreviewLoaderTest, priority)
+{
+    Decoder decoder;
+    decoder.close(1);
+    decoder.close(2);
+
+    PreviewLoader loader(std::ref(decoder));
+    Loaded loaded;
+    loaded.connect(&loader);
+
+    loader.show(1, SIZE, { 2 });
+    ASSERT_TRUE(waitFor([&](){ return decoder.decoded().size() == 2; }));
+
+    // all queued behind the busy threads
+    loader.show(10, SIZE, { 11, 12 });
+
+    // one thread at a time: it takes the shown photo before the neighbours
+    decoder.open(1);
+    ASSERT_TRUE(waitFor([&](){ return decoder.decoded().size() == 3; }));
+    EXPECT_EQ(10u, decoder.decoded().at(2));
+
+    decoder.open(2);
+    ASSERT_TRUE(waitFor([&](){ return decoder.decoded().size() == 5 && loaded.ids.size() == 1; }));
+    EXPECT_EQ(PhotoIdList({ 10 }), loaded.ids);
+}
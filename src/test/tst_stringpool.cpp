@@ -0,0 +1,61 @@
+#include <QString>
+
+#include <gtest/gtest.h>
+
+#include "stringpool.h"
+
+TEST(StringPool, insertFind)
+{
+    StringPool pool;
+
+    EXPECT_EQ(0, pool.size());
+    EXPECT_EQ(StringPool::InvalidId, pool.find("/tmp/a.jpg"));
+
+    auto a = pool.insert("/tmp/a.jpg");
+    auto b = pool.insert("/tmp/b.jpg");
+    auto c = pool.insert("/tmp/фонарь.jpg");
+
+    EXPECT_EQ(0u, a);
+    EXPECT_EQ(1u, b);
+    EXPECT_EQ(2u, c);
+    EXPECT_EQ(3, pool.size());
+
+    EXPECT_EQ(a, pool.insert("/tmp/a.jpg"));
+    EXPECT_EQ(c, pool.find("/tmp/фонарь.jpg"));
+    EXPECT_EQ(3, pool.size());
+
+    EXPECT_EQ(QString("/tmp/фонарь.jpg"), pool.value(c));
+    EXPECT_TRUE(pool.value(42).isNull());
+}
+
+TEST(StringPool, rehash)
+{
+    StringPool pool;
+
+    const int count = 10000;
+    for (int i = 0; i < count; ++i)
+        ASSERT_EQ(static_cast<StringPool::Id>(i), pool.insert(QString("/photos/%1.jpg").arg(i)));
+
+    ASSERT_EQ(count, pool.size());
+
+    for (int i = 0; i < count; ++i)
+    {
+        QString path = QString("/photos/%1.jpg").arg(i);
+        ASSERT_EQ(static_cast<StringPool::Id>(i), pool.find(path));
+        ASSERT_EQ(path, pool.value(static_cast<StringPool::Id>(i)));
+    }
+}
+
+TEST(StringPool, compare)
+{
+    StringPool pool;
+
+    auto a = pool.insert("/a/b");
+    auto ab = pool.insert("/a/b/c");
+    auto b = pool.insert("/b");
+
+    EXPECT_EQ(0, pool.compare(a, a));
+    EXPECT_LT(pool.compare(a, ab), 0);
+    EXPECT_LT(pool.compare(ab, b), 0);
+    EXPECT_GT(pool.compare(b, a), 0);
+}
@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include <QImage>
+#include <QPainter>
+
+#include "thumbnailatlas.h"
+
+namespace
+{
+
+QRgb color(PhotoId id)
+{
+    return qRgb(id % 256, id / 256 % 256, 0x80);
+}
+
+QImage filled(PhotoId id, int size)
+{
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(color(id));
+    return image;
+}
+
+QVector<PhotoId> range(PhotoId from, PhotoId to)
+{
+    QVector<PhotoId> ids;
+    for (PhotoId id = from; id < to; ++id)
+        ids.append(id);
+    return ids;
+}
+
+QRgb pixel(const ThumbnailAtlas::Handle& handle)
+{
+    return ThumbnailAtlas::page(handle.page).pixel(handle.rect.center());
+}
+
+// the pages of the 64 px size class hold this many cells
+const int CELLS = (ThumbnailAtlas::PAGE_SIZE / 64) * (ThumbnailAtlas::PAGE_SIZE / 64);
+
+} // namespace
+
+TEST(ThumbnailAtlas, allocate)
+{
+    ThumbnailAtlas::clear();
+
+    EXPECT_EQ(16, ThumbnailAtlas::cellSize(10));
+    EXPECT_EQ(32, ThumbnailAtlas::cellSize(32));
+    EXPECT_EQ(64, ThumbnailAtlas::cellSize(100));
+
+    EXPECT_TRUE(ThumbnailAtlas::handle(1, 32).isNull());
+    EXPECT_TRUE(ThumbnailAtlas::pack({ 1, 2, 3, INVALID_PHOTO_ID }, 32, &filled));
+
+    // a lookup packs nothing
+    EXPECT_TRUE(ThumbnailAtlas::handle(1, 16).isNull());
+    EXPECT_TRUE(ThumbnailAtlas::handle(4, 32).isNull());
+
+    const ThumbnailAtlas::Handle h1 = ThumbnailAtlas::handle(1, 32);
+    const ThumbnailAtlas::Handle h2 = ThumbnailAtlas::handle(2, 30);
+    ASSERT_FALSE(h1.isNull());
+    ASSERT_FALSE(h2.isNull());
+    EXPECT_EQ(h1.page, h2.page);
+    EXPECT_EQ(QSize(32, 32), h1.rect.size());
+    EXPECT_FALSE(h1.rect.intersects(h2.rect));
+    EXPECT_EQ(color(1), pixel(h1));
+    EXPECT_EQ(color(2), pixel(h2));
+
+    // packed already: only marked used
+    EXPECT_FALSE(ThumbnailAtlas::pack({ 1, 2, 3 }, 32, &filled));
+
+    // a photo without a thumbnail is left out
+    EXPECT_FALSE(ThumbnailAtlas::pack({ 5 }, 32, [](PhotoId, int){ return QImage(); }));
+    EXPECT_TRUE(ThumbnailAtlas::handle(5, 32).isNull());
+
+    ThumbnailAtlas::remove(2);
+    EXPECT_TRUE(ThumbnailAtlas::handle(2, 32).isNull());
+    EXPECT_FALSE(ThumbnailAtlas::handle(1, 32).isNull());
+}
+
+TEST(ThumbnailAtlas, evict)
+{
+    ThumbnailAtlas::clear();
+
+    const int capacity = ThumbnailAtlas::MAX_PAGES * CELLS;
+    EXPECT_TRUE(ThumbnailAtlas::pack(range(0, capacity), 64, &filled));
+    EXPECT_FALSE(ThumbnailAtlas::handle(0, 64).isNull());
+    EXPECT_FALSE(ThumbnailAtlas::handle(capacity - 1, 64).isNull());
+
+    // the least recently used are evicted: the first ones, but the one used again
+    EXPECT_FALSE(ThumbnailAtlas::pack({ 0 }, 64, &filled));
+    EXPECT_TRUE(ThumbnailAtlas::pack({ 100000 }, 64, &filled));
+    EXPECT_FALSE(ThumbnailAtlas::handle(100000, 64).isNull());
+    EXPECT_FALSE(ThumbnailAtlas::handle(0, 64).isNull());
+    EXPECT_TRUE(ThumbnailAtlas::handle(1, 64).isNull());
+    EXPECT_FALSE(ThumbnailAtlas::handle(capacity - 1, 64).isNull());
+    EXPECT_EQ(color(100000), pixel(ThumbnailAtlas::handle(100000, 64)));
+
+    // a batch bigger than the atlas never evicts its own cells: the tail stays out
+    ThumbnailAtlas::clear();
+    const QVector<PhotoId> batch = range(0, capacity + 100);
+    EXPECT_TRUE(ThumbnailAtlas::pack(batch, 64, &filled));
+    EXPECT_FALSE(ThumbnailAtlas::handle(0, 64).isNull());
+    EXPECT_FALSE(ThumbnailAtlas::handle(capacity - 1, 64).isNull());
+    EXPECT_TRUE(ThumbnailAtlas::handle(capacity, 64).isNull());
+
+    // thus packing it again is no change
+    EXPECT_FALSE(ThumbnailAtlas::pack(batch, 64, &filled));
+    EXPECT_FALSE(ThumbnailAtlas::handle(0, 64).isNull());
+
+    // the other size classes have their own pages
+    EXPECT_TRUE(ThumbnailAtlas::pack({ 0 }, 16, &filled));
+    EXPECT_FALSE(ThumbnailAtlas::handle(0, 16).isNull());
+}
+
+TEST(ThumbnailAtlas, compact)
+{
+    ThumbnailAtlas::clear();
+
+    // two full pages
+    EXPECT_TRUE(ThumbnailAtlas::pack(range(0, 2 * CELLS), 64, &filled));
+    const int first = ThumbnailAtlas::handle(0, 64).page;
+    const int second = ThumbnailAtlas::handle(CELLS, 64).page;
+    ASSERT_NE(first, second);
+    const ThumbnailAtlas::Handle moved = ThumbnailAtlas::handle(CELLS - 1, 64);
+
+    // the first page gets sparse, then the second one gets enough room for it
+    for (PhotoId id: range(0, CELLS - 24))
+        ThumbnailAtlas::remove(id);
+    for (PhotoId id: range(CELLS, CELLS + 30))
+        ThumbnailAtlas::remove(id);
+
+    // the cells left are moved into one page with their pixels
+    for (PhotoId id: range(CELLS - 24, CELLS))
+    {
+        const ThumbnailAtlas::Handle handle = ThumbnailAtlas::handle(id, 64);
+        ASSERT_FALSE(handle.isNull());
+        EXPECT_EQ(second, handle.page);
+        EXPECT_EQ(color(id), pixel(handle));
+    }
+    for (PhotoId id: range(CELLS + 30, 2 * CELLS))
+        EXPECT_EQ(color(id), pixel(ThumbnailAtlas::handle(id, 64)));
+
+    EXPECT_TRUE(ThumbnailAtlas::page(first).isNull());
+
+    // a handle issued before the compaction draws nothing, a fresh one does
+    QImage canvas(64, 64, QImage::Format_ARGB32_Premultiplied);
+    canvas.fill(Qt::transparent);
+    QPainter painter(&canvas);
+    EXPECT_FALSE(ThumbnailAtlas::paint(&painter, canvas.rect(), moved));
+    EXPECT_TRUE(ThumbnailAtlas::paint(&painter, canvas.rect(), ThumbnailAtlas::handle(CELLS - 1, 64)));
+    painter.end();
+    EXPECT_EQ(color(CELLS - 1), canvas.pixel(32, 32));
+}
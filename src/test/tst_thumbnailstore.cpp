@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+
+#include <QColor>
+#include <QImage>
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "exif/file.h"
+#include "exifstorage.h"
+#include "thumbnailstore.h"
+#include "tmpjpegfile.h"
+
+namespace
+{
+
+QByteArray filled(int size, Qt::GlobalColor color)
+{
+    QImage image(size, size, QImage::Format_RGB32);
+    image.fill(color);
+    return ThumbnailStore::compress(image);
+}
+
+/// JPEG keeps a flat color close enough
+bool near(QRgb L, QRgb R)
+{
+    return std::abs(qRed(L) - qRed(R)) < 8 && std::abs(qGreen(L) - qGreen(R)) < 8 && std::abs(qBlue(L) - qBlue(R)) < 8;
+}
+
+} // namespace
+
+TEST(ThumbnailStore, insertLookup)
+{
+    ThumbnailStore store;
+    EXPECT_FALSE(store.contains(7));
+    EXPECT_TRUE(store.image(7, 0, 32).isNull());
+
+    store.insert(7, 0, filled(32, Qt::red));
+    EXPECT_TRUE(store.contains(7));
+    EXPECT_FALSE(store.contains(7, 1));
+    EXPECT_FALSE(store.compressed(7).isEmpty());
+
+    QImage image = store.image(7, 0, 32);
+    ASSERT_EQ(QSize(32, 32), image.size());
+    EXPECT_TRUE(near(qRgb(255, 0, 0), image.pixel(16, 16)));
+
+    // a missing level is stood in for by the one below, never upscaled
+    bool exact = true;
+    EXPECT_EQ(QSize(32, 32), store.image(7, 1, 64, &exact).size());
+    EXPECT_FALSE(exact);
+
+    store.insert(7, 1, filled(64, Qt::blue));
+    image = store.image(7, 1, 64, &exact);
+    EXPECT_TRUE(exact);
+    ASSERT_EQ(QSize(64, 64), image.size());
+    EXPECT_TRUE(near(qRgb(0, 0, 255), image.pixel(32, 32)));
+
+    // parsed again: the new level 0 drops the others and the decoded images
+    store.insert(7, 0, filled(32, Qt::green));
+    EXPECT_FALSE(store.contains(7, 1));
+    EXPECT_TRUE(near(qRgb(0, 255, 0), store.image(7, 0, 32).pixel(16, 16)));
+}
+
+TEST(ThumbnailStore, compact)
+{
+    ThumbnailStore store;
+    const QByteArray bytes = filled(32, Qt::red);
+
+    store.insert(1, 0, filled(32, Qt::blue));
+    for (int i = 0; i < 100; ++i)
+        store.insert(2, 0, bytes);
+
+    // the replaced thumbnails are dropped once they are half of the arena
+    EXPECT_LE(store.arenaSize(), 5 * bytes.size());
+    EXPECT_TRUE(near(qRgb(0, 0, 255), store.image(1, 0, 32).pixel(16, 16)));
+    EXPECT_EQ(bytes, store.compressed(2));
+}
+
+TEST(ThumbnailStore, cacheCost)
+{
+    // a 32x32 RGB32 image costs 4 KB
+    ThumbnailStore store(8);
+    for (PhotoId id = 0; id < 3; ++id)
+        store.insert(id, 0, filled(32, Qt::red));
+
+    store.image(0, 0, 32);
+    EXPECT_EQ(4, store.cacheCost());
+    store.image(0, 0, 32);
+    EXPECT_EQ(4, store.cacheCost());
+
+    store.image(1, 0, 32);
+    store.image(2, 0, 32);
+    EXPECT_EQ(8, store.cacheCost());
+
+    // a replaced thumbnail takes its decoded images along
+    store.insert(2, 0, filled(32, Qt::blue));
+    EXPECT_EQ(4, store.cacheCost());
+}
+
+TEST(ThumbnailStore, cacheKey)
+{
+    // the key is (id << 16) | size: ids differing above 16 bits and sizes of one id are apart
+    ThumbnailStore store;
+    store.insert(1, 0, filled(32, Qt::red));
+    store.insert(1 + 65536, 0, filled(32, Qt::blue));
+
+    EXPECT_EQ(QSize(16, 16), store.image(1, 0, 16).size());
+    EXPECT_EQ(QSize(32, 32), store.image(1, 0, 32).size());
+    EXPECT_EQ(QSize(16, 16), store.image(1, 0, 16).size());
+
+    EXPECT_TRUE(near(qRgb(255, 0, 0), store.image(1, 0, 16).pixel(8, 8)));
+    EXPECT_TRUE(near(qRgb(0, 0, 255), store.image(1 + 65536, 0, 16).pixel(8, 8)));
+}
+
+TEST(ThumbnailStore, passthrough)
+{
+    const QString jpeg = TmpJpegFile::withGps();
+    ASSERT_FALSE(jpeg.isEmpty()) << TmpJpegFile::lastError();
+
+    Exif::File exif;
+    ASSERT_TRUE(exif.load(jpeg, false));
+    const Exif::Thumbnail embedded = exif.embeddedThumbnail(); // 256x192
+
+    // fits 128: stored as is
+    Exif::Orientation orientation;
+    EXPECT_EQ(embedded.jpeg, ThumbnailStore::compress(exif, 128, false, &orientation));
+    EXPECT_EQ(embedded.orientation, orientation);
+
+    // much bigger than 32: decoded and encoded small
+    const QByteArray small = ThumbnailStore::compress(exif, 32, true, &orientation);
+    EXPECT_NE(embedded.jpeg, small);
+    EXPECT_EQ(Exif::Orientation::Normal, orientation);
+
+    ThumbnailStore store;
+    store.insert(1, 0, small);
+    EXPECT_EQ(QSize(32, 32), store.image(1, 0, 32).size());
+}
+
+TEST(ThumbnailStore, pyramid)
+{
+    // every level is twice the previous one, the top one serves all the bigger sizes
+    ExifReader::thumbnailSize = 32;
+    EXPECT_EQ(0, ExifStorage::thumbnailLevel(16));
+    EXPECT_EQ(0, ExifStorage::thumbnailLevel(32));
+    EXPECT_EQ(1, ExifStorage::thumbnailLevel(33));
+    EXPECT_EQ(1, ExifStorage::thumbnailLevel(64));
+    EXPECT_EQ(2, ExifStorage::thumbnailLevel(128));
+    EXPECT_EQ(ThumbnailStore::LEVELS - 1, ExifStorage::thumbnailLevel(32 << ThumbnailStore::LEVELS));
+
+    const QString jpeg = TmpJpegFile::withGps();
+    ASSERT_FALSE(jpeg.isEmpty()) << TmpJpegFile::lastError();
+
+    Exif::File exif;
+    ASSERT_TRUE(exif.load(jpeg, false));
+
+    // the levels are built as ExifStorage does: level 0 upscaled at parse time, the others on demand
+    ThumbnailStore store;
+    Exif::Orientation orientation;
+    store.insert(1, 0, ThumbnailStore::compress(exif, 32, true, &orientation), orientation);
+
+    int previous = 0;
+    for (int level = 1; level < ThumbnailStore::LEVELS; ++level)
+    {
+        const int size = 32 << level;
+
+        // stood in for by the level below until it is built
+        bool exact = true;
+        const QImage standIn = store.image(1, level, size, &exact);
+        EXPECT_FALSE(exact);
+        ASSERT_FALSE(standIn.isNull());
+        EXPECT_GT(size, std::max(standIn.width(), standIn.height()));
+
+        const QByteArray bytes = ThumbnailStore::compress(exif, size, false, &orientation);
+        ASSERT_FALSE(bytes.isEmpty());
+        store.insert(1, level, bytes, orientation);
+        EXPECT_TRUE(store.contains(1, level));
+
+        const QImage image = store.image(1, level, size, &exact);
+        EXPECT_TRUE(exact);
+        EXPECT_GE(size, std::max(image.width(), image.height()));
+        EXPECT_LT(previous, std::max(image.width(), image.height()));
+        previous = std::max(image.width(), image.height());
+    }
+
+    // a smaller size of a level is scaled from it
+    EXPECT_GE(100, std::max(store.image(1, 2, 100).width(), store.image(1, 2, 100).height()));
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <QTemporaryDir>
+
+#include "tilepack.h"
+
+namespace
+{
+
+QByteArray tile(int i, int size = 1000)
+{
+    return QByteArray(size, static_cast<char>('a' + i % 26));
+}
+
+} // namespace
+
+TEST(TilePack, lru)
+{
+    QTemporaryDir dir;
+    TilePack pack;
+    ASSERT_TRUE(pack.open(dir.filePath("tiles.pack"), 3));
+    EXPECT_EQ(0, pack.size());
+
+    const quint64 a = TilePack::key(1, 0, 0), b = TilePack::key(1, 1, 0), c = TilePack::key(1, 0, 1), d = TilePack::key(1, 1, 1);
+    EXPECT_TRUE(pack.insert(a, tile(0)));
+    EXPECT_TRUE(pack.insert(b, tile(1)));
+    EXPECT_TRUE(pack.insert(c, tile(2)));
+    EXPECT_FALSE(pack.insert(d, QByteArray(TilePack::SLOT_SIZE + 1, 'x')));
+    EXPECT_FALSE(pack.insert(d, QByteArray()));
+
+    // a is used again, so b is the least recently used one
+    EXPECT_EQ(tile(0), pack.find(a));
+    EXPECT_TRUE(pack.insert(d, tile(3, TilePack::SLOT_SIZE)));
+    EXPECT_EQ(3, pack.size());
+    EXPECT_FALSE(pack.contains(b));
+    EXPECT_TRUE(pack.find(b).isEmpty());
+    EXPECT_EQ(tile(3, TilePack::SLOT_SIZE), pack.find(d));
+
+    // a replaced tile keeps its slot
+    EXPECT_TRUE(pack.insert(c, tile(4, 10)));
+    EXPECT_EQ(tile(4, 10), pack.find(c));
+    EXPECT_EQ(3, pack.size());
+
+    pack.remove(a);
+    EXPECT_FALSE(pack.contains(a));
+    EXPECT_TRUE(pack.insert(b, tile(1)));
+    EXPECT_EQ(3, pack.size());
+}
+
+TEST(TilePack, reopen)
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath("tiles.pack");
+    const quint64 a = TilePack::key(2, 1, 2), b = TilePack::key(2, 3, 0);
+
+    {
+        TilePack pack;
+        ASSERT_TRUE(pack.open(path, 2));
+        pack.insert(a, tile(0));
+        pack.insert(b, tile(1));
+        pack.find(a);
+    }
+
+    TilePack pack;
+    ASSERT_TRUE(pack.open(path, 2));
+    EXPECT_EQ(2, pack.size());
+
+    // the order of use is kept: b was used before a
+    pack.insert(TilePack::key(3, 0, 0), tile(2));
+    EXPECT_FALSE(pack.contains(b));
+    EXPECT_EQ(tile(0), pack.find(a));
+
+    // another layout starts empty
+    pack.close();
+    ASSERT_TRUE(pack.open(path, 4));
+    EXPECT_EQ(0, pack.size());
+    EXPECT_EQ(4, pack.capacity());
+}
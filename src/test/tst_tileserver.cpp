@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QImage>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QUrl>
+
+#include <functional>
+
+#include "clusters.h"
+#include "tileserver.h"
+
+namespace
+{
+
+const int TIMEOUT = 5000; // ms
+const int LATENCY = 300;  // ms, of the stand-in tiles
+
+/// runs the event loop of the test until \a done
+bool waitFor(const std::function<bool()>& done)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!done() && timer.elapsed() < TIMEOUT)
+        QGuiApplication::processEvents(QEventLoop::AllEvents, 10);
+    return done();
+}
+
+struct Reply
+{
+    QByteArray status;      // the status line
+    QByteArray body;
+};
+
+/// asks the \a server for the tile as the map does, and waits for the whole reply
+Reply get(const TileServer& server, int z, int x, int y)
+{
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, static_cast<quint16>(QUrl(server.url()).port()));
+    socket.write(QString("GET /%1/%2/%3.png HTTP/1.1\r\nHost: localhost\r\n\r\n").arg(z).arg(x).arg(y).toLatin1());
+
+    QByteArray response;
+    waitFor([&](){
+        response += socket.readAll();
+        return socket.state() == QAbstractSocket::UnconnectedState; });
+    response += socket.readAll();
+
+    const int body = response.indexOf("\r\n\r\n");
+    return { response.left(response.indexOf("\r\n")), body == -1 ? QByteArray() : response.mid(body + 4) };
+}
+
+/// the stand-in tiles are drawn with text, that needs a QGuiApplication
+class TileServerTest : public testing::Test
+{
+protected:
+    bool mOffscreen = qputenv("QT_QPA_PLATFORM", "offscreen");
+    int mArgc = 1;
+    char mName[5] = "test";
+    char* mArgv[2] = { mName, nullptr };
+    QGuiApplication mApp { mArgc, mArgv };
+    QTemporaryDir mDir;
+};
+
+} // namespace
+
+TEST_F(TileServerTest, priority)
+{
+    TileServer server(mDir.filePath("tiles.pack"), 64, TileServer::STAND_IN, LATENCY);
+
+    // the seed queues far more tiles than fit in the pack, the tile the map waits for still goes first
+    server.seed(QGeoRectangle(QGeoCoordinate(80, -179), QGeoCoordinate(-80, 179)), TileServer::MAX_ZOOM);
+
+    QElapsedTimer timer;
+    timer.start();
+    const Reply reply = get(server, 10, 592, 296);
+    EXPECT_EQ("HTTP/1.1 200 OK", reply.status);
+    EXPECT_LT(timer.elapsed(), 4 * LATENCY);
+
+    const QImage tile = QImage::fromData(reply.body, "PNG");
+    const int size = static_cast<int>(Mercator::TILE);
+    EXPECT_EQ(QSize(size, size), tile.size());
+}
+
+TEST_F(TileServerTest, pack)
+{
+    const QString path = mDir.filePath("tiles.pack");
+    QByteArray fetched;
+    {
+        TileServer server(path, 64, TileServer::STAND_IN);
+        const Reply reply = get(server, 3, 4, 2);
+        ASSERT_EQ("HTTP/1.1 200 OK", reply.status);
+        fetched = reply.body;
+    }
+
+    // without an upstream only the tiles of the pack are served
+    TileServer server(path, 64, QString());
+    const Reply hit = get(server, 3, 4, 2);
+    EXPECT_EQ("HTTP/1.1 200 OK", hit.status);
+    EXPECT_EQ(fetched, hit.body);
+
+    EXPECT_EQ("HTTP/1.1 404 Not Found", get(server, 3, 5, 2).status);
+    EXPECT_EQ("HTTP/1.1 404 Not Found", get(server, 30, 0, 0).status);
+}
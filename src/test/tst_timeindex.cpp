@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <numeric>
+
+#include "timeindex.h"
+
+TEST(TimeIndex, rangeAndCount)
+{
+    TimeIndex index;
+    EXPECT_TRUE(index.range().isNull());
+
+    const qint64 day = TimeIndex::DAY;
+    for (PhotoId id = 0; id < 100; ++id)
+        index.insert(id, id * day / 2); // two photos a day
+    index.insert(100, TimeIndex::INVALID_TIME);
+
+    EXPECT_EQ(100, index.size());
+    EXPECT_EQ(0, index.range().from);
+    EXPECT_EQ(99 * day / 2 + 1, index.range().to);
+
+    EXPECT_EQ(2, index.count({ 10 * day, 11 * day }));
+    EXPECT_EQ(100, index.count({}));
+
+    index.remove(21, 21 * day / 2);
+    EXPECT_EQ(1, index.count({ 10 * day, 11 * day }));
+    EXPECT_EQ(QVector<quint32>({ 20, 22, 23 }), index.select({ 10 * day, 12 * day }).values());
+
+    // before the epoch
+    index.insert(200, -3 * day);
+    EXPECT_EQ(-3 * day, index.range().from);
+    EXPECT_EQ(1, index.count({ -4 * day, 0 }));
+}
+
+TEST(TimeIndex, histogram)
+{
+    TimeIndex index;
+    const qint64 day = TimeIndex::DAY;
+    for (PhotoId id = 0; id < 3650; ++id)
+        index.insert(id, id * day + day / 2);
+
+    // bins of a year are counted with the per-day tree
+    QVector<int> years = index.histogram({ 0, 3650 * day }, 10);
+    ASSERT_EQ(10, years.size());
+    for (int count: years)
+        EXPECT_EQ(365, count);
+
+    // bins of an hour fall back to the sorted array
+    QVector<int> hours = index.histogram({ 0, day }, 24);
+    EXPECT_EQ(1, hours.at(12));
+    EXPECT_EQ(0, hours.at(11));
+
+    // the whole range ends in the middle of the last day, its photo is in the last bin
+    const Period range = index.range();
+    ASSERT_EQ(3649 * day + day / 2 + 1, range.to);
+    const QVector<int> all = index.histogram(range, 10);
+    EXPECT_EQ(index.count(range), std::accumulate(all.cbegin(), all.cend(), 0));
+    EXPECT_EQ(index.size(), std::accumulate(all.cbegin(), all.cend(), 0));
+    EXPECT_LT(0, all.last());
+}
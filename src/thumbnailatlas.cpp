@@ -0,0 +1,429 @@
+#include <QMutexLocker>
+#include <QPainter>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "exifstorage.h"
+#include "thumbnailatlas.h"
+
+constexpr int ThumbnailAtlas::PAGE_SIZE;
+constexpr int ThumbnailAtlas::MAX_PAGES;
+constexpr int ThumbnailAtlas::COALESCE_INTERVAL;
+
+namespace
+{
+
+const int CELL_SIZES[] = { 16, 32, 64 };
+
+inline quint64 cellKey(PhotoId id, int cellSize)
+{
+    return (static_cast<quint64>(id) << 8) | static_cast<quint8>(cellSize);
+}
+
+inline int cellSizeOf(quint64 key)
+{
+    return static_cast<int>(key & 0xff);
+}
+
+} // namespace
+
+ThumbnailAtlas::ThumbnailAtlas()
+{
+    mChangedTimer.setSingleShot(true);
+    mChangedTimer.setInterval(COALESCE_INTERVAL);
+    connect(&mChangedTimer, &QTimer::timeout, this, &ThumbnailAtlas::emitChanged);
+}
+
+ThumbnailAtlas* ThumbnailAtlas::instance()
+{
+    static ThumbnailAtlas atlas;
+    return &atlas;
+}
+
+int ThumbnailAtlas::cellSize(int size)
+{
+    for (int cell: CELL_SIZES)
+        if (size <= cell)
+            return cell;
+    return CELL_SIZES[std::size(CELL_SIZES) - 1];
+}
+
+ThumbnailAtlas::Handle ThumbnailAtlas::handle(PhotoId id, int size)
+{
+    if (id == INVALID_PHOTO_ID)
+        return {};
+
+    auto atlas = instance();
+    QMutexLocker lock(&atlas->mMutex);
+    return atlas->find(cellKey(id, cellSize(size)));
+}
+
+bool ThumbnailAtlas::pack(const QVector<PhotoId>& ids, int size)
+{
+    return pack(ids, size, &ExifStorage::thumbnail);
+}
+
+bool ThumbnailAtlas::pack(const QVector<PhotoId>& ids, int size, const Source& source)
+{
+    auto atlas = instance();
+    const int cell = cellSize(size);
+
+    // the cells of the batch are marked used first, the ones used since then are never evicted for the rest,
+    // so a batch bigger than the atlas leaves its tail unpacked instead of evicting its head
+    QVector<PhotoId> missing;
+    quint64 pinned = 0;
+    {
+        QMutexLocker lock(&atlas->mMutex);
+        pinned = atlas->mClock + 1;
+        for (PhotoId id: ids)
+        {
+            if (id == INVALID_PHOTO_ID)
+                continue;
+
+            auto i = atlas->mCells.find(cellKey(id, cell));
+            if (i != atlas->mCells.end())
+                i->lastUse = ++atlas->mClock;
+            else
+                missing.append(id);
+        }
+    }
+
+    if (missing.isEmpty())
+        return false;
+
+    // decode without holding the lock
+    QVector<QImage> images;
+    images.reserve(missing.size());
+    for (PhotoId id: missing)
+        images.append(source(id, std::min(size, cell)));
+
+    QMutexLocker lock(&atlas->mMutex);
+    bool packed = false;
+    for (int i = 0; i < missing.size(); ++i)
+    {
+        const quint64 key = cellKey(missing.at(i), cell);
+        if (images.at(i).isNull() || atlas->mCells.contains(key))
+            continue;
+
+        if (!atlas->pack(key, images.at(i), pinned))
+            break; // nothing left to evict
+
+        packed = true;
+    }
+
+    if (packed)
+        atlas->notify();
+
+    return packed;
+}
+
+void ThumbnailAtlas::remove(PhotoId id)
+{
+    auto atlas = instance();
+    QMutexLocker lock(&atlas->mMutex);
+
+    bool removed = false;
+    for (int cell: CELL_SIZES)
+    {
+        const quint64 key = cellKey(id, cell);
+        if (atlas->mCells.contains(key))
+        {
+            atlas->release(key);
+            atlas->compact(cell);
+            removed = true;
+        }
+    }
+
+    if (removed)
+        atlas->notify();
+}
+
+void ThumbnailAtlas::refresh(PhotoId id, int level)
+{
+    auto atlas = instance();
+
+    bool redrawn = false;
+    for (int cell: CELL_SIZES)
+    {
+        const quint64 key = cellKey(id, cell);
+        if (ExifStorage::thumbnailLevel(cell) != level)
+            continue;
+
+        {
+            QMutexLocker lock(&atlas->mMutex);
+            if (!atlas->mCells.contains(key))
+                continue;
+        }
+
+        // decode without holding the lock
+        const QImage image = ExifStorage::thumbnail(id, cell);
+        if (image.isNull())
+            continue;
+
+        QMutexLocker lock(&atlas->mMutex);
+        if (atlas->mCells.contains(key))
+        {
+            atlas->redraw(key, image);
+            redrawn = true;
+        }
+    }
+
+    if (redrawn)
+    {
+        QMutexLocker lock(&atlas->mMutex);
+        atlas->notify();
+    }
+}
+
+void ThumbnailAtlas::clear()
+{
+    auto atlas = instance();
+    QMutexLocker lock(&atlas->mMutex);
+    if (atlas->mCells.isEmpty())
+        return;
+
+    for (auto i = atlas->mCells.cbegin(); i != atlas->mCells.cend(); ++i)
+        atlas->mChanged.append(static_cast<PhotoId>(i.key() >> 8));
+
+    atlas->mCells.clear();
+    for (Page& page: atlas->mPages)
+        page = { 0, page.version + 1, 0, {}, {} };
+
+    atlas->notify();
+}
+
+QImage ThumbnailAtlas::page(int page)
+{
+    auto atlas = instance();
+    QMutexLocker lock(&atlas->mMutex);
+    return page >= 0 && page < atlas->mPages.size() ? atlas->mPages.at(page).image : QImage();
+}
+
+bool ThumbnailAtlas::paint(QPainter* painter, const QRect& target, const Handle& handle)
+{
+    auto atlas = instance();
+    QMutexLocker lock(&atlas->mMutex);
+    if (handle.page < 0 || handle.page >= atlas->mPages.size() || atlas->mPages.at(handle.page).version != handle.version)
+        return false;
+
+    painter->drawImage(target, atlas->mPages.at(handle.page).image, handle.rect);
+    return true;
+}
+
+/// the lock must be held by the caller
+ThumbnailAtlas::Handle ThumbnailAtlas::find(quint64 key) const
+{
+    auto i = mCells.constFind(key);
+    if (i == mCells.cend())
+        return {};
+
+    return { i->page, mPages.at(i->page).version, i->rect };
+}
+
+/// the lock must be held by the caller; evicts only the cells used before \a pinned
+bool ThumbnailAtlas::pack(quint64 key, const QImage& image, quint64 pinned)
+{
+    const int cell = cellSizeOf(key);
+
+    int page = -1, index = -1;
+    if (!allocate(cell, &page, &index))
+    {
+        if (!evict(cell, pinned) || !allocate(cell, &page, &index))
+            return false;
+    }
+
+    put(key, image, page, index);
+    return true;
+}
+
+/// finds a free cell in a page of the size class, takes a new page if all of them are full
+bool ThumbnailAtlas::allocate(int cellSize, int* page, int* index)
+{
+    int pages = 0, freePage = -1;
+    for (int p = 0; p < mPages.size(); ++p)
+    {
+        const Page& candidate = mPages.at(p);
+        if (candidate.cellSize == 0)
+        {
+            if (freePage < 0)
+                freePage = p;
+            continue;
+        }
+        if (candidate.cellSize != cellSize)
+            continue;
+
+        ++pages;
+        if (candidate.used < candidate.cells.size())
+        {
+            *page = p;
+            *index = static_cast<int>(std::find(candidate.cells.cbegin(), candidate.cells.cend(), 0) - candidate.cells.cbegin());
+            return true;
+        }
+    }
+
+    if (pages >= MAX_PAGES)
+        return false;
+
+    if (freePage < 0)
+    {
+        freePage = mPages.size();
+        mPages.append({});
+    }
+
+    Page& fresh = mPages[freePage];
+    fresh.cellSize = cellSize;
+    fresh.used = 0;
+    fresh.cells.fill(0, cellsPerPage(cellSize));
+    fresh.image = QImage(PAGE_SIZE, PAGE_SIZE, QImage::Format_ARGB32_Premultiplied);
+    fresh.image.fill(Qt::transparent);
+    ++fresh.version;
+
+    *page = freePage;
+    *index = 0;
+    return true;
+}
+
+/// drops the least recently used eighth of a page worth of cells of the size class,
+/// those used since \a pinned are kept
+/// \return false if there was nothing to drop
+bool ThumbnailAtlas::evict(int cellSize, quint64 pinned)
+{
+    QVector<std::pair<quint64, quint64>> cells; // (last use, key)
+    for (auto i = mCells.cbegin(); i != mCells.cend(); ++i)
+        if (cellSizeOf(i.key()) == cellSize && i->lastUse < pinned)
+            cells.append({ i->lastUse, i.key() });
+
+    if (cells.isEmpty())
+        return false;
+
+    const int count = std::min(std::max(1, cellsPerPage(cellSize) / 8), static_cast<int>(cells.size()));
+    std::nth_element(cells.begin(), cells.begin() + count - 1, cells.end());
+    for (int i = 0; i < count; ++i)
+        release(cells.at(i).second);
+
+    return true;
+}
+
+void ThumbnailAtlas::release(quint64 key)
+{
+    const Cell cell = mCells.take(key);
+    mChanged.append(static_cast<PhotoId>(key >> 8));
+
+    Page& page = mPages[cell.page];
+    page.cells[cell.index] = 0;
+
+    if (--page.used == 0)
+    {
+        page.cellSize = 0;
+        page.image = QImage();
+        page.cells.clear();
+        ++page.version;
+    }
+}
+
+/// moves the cells of the sparsest page of the size class to the free cells of the others
+/// once those are enough to hold a whole page
+void ThumbnailAtlas::compact(int cellSize)
+{
+    const int capacity = cellsPerPage(cellSize);
+
+    int freeCells = 0, sparsest = -1;
+    for (int p = 0; p < mPages.size(); ++p)
+    {
+        const Page& page = mPages.at(p);
+        if (page.cellSize != cellSize)
+            continue;
+        freeCells += capacity - page.used;
+        if (sparsest < 0 || page.used < mPages.at(sparsest).used)
+            sparsest = p;
+    }
+
+    if (sparsest < 0 || freeCells - (capacity - mPages.at(sparsest).used) < mPages.at(sparsest).used)
+        return;
+
+    const QImage source = mPages.at(sparsest).image;
+    const QVector<quint64> keys = mPages.at(sparsest).cells;
+
+    // keep the page out of allocate() while it is emptied
+    mPages[sparsest].cellSize = -1;
+    for (quint64 key: keys)
+    {
+        if (!key)
+            continue;
+
+        const QImage image = source.copy(mCells.value(key).rect);
+        release(key);
+
+        int page = -1, index = -1;
+        if (allocate(cellSize, &page, &index))
+            put(key, image, page, index);
+    }
+
+    Page& emptied = mPages[sparsest];
+    if (emptied.cellSize == -1)
+    {
+        emptied.cellSize = 0;
+        emptied.image = QImage();
+        emptied.cells.clear();
+        ++emptied.version;
+    }
+}
+
+void ThumbnailAtlas::put(quint64 key, const QImage& image, int page, int index)
+{
+    const int cell = cellSizeOf(key);
+    Page& target = mPages[page];
+
+    QRect rect(QPoint(), image.size().boundedTo(QSize(cell, cell)));
+    rect.moveCenter(QRect(origin(cell, index), QSize(cell, cell)).center());
+
+    QPainter painter(&target.image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(QRect(origin(cell, index), QSize(cell, cell)), Qt::transparent);
+    painter.drawImage(rect, image);
+    painter.end();
+
+    target.cells[index] = key;
+    ++target.used;
+    ++target.version;
+
+    mCells.insert(key, { page, index, rect, ++mClock });
+    mChanged.append(static_cast<PhotoId>(key >> 8));
+}
+
+/// the cell stays where it is, only its rect may change
+void ThumbnailAtlas::redraw(quint64 key, const QImage& image)
+{
+    const Cell cell = mCells.take(key);
+    --mPages[cell.page].used;
+    put(key, image, cell.page, cell.index);
+}
+
+/// schedules changed(); a steady stream of packed cells still gets it every COALESCE_INTERVAL
+void ThumbnailAtlas::notify()
+{
+    if (!mChangedTimer.isActive())
+        mChangedTimer.start();
+}
+
+void ThumbnailAtlas::emitChanged()
+{
+    QVector<PhotoId> ids;
+    {
+        QMutexLocker lock(&mMutex);
+        ids.swap(mChanged);
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    if (!ids.isEmpty())
+        emit changed(ids);
+}
+
+QPoint ThumbnailAtlas::origin(int cellSize, int index) const
+{
+    const int columns = PAGE_SIZE / cellSize;
+    return QPoint(index % columns * cellSize, index / columns * cellSize);
+}
@@ -0,0 +1,115 @@
+#ifndef THUMBNAILATLAS_H
+#define THUMBNAILATLAS_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+#include <functional>
+
+#include "photoid.h"
+
+/// Packs 16, 32 and 64 px thumbnails into shared square pages,
+/// so the map and the item views draw from a few big images instead of thousands of tiny ones.
+/// Every page holds cells of one size class in a fixed grid, thus allocation is O(1)
+/// and a freed cell is reused as is. The least recently used cells are evicted when
+/// a size class runs out of pages, sparse pages are compacted into the others.
+/// Looking a handle up changes nothing: the cells are packed only by pack(), which the models
+/// and views call for what they show, outside of data() and paint().
+/// The cells are filled from the thumbnails of ExifStorage's store; MarkerLayer and ThumbnailDelegate
+/// paint from handles in the GUI thread, which also packs and evicts the cells and owns the changed() timer.
+class ThumbnailAtlas : public QObject
+{
+    Q_OBJECT
+
+signals:
+    /// the cells of the \a ids were packed, moved or dropped; their handles must be requested again
+    void changed(const QVector<PhotoId>& ids);
+
+public:
+    static constexpr int PAGE_SIZE = 512;
+    static constexpr int MAX_PAGES = 16;      // per size class
+    static constexpr int COALESCE_INTERVAL = 100;
+
+    /// sub-rect of a page; goes stale when its page changes: a cell packed, moved or the page dropped
+    struct Handle
+    {
+        int page = -1;
+        int version = 0;                      // of the page when the handle was issued, paint() checks it
+        QRect rect;                           // the thumbnail inside the page, not the whole cell
+
+        bool isNull() const { return page < 0; }
+    };
+
+    /// the thumbnail of the photo not bigger than the requested size
+    using Source = std::function<QImage(PhotoId id, int size)>;
+
+    static ThumbnailAtlas* instance();
+
+    /// \return the smallest size class fitting \a size
+    static int cellSize(int size);
+
+    /// the packed photo thumbnail not bigger than \a size; null if it isn't packed
+    static Handle handle(PhotoId id, int size);
+    /// packs the thumbnails of the \a ids not packed yet, taken from ExifStorage, and marks all of them used;
+    /// only the cells of other photos are evicted for them, so what doesn't fit stays unpacked
+    /// \return whether any cell was packed
+    static bool pack(const QVector<PhotoId>& ids, int size);
+    static bool pack(const QVector<PhotoId>& ids, int size, const Source& source);
+    /// drops all the cells of the photo, e.g. when it is parsed again
+    static void remove(PhotoId id);
+    /// redraws the cells of the photo packed from a smaller stand-in of the pyramid \a level, now it is built
+    static void refresh(PhotoId id, int level);
+    /// drops all the cells
+    static void clear();
+
+    static QImage page(int page);
+    /// \return false if the \a handle is stale, nothing is drawn then
+    static bool paint(QPainter* painter, const QRect& target, const Handle& handle);
+
+private:
+    ThumbnailAtlas();
+
+    struct Page
+    {
+        int cellSize = 0;                     // 0 if the page is free
+        int version = 0;
+        int used = 0;
+        QImage image;
+        QVector<quint64> cells;               // key of every cell or 0
+    };
+
+    struct Cell
+    {
+        int page = -1;
+        int index = -1;
+        QRect rect;
+        quint64 lastUse = 0;
+    };
+
+    Handle find(quint64 key) const;
+    bool pack(quint64 key, const QImage& image, quint64 pinned);
+    bool allocate(int cellSize, int* page, int* index);
+    bool evict(int cellSize, quint64 pinned);
+    void release(quint64 key);
+    void compact(int cellSize);
+    void put(quint64 key, const QImage& image, int page, int index);
+    void redraw(quint64 key, const QImage& image);
+    void notify();
+    void emitChanged();
+    int cellsPerPage(int cellSize) const { return (PAGE_SIZE / cellSize) * (PAGE_SIZE / cellSize); }
+    QPoint origin(int cellSize, int index) const;
+
+    mutable QMutex mMutex;
+    QVector<Page> mPages;                     // indexes are stable, a free page is reused
+    QHash<quint64, Cell> mCells;              // (id, size class) -> cell
+    quint64 mClock = 0;                       // of the last use
+    QVector<PhotoId> mChanged;                // since the last changed()
+
+    QTimer mChangedTimer;                     // coalesces changed() for the GUI thread
+};
+
+#endif // THUMBNAILATLAS_H
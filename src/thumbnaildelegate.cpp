@@ -0,0 +1,95 @@
+#include <QAbstractItemView>
+#include <QApplication>
+#include <QPainter>
+#include <QStyle>
+#include <QTimer>
+#include <QtMath>
+
+#include <algorithm>
+
+#include "exifstorage.h"
+#include "model.h"
+#include "thumbnailatlas.h"
+#include "thumbnaildelegate.h"
+
+ThumbnailDelegate::ThumbnailDelegate(QObject* parent) : Super(parent)
+{
+    connect(ThumbnailAtlas::instance(), &ThumbnailAtlas::changed, this, [this](const QVector<PhotoId>& ids){
+        if (mViewport && std::any_of(ids.cbegin(), ids.cend(), [this](PhotoId id){ return mShown.contains(id); }))
+            mViewport->update();
+    });
+}
+
+void ThumbnailDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    QStyleOptionViewItem opt = option;
+    initStyleOption(&opt, index);
+
+    const QWidget* widget = opt.widget;
+    QStyle* style = widget ? widget->style() : QApplication::style();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+
+    const PhotoId id = IFileListModel::id(index);
+    const QSize size = opt.decorationSize;
+    if (id == INVALID_PHOTO_ID || !(opt.features & QStyleOptionViewItem::HasDecoration) || !opt.icon.isNull())
+        return;
+
+    // in device pixels, so the pyramid level is sharp on high DPI screens
+    const int pixels = qCeil(std::max(size.width(), size.height()) * painter->device()->devicePixelRatioF());
+    const QPoint center = style->subElementRect(QStyle::SE_ItemViewItemDecoration, &opt, widget).center();
+
+    if (pixels > ThumbnailAtlas::cellSize(pixels))
+    {
+        // big icons are few on the screen, they are drawn from the decoded cache directly
+        const QImage image = ExifStorage::thumbnail(id, pixels);
+        QRect target(QPoint(), image.size().scaled(size, Qt::KeepAspectRatio));
+        target.moveCenter(center);
+        painter->drawImage(target, image);
+        return;
+    }
+
+    schedule(id, pixels, widget);
+
+    const ThumbnailAtlas::Handle handle = ThumbnailAtlas::handle(id, pixels);
+    if (handle.isNull())
+        return;
+
+    QRect target(QPoint(), handle.rect.size().scaled(size, Qt::KeepAspectRatio));
+    target.moveCenter(center);
+    ThumbnailAtlas::paint(painter, target, handle);
+}
+
+/// leaves the decoration place empty for the photos having a thumbnail, paint() fills it from the atlas
+void ThumbnailDelegate::initStyleOption(QStyleOptionViewItem* option, const QModelIndex& index) const
+{
+    Super::initStyleOption(option, index);
+    if (ExifStorage::hasThumbnail(IFileListModel::id(index)))
+    {
+        option->icon = QIcon();
+        option->features |= QStyleOptionViewItem::HasDecoration;
+    }
+}
+
+/// collects the photos of a paint, packed or not, so the packed ones are marked used too
+void ThumbnailDelegate::schedule(PhotoId id, int pixels, const QWidget* widget) const
+{
+    if (mPainted.isEmpty())
+        QTimer::singleShot(0, this, [this](){ packPainted(); });
+
+    mPainted[pixels].append(id);
+    if (auto view = qobject_cast<const QAbstractItemView*>(widget))
+        mViewport = view->viewport();
+}
+
+/// changed() repaints the view for the photos packed now, the ones packed already are drawn
+void ThumbnailDelegate::packPainted() const
+{
+    mShown.clear();
+    for (auto i = mPainted.cbegin(); i != mPainted.cend(); ++i)
+    {
+        ThumbnailAtlas::pack(i.value(), i.key());
+        for (PhotoId id: i.value())
+            mShown.insert(id);
+    }
+    mPainted.clear();
+}
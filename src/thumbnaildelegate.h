@@ -0,0 +1,37 @@
+#ifndef THUMBNAILDELEGATE_H
+#define THUMBNAILDELEGATE_H
+
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+#include <QStyledItemDelegate>
+#include <QVector>
+
+#include "photoid.h"
+
+/// draws the photo thumbnails of an item view from the atlas,
+/// other decorations are drawn by QStyledItemDelegate as usual;
+/// the photos painted are packed once the view is painted, and the view is repainted
+/// when the atlas cells of any of them change
+class ThumbnailDelegate : public QStyledItemDelegate
+{
+    using Super = QStyledItemDelegate;
+
+public:
+    explicit ThumbnailDelegate(QObject* parent = nullptr);
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+protected:
+    void initStyleOption(QStyleOptionViewItem* option, const QModelIndex& index) const override;
+
+private:
+    void schedule(PhotoId id, int pixels, const QWidget* widget) const;
+    void packPainted() const;
+
+    mutable QHash<int, QVector<PhotoId>> mPainted;  // by size, since the last packPainted()
+    mutable QSet<PhotoId> mShown;                   // painted before the last packPainted()
+    mutable QPointer<QWidget> mViewport;
+};
+
+#endif // THUMBNAILDELEGATE_H
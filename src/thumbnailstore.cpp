@@ -0,0 +1,200 @@
+#include <QBuffer>
+#include <QImageReader>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+#include "pics.h"
+#include "thumbnailstore.h"
+
+constexpr int ThumbnailStore::DEFAULT_CACHE_KB;
+constexpr int ThumbnailStore::LEVELS;
+
+namespace
+{
+
+const char* FORMAT = "JPEG";
+const int QUALITY = 80;
+
+inline quint64 cacheKey(PhotoId id, int size)
+{
+    return (static_cast<quint64>(id) << 16) | static_cast<quint16>(size);
+}
+
+} // namespace
+
+ThumbnailStore::ThumbnailStore(int cacheKb) : mCache(cacheKb)
+{
+
+}
+
+QByteArray ThumbnailStore::compress(const QImage& image)
+{
+    QByteArray bytes;
+    if (image.isNull())
+        return bytes;
+
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, FORMAT, QUALITY);
+    return bytes;
+}
+
+/// an embedded thumbnail fits when it needs no upscaling and is less than twice the size,
+/// so it is stored without a decode and an encode, and it costs about as much as an encoded one
+QByteArray ThumbnailStore::compress(const Exif::File& exif, int size, bool upscale, Exif::Orientation* orientation)
+{
+    const Exif::Thumbnail embedded = exif.embeddedThumbnail();
+    const int side = std::min(embedded.size.width(), embedded.size.height());
+    if (!embedded.isNull() && embedded.size.isValid() && side >= size && side < 2 * size)
+    {
+        *orientation = embedded.orientation;
+        return QByteArray(embedded.jpeg.constData(), embedded.jpeg.size()); // out of the EXIF data
+    }
+
+    *orientation = Exif::Orientation::Normal;
+    return compress(exif.thumbnail(size, size, upscale));
+}
+
+void ThumbnailStore::insert(PhotoId id, int level, const QByteArray& compressed, Exif::Orientation orientation)
+{
+    if (id == INVALID_PHOTO_ID || level < 0 || level >= LEVELS || compressed.isEmpty())
+        return;
+
+    QMutexLocker lock(&mMutex);
+
+    const int first = static_cast<int>(id) * LEVELS;
+    if (mSlices.size() < first + LEVELS)
+        mSlices.resize(first + LEVELS);
+
+    // the decoded images are either stale or made from a lower level; a new photo has none
+    if (std::any_of(mSlices.cbegin() + first, mSlices.cbegin() + first + LEVELS, [](const Slice& slice){ return slice.size; }))
+        uncache(id);
+
+    if (level == 0)
+        for (int i = first; i < first + LEVELS; ++i)
+            drop(i);
+    else
+        drop(first + level);
+
+    Slice& slice = mSlices[first + level];
+    slice.offset = static_cast<quint32>(mArena.size());
+    slice.size = static_cast<quint32>(compressed.size());
+    slice.orientation = orientation;
+    mArena.append(compressed);
+
+    if (mGarbage > mArena.size() / 2)
+        compact();
+}
+
+bool ThumbnailStore::contains(PhotoId id, int level) const
+{
+    QMutexLocker lock(&mMutex);
+    const int i = static_cast<int>(id) * LEVELS + level;
+    return i < mSlices.size() && mSlices.at(i).size;
+}
+
+QByteArray ThumbnailStore::compressed(PhotoId id, int level) const
+{
+    QMutexLocker lock(&mMutex);
+    const int i = static_cast<int>(id) * LEVELS + level;
+    if (i >= mSlices.size())
+        return {};
+
+    const Slice& slice = mSlices.at(i);
+    return mArena.mid(static_cast<int>(slice.offset), static_cast<int>(slice.size));
+}
+
+QImage ThumbnailStore::image(PhotoId id, int level, int size, bool* exact)
+{
+    const quint64 key = cacheKey(id, size);
+    level = std::max(0, std::min(level, LEVELS - 1));
+
+    QByteArray bytes;
+    Exif::Orientation orientation;
+    {
+        QMutexLocker lock(&mMutex);
+
+        const int first = static_cast<int>(id) * LEVELS;
+        int found = level;
+        while (found >= 0 && (first + found >= mSlices.size() || !mSlices.at(first + found).size))
+            --found;
+
+        if (exact)
+            *exact = found == level;
+
+        if (auto cached = mCache.object(key))
+            return *cached;
+
+        if (found < 0)
+            return {};
+
+        const Slice& slice = mSlices.at(first + found);
+        bytes = mArena.mid(static_cast<int>(slice.offset), static_cast<int>(slice.size));
+        orientation = slice.orientation;
+    }
+
+    // decode without holding the lock, at a DCT scale for a passed through embedded thumbnail
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer, FORMAT);
+
+    const QSize stored = reader.size();
+    int side = std::min(stored.width(), stored.height());
+    if (size > 0 && (side <= 0 || size < side))
+        side = size;
+
+    const QImage image = Pics::fromImageReader(&reader, side, side, orientation);
+    if (image.isNull())
+        return image;
+
+    QMutexLocker lock(&mMutex);
+    mCache.insert(key, new QImage(image), std::max(1, image.width() * image.height() * image.depth() / 8 / 1024));
+    return image;
+}
+
+int ThumbnailStore::arenaSize() const
+{
+    QMutexLocker lock(&mMutex);
+    return mArena.size();
+}
+
+int ThumbnailStore::cacheCost() const
+{
+    QMutexLocker lock(&mMutex);
+    return mCache.totalCost();
+}
+
+/// drops the bytes of replaced thumbnails; the lock must be held by the caller
+void ThumbnailStore::compact()
+{
+    QByteArray arena;
+    arena.reserve(static_cast<int>(mArena.size() - mGarbage));
+
+    for (Slice& slice: mSlices)
+    {
+        if (!slice.size)
+            continue;
+        const quint32 offset = static_cast<quint32>(arena.size());
+        arena.append(mArena.constData() + slice.offset, static_cast<int>(slice.size));
+        slice.offset = offset;
+    }
+
+    mArena.swap(arena);
+    mGarbage = 0;
+}
+
+/// the lock must be held by the caller
+void ThumbnailStore::drop(int slice)
+{
+    mGarbage += mSlices.at(slice).size;
+    mSlices[slice] = {};
+}
+
+/// the lock must be held by the caller
+void ThumbnailStore::uncache(PhotoId id)
+{
+    for (auto key: mCache.keys())
+        if (static_cast<PhotoId>(key >> 16) == id)
+            mCache.remove(key);
+}
@@ -0,0 +1,68 @@
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QVector>
+
+#include "exif/file.h"
+#include "photoid.h"
+
+/// Thumbnails of all the photos, each stored once as small JPEG bytes in one contiguous arena,
+/// plus a bounded LRU of the decoded images for the sizes the views ask for.
+/// Every photo has a pyramid of LEVELS thumbnails, each level twice the size of the previous one;
+/// level 0 comes with the photo metadata, the others are added on demand.
+/// Thread safe: the metadata reader and the pyramid builder insert, the GUI thread decodes for the views and the atlas.
+class ThumbnailStore
+{
+public:
+    static constexpr int DEFAULT_CACHE_KB = 16 * 1024;
+    static constexpr int LEVELS = 4;
+
+    explicit ThumbnailStore(int cacheKb = DEFAULT_CACHE_KB);
+
+    /// encodes an image to the stored form; called by the metadata reader and the pyramid builder threads
+    static QByteArray compress(const QImage& image);
+    /// the stored form of the \a exif thumbnail for \a size x \a size: the embedded JPEG as is when it fits the size,
+    /// otherwise File::thumbnail() encoded; \a orientation receives what is to be applied after decoding
+    static QByteArray compress(const Exif::File& exif, int size, bool upscale, Exif::Orientation* orientation);
+
+    /// a new level 0 means the photo is parsed again, so the other levels are dropped;
+    /// the stored picture is cropped to a square and oriented when it is decoded
+    void insert(PhotoId id, int level, const QByteArray& compressed, Exif::Orientation orientation = Exif::Orientation::Normal);
+    bool contains(PhotoId id, int level = 0) const;
+
+    /// \return the stored bytes, copied out of the arena
+    QByteArray compressed(PhotoId id, int level = 0) const;
+
+    /// \return the image of the \a level not bigger than \a size x \a size, decoded or taken from the cache;
+    /// the highest level below is used while the \a level is missing, then \a exact is set to false
+    QImage image(PhotoId id, int level, int size, bool* exact = nullptr);
+
+    /// bytes used by the arena (including garbage not compacted yet)
+    int arenaSize() const;
+    /// KB of the decoded images kept, at most the cache size given to the constructor
+    int cacheCost() const;
+
+private:
+    struct Slice
+    {
+        quint32 offset = 0;
+        quint32 size = 0;
+        quint16 orientation = Exif::Orientation::Normal;
+    };
+
+    void compact();
+    void drop(int slice);
+    void uncache(PhotoId id);
+
+    mutable QMutex mMutex;
+    QByteArray mArena;
+    QVector<Slice> mSlices;        // indexed by PhotoId * LEVELS + level
+    qint64 mGarbage = 0;           // bytes of replaced thumbnails
+    QCache<quint64, QImage> mCache; // (id, size) -> decoded image, cost in KB
+};
+
+#endif // THUMBNAILSTORE_H
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cstring>
+
+#include "tilepack.h"
+
+constexpr int TilePack::SLOT_SIZE;
+constexpr quint32 TilePack::MAGIC;
+constexpr quint32 TilePack::VERSION;
+
+namespace
+{
+
+const qint64 HEADER_SIZE = 64;
+const qint64 PAGE = 4096;
+
+} // namespace
+
+quint64 TilePack::key(int z, int x, int y)
+{
+    return (static_cast<quint64>(z) << 48) | (static_cast<quint64>(y) << 24) | static_cast<quint64>(x);
+}
+
+TilePack::~TilePack()
+{
+    close();
+}
+
+bool TilePack::open(const QString& path, int slots)
+{
+    close();
+
+    mFile.setFileName(path);
+    if (slots <= 0 || !mFile.open(QIODevice::ReadWrite))
+        return false;
+
+    const qint64 size = dataOffset(slots) + static_cast<qint64>(slots) * SLOT_SIZE;
+
+    Header header = {};
+    const bool valid = mFile.size() == size && mFile.read(reinterpret_cast<char*>(&header), sizeof(header)) == sizeof(header)
+            && header.magic == MAGIC && header.version == VERSION
+            && header.slots == static_cast<quint32>(slots) && header.slotSize == static_cast<quint32>(SLOT_SIZE);
+
+    if (!valid && !(mFile.resize(0) && mFile.resize(size)))
+    {
+        mFile.close();
+        return false;
+    }
+
+    mMap = mFile.map(0, size);
+    if (!mMap)
+    {
+        mFile.close();
+        return false;
+    }
+    mSlots = slots;
+
+    if (!valid)
+    {
+        // resize() zero-filled the table: all the slots are free
+        header = { MAGIC, VERSION, static_cast<quint32>(slots), static_cast<quint32>(SLOT_SIZE) };
+        std::memcpy(mMap, &header, sizeof(header));
+    }
+
+    for (int slot = 0; slot < mSlots; ++slot)
+    {
+        const Record* r = record(slot);
+        if (r->size == 0 || r->size > static_cast<quint32>(SLOT_SIZE) || mSlotOf.contains(r->key))
+        {
+            record(slot)->size = 0;
+            mFree.append(slot);
+            continue;
+        }
+
+        mSlotOf.insert(r->key, slot);
+        mClock = std::max(mClock, r->use);
+    }
+
+    // uses are unique when written, but an older pack may repeat them
+    QVector<int> used = mSlotOf.values().toVector();
+    std::sort(used.begin(), used.end(), [this](int a, int b){ return record(a)->use < record(b)->use; });
+    for (int slot: used)
+    {
+        record(slot)->use = ++mClock;
+        mByUse.insert(mClock, slot);
+    }
+
+    // the first free slots are taken first
+    std::reverse(mFree.begin(), mFree.end());
+    return true;
+}
+
+void TilePack::close()
+{
+    if (mMap)
+        mFile.unmap(mMap);
+    mMap = nullptr;
+    mFile.close();
+
+    mSlots = 0;
+    mSlotOf.clear();
+    mByUse.clear();
+    mFree.clear();
+    mClock = 0;
+}
+
+QByteArray TilePack::find(quint64 key)
+{
+    const int slot = mSlotOf.value(key, -1);
+    if (slot == -1)
+        return {};
+
+    touch(slot);
+    return QByteArray(reinterpret_cast<const char*>(data(slot)), static_cast<int>(record(slot)->size));
+}
+
+bool TilePack::insert(quint64 key, const QByteArray& bytes)
+{
+    if (!mMap || bytes.isEmpty() || bytes.size() > SLOT_SIZE)
+        return false;
+
+    int slot = mSlotOf.value(key, -1);
+    if (slot == -1)
+    {
+        if (!mFree.isEmpty())
+        {
+            slot = mFree.takeLast();
+        }
+        else
+        {
+            // the least recently used
+            slot = mByUse.first();
+            mByUse.erase(mByUse.begin());
+            mSlotOf.remove(record(slot)->key);
+            record(slot)->size = 0;
+        }
+        mSlotOf.insert(key, slot);
+    }
+    else
+    {
+        mByUse.remove(record(slot)->use);
+    }
+
+    // the data first, so a torn write leaves a free slot rather than a broken tile
+    Record* r = record(slot);
+    r->size = 0;
+    std::memcpy(data(slot), bytes.constData(), static_cast<size_t>(bytes.size()));
+    r->key = key;
+    r->use = ++mClock;
+    r->size = static_cast<quint32>(bytes.size());
+    mByUse.insert(r->use, slot);
+    return true;
+}
+
+void TilePack::remove(quint64 key)
+{
+    const int slot = mSlotOf.value(key, -1);
+    if (slot == -1)
+        return;
+
+    mSlotOf.remove(key);
+    mByUse.remove(record(slot)->use);
+    record(slot)->size = 0;
+    mFree.append(slot);
+}
+
+/// the slots start at a page boundary after the table
+qint64 TilePack::dataOffset(int slots)
+{
+    const qint64 table = HEADER_SIZE + static_cast<qint64>(slots) * static_cast<qint64>(sizeof(Record));
+    return (table + PAGE - 1) / PAGE * PAGE;
+}
+
+TilePack::Record* TilePack::record(int slot) const
+{
+    return reinterpret_cast<Record*>(mMap + HEADER_SIZE) + slot;
+}
+
+uchar* TilePack::data(int slot) const
+{
+    return mMap + dataOffset(mSlots) + static_cast<qint64>(slot) * SLOT_SIZE;
+}
+
+void TilePack::touch(int slot)
+{
+    Record* r = record(slot);
+    mByUse.remove(r->use);
+    r->use = ++mClock;
+    mByUse.insert(r->use, slot);
+}
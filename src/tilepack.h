@@ -0,0 +1,77 @@
+#ifndef TILEPACK_H
+#define TILEPACK_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QVector>
+
+/// Map tiles in a single memory mapped file of fixed SLOT_SIZE slots, the least recently used one is reused when full.
+/// The file starts with a header and a table of slot records (key, size, last use), then the slots;
+/// everything is read and written through the mapping, so the pack survives restarts without an index file
+/// and a lookup is a hash probe and a memcpy. Tiles bigger than a slot are not kept.
+class TilePack
+{
+public:
+    static constexpr int SLOT_SIZE = 64 * 1024;
+    static constexpr quint32 MAGIC = 0x4b505447; // "GTPK"
+    static constexpr quint32 VERSION = 1;
+
+    /// the tile (\a x, \a y) of the zoom \a z
+    static quint64 key(int z, int x, int y);
+
+    TilePack() = default;
+    TilePack(const TilePack&) = delete;
+    TilePack& operator =(const TilePack&) = delete;
+    ~TilePack();
+
+    /// opens the pack at \a path, or creates it for \a slots tiles; a pack of another layout is emptied
+    bool open(const QString& path, int slots);
+    void close();
+    bool isOpen() const { return mMap != nullptr; }
+
+    int size() const { return mSlotOf.size(); }
+    int capacity() const { return mSlots; }
+
+    bool contains(quint64 key) const { return mSlotOf.contains(key); }
+    /// \return the tile, empty if there is no such one; it becomes the most recently used
+    QByteArray find(quint64 key);
+    /// stores the tile in a free slot or in the least recently used one; false if it is empty or too big
+    bool insert(quint64 key, const QByteArray& data);
+    void remove(quint64 key);
+
+private:
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        quint32 slots;
+        quint32 slotSize;
+    };
+
+    struct Record
+    {
+        quint64 key;
+        quint64 use;                    // the clock when last used
+        quint32 size;                   // 0 if the slot is free
+        quint32 reserved;
+    };
+
+    static qint64 dataOffset(int slots);
+
+    Record* record(int slot) const;
+    uchar* data(int slot) const;
+    void touch(int slot);
+
+    QFile mFile;
+    uchar* mMap = nullptr;
+    int mSlots = 0;
+
+    QHash<quint64, int> mSlotOf;        // key -> slot
+    QMap<quint64, int> mByUse;          // last use -> slot, the first one is evicted
+    QVector<int> mFree;
+    quint64 mClock = 0;
+};
+
+#endif // TILEPACK_H
@@ -0,0 +1,298 @@
+#include <QBuffer>
+#include <QImage>
+#include <QNetworkReply>
+#include <QPainter>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <algorithm>
+#include <cmath>
+
+#include "clusters.h"
+#include "tileserver.h"
+
+constexpr int TileServer::MAX_REQUESTS;
+constexpr int TileServer::MAX_ZOOM;
+constexpr int TileServer::PATH_STEPS;
+constexpr int TileServer::SEED_LIMIT;
+constexpr int TileServer::SETTLE_MS;
+constexpr const char* TileServer::STAND_IN;
+constexpr const char* TileServer::OSM;
+
+namespace
+{
+
+const int PREFETCH_LIMIT = 512;     // tiles
+
+int zoomOf(quint64 key) { return static_cast<int>(key >> 48); }
+int yOf(quint64 key) { return static_cast<int>((key >> 24) & 0xffffff); }
+int xOf(quint64 key) { return static_cast<int>(key & 0xffffff); }
+
+} // namespace
+
+TileServer::TileServer(const QString& packPath, int packSlots, const QString& upstream, int latency, bool prefetch)
+    : mUpstream(upstream), mLatency(latency), mPrefetching(prefetch)
+{
+    // without the pack every tile is fetched, but the map still works
+    mPack.open(packPath, packSlots);
+
+    connect(&mServer, &QTcpServer::newConnection, this, [this](){
+        while (QTcpSocket* socket = mServer.nextPendingConnection())
+        {
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket](){ readRequest(socket); });
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        }
+    });
+    mServer.listen(QHostAddress::LocalHost);
+
+    // the map reports its region on every frame of a drag
+    mSettle.setSingleShot(true);
+    mSettle.setInterval(SETTLE_MS);
+    connect(&mSettle, &QTimer::timeout, this, &TileServer::settled);
+}
+
+QString TileServer::url() const
+{
+    return QString("http://127.0.0.1:%1/").arg(mServer.serverPort());
+}
+
+void TileServer::prefetchPath(const QGeoCoordinate& from, qreal fromZoom, const QGeoCoordinate& to, qreal toZoom, const QSizeF& viewport)
+{
+    if (!mPrefetching)
+        return;
+
+    mSettle.stop();
+    const QPointF a = Mercator::project({ from.latitude(), from.longitude() });
+    const QPointF b = Mercator::project({ to.latitude(), to.longitude() });
+
+    // the blank tiles at the end are seen the longest, those go first
+    QVector<Range> ranges = { range(b, toZoom, viewport) };
+    for (int i = 0; i < PATH_STEPS; ++i)
+    {
+        const qreal t = 1.0 * i / PATH_STEPS;
+        ranges.append(range(a + (b - a) * t, fromZoom + (toZoom - fromZoom) * t, viewport));
+    }
+
+    mPrefetch.clear();
+    enqueue(ranges, PREFETCH_LIMIT, mPrefetch);
+    next();
+}
+
+void TileServer::prefetchRegion(const QGeoRectangle& region, qreal zoom)
+{
+    if (!mPrefetching || !region.isValid())
+        return;
+
+    mRegion = region;
+    mZoom = zoom;
+    mSettle.start();
+}
+
+void TileServer::settled()
+{
+    // zooming in and out shows the tiles of the next levels
+    const int z = std::max(0, std::min(static_cast<int>(std::floor(mZoom)), MAX_ZOOM));
+    QVector<Range> ranges = { range(mRegion, z, 1) };
+    if (z < MAX_ZOOM)
+        ranges.append(range(mRegion, z + 1, 0));
+    if (z > 0)
+        ranges.append(range(mRegion, z - 1, 1));
+
+    mPrefetch.clear();
+    enqueue(ranges, PREFETCH_LIMIT, mPrefetch);
+    next();
+}
+
+void TileServer::seed(const QGeoRectangle& area, int maxZoom)
+{
+    if (!area.isValid())
+        return;
+
+    QVector<Range> ranges;
+    for (int z = 0; z <= std::min(maxZoom, MAX_ZOOM); ++z)
+        ranges.append(range(area, z, 0));
+
+    mSeed.clear();
+    enqueue(ranges, SEED_LIMIT, mSeed);
+    next();
+}
+
+/// the tiles of a \a viewport centered at the \a center point of zoom 0 pixels, as the map shows them at the \a zoom
+TileServer::Range TileServer::range(const QPointF& center, qreal zoom, const QSizeF& viewport)
+{
+    const int z = std::max(0, std::min(static_cast<int>(std::floor(zoom)), MAX_ZOOM));
+    const qreal tile = Mercator::TILE * Mercator::scale(zoom - z);     // on the screen
+    const QPointF c = center * Mercator::scale(z) / Mercator::TILE;    // in tiles
+    const qreal w = viewport.width() / tile / 2, h = viewport.height() / tile / 2;
+
+    return { z, static_cast<int>(std::floor(c.x() - w)), static_cast<int>(std::floor(c.y() - h)),
+                static_cast<int>(std::floor(c.x() + w)), static_cast<int>(std::floor(c.y() + h)) };
+}
+
+TileServer::Range TileServer::range(const QGeoRectangle& region, int zoom, int margin)
+{
+    const QGeoCoordinate topLeft = region.topLeft(), bottomRight = region.bottomRight();
+    const QPointF from = Mercator::project({ topLeft.latitude(), topLeft.longitude() });
+    QPointF to = Mercator::project({ bottomRight.latitude(), bottomRight.longitude() });
+    if (to.x() < from.x())
+        to.rx() += Mercator::TILE; // crossing the antimeridian
+
+    const qreal f = Mercator::scale(zoom) / Mercator::TILE;
+    return { zoom, static_cast<int>(std::floor(from.x() * f)) - margin, static_cast<int>(std::floor(from.y() * f)) - margin,
+                   static_cast<int>(std::floor(to.x() * f)) + margin, static_cast<int>(std::floor(to.y() * f)) + margin };
+}
+
+/// answers GET /<z>/<x>/<y>.png; a request is small, so it is handled once it has come whole
+void TileServer::readRequest(QTcpSocket* socket)
+{
+    const QByteArray head = socket->peek(socket->bytesAvailable());
+    if (!head.contains("\r\n\r\n"))
+        return;
+    socket->readAll();
+
+    const QList<QByteArray> line = head.left(head.indexOf("\r\n")).split(' ');
+    QList<QByteArray> path = line.value(1).split('/');
+    path.removeAll({});
+
+    bool okZ = false, okX = false, okY = false;
+    const int z = path.value(0).toInt(&okZ);
+    const int x = path.value(1).toInt(&okX);
+    const int y = path.value(2).split('.').value(0).toInt(&okY);
+    const int n = 1 << std::max(0, std::min(z, MAX_ZOOM));
+
+    if (line.value(0) != "GET" || path.size() != 3 || !okZ || !okX || !okY || z < 0 || z > MAX_ZOOM || x < 0 || x >= n || y < 0 || y >= n)
+    {
+        reply(socket, {});
+        return;
+    }
+
+    const quint64 key = TilePack::key(z, x, y);
+    const QByteArray tile = mPack.find(key);
+    if (!tile.isEmpty())
+    {
+        reply(socket, tile);
+        return;
+    }
+
+    // a tile waited for already is queued or being fetched
+    QVector<QPointer<QTcpSocket>>& waiting = mWaiting[key];
+    waiting.append(socket);
+    if (waiting.size() == 1)
+        request(key);
+}
+
+void TileServer::reply(QTcpSocket* socket, const QByteArray& tile)
+{
+    if (!socket || socket->state() != QAbstractSocket::ConnectedState)
+        return;
+
+    const QByteArray status = tile.isEmpty() ? "404 Not Found" : "200 OK";
+    socket->write("HTTP/1.1 " + status + "\r\nContent-Type: image/png\r\nContent-Length: " + QByteArray::number(tile.size()) +
+                  "\r\nConnection: close\r\n\r\n");
+    socket->write(tile);
+    socket->disconnectFromHost();
+}
+
+/// queues the tiles of the \a ranges missing from the pack, up to \a limit of them
+void TileServer::enqueue(const QVector<Range>& ranges, int limit, QQueue<quint64>& queue)
+{
+    QSet<quint64> queued;
+    for (const Range& r: ranges)
+    {
+        const int n = 1 << r.zoom;
+        const int x1 = std::min(r.x1, r.x0 + n - 1); // the whole world at most
+        for (int y = std::max(0, r.y0); y <= std::min(r.y1, n - 1); ++y)
+        {
+            for (int x = r.x0; x <= x1; ++x)
+            {
+                const quint64 key = TilePack::key(r.zoom, (x % n + n) % n, y);
+                if (mPack.contains(key) || mFetching.contains(key) || queued.contains(key))
+                    continue;
+
+                queued.insert(key);
+                queue.enqueue(key);
+                if (queue.size() >= limit)
+                    return;
+            }
+        }
+    }
+}
+
+/// the map waits for the tile; if it is prefetched or seeded too, it is skipped there later
+void TileServer::request(quint64 key)
+{
+    if (mFetching.contains(key))
+        return;
+
+    mUrgent.enqueue(key);
+    next();
+}
+
+/// starts the queued fetches: the ones the map waits for, then the prefetched, then the seeded
+void TileServer::next()
+{
+    while (mFetching.size() < MAX_REQUESTS)
+    {
+        QQueue<quint64>& queue = !mUrgent.isEmpty() ? mUrgent : !mPrefetch.isEmpty() ? mPrefetch : mSeed;
+        if (queue.isEmpty())
+            return;
+
+        const quint64 key = queue.dequeue();
+        if (mPack.contains(key) || mFetching.contains(key))
+            continue;
+
+        mFetching.insert(key);
+
+        if (mUpstream == STAND_IN)
+        {
+            QTimer::singleShot(mLatency, this, [this, key](){ fetched(key, standIn(key)); });
+            continue;
+        }
+
+        QString url = mUpstream;
+        url.replace("%z", QString::number(zoomOf(key))).replace("%x", QString::number(xOf(key))).replace("%y", QString::number(yOf(key)));
+
+        // the tile usage policy of OpenStreetMap asks for an identifying user agent
+        QNetworkRequest get{ QUrl(url) };
+        get.setHeader(QNetworkRequest::UserAgentHeader, "geoviever");
+        get.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+
+        QNetworkReply* reply = mNetwork.get(get);
+        connect(reply, &QNetworkReply::finished, this, [this, key, reply](){
+            reply->deleteLater();
+            fetched(key, reply->error() == QNetworkReply::NoError ? reply->readAll() : QByteArray());
+        });
+    }
+}
+
+void TileServer::fetched(quint64 key, const QByteArray& tile)
+{
+    mFetching.remove(key);
+    mPack.insert(key, tile);
+
+    for (const QPointer<QTcpSocket>& socket: mWaiting.take(key))
+        reply(socket, tile);
+
+    next();
+}
+
+/// a tile telling its coordinates
+QByteArray TileServer::standIn(quint64 key) const
+{
+    const int z = zoomOf(key);
+    const int size = static_cast<int>(Mercator::TILE);
+    QImage image(size, size, QImage::Format_RGB32);
+    image.fill(QColor::fromHsv(z * 360 / (MAX_ZOOM + 1), 24, 250));
+
+    QPainter painter(&image);
+    painter.setPen(Qt::gray);
+    painter.drawRect(image.rect().adjusted(0, 0, -1, -1));
+    painter.drawText(image.rect(), Qt::AlignCenter, QString("%1/%2/%3").arg(z).arg(xOf(key)).arg(yOf(key)));
+    painter.end();
+
+    QByteArray bytes;
+    QBuffer buffer(&bytes);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+    return bytes;
+}
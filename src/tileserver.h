@@ -0,0 +1,97 @@
+#ifndef TILESERVER_H
+#define TILESERVER_H
+
+#include <QGeoCoordinate>
+#include <QGeoRectangle>
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QPointF>
+#include <QPointer>
+#include <QQueue>
+#include <QSet>
+#include <QSizeF>
+#include <QTcpServer>
+#include <QTimer>
+#include <QVector>
+
+#include "tilepack.h"
+
+class QNetworkReply;
+class QTcpSocket;
+
+/// Local HTTP server of map tiles for the osm plugin (as its osm.mapping.custom.host), backed by a TilePack.
+/// A tile missing from the pack is fetched from the upstream, a URL template with %z, %x and %y;
+/// with the STAND_IN upstream the tiles are drawn locally instead, so the map works and can be measured offline.
+/// Besides the tiles the map asks for, the ones along an animation path, around the viewport once the map
+/// settles and in a seeded area may be fetched ahead; a newer prefetch replaces the queued older one,
+/// and the tiles the map waits for always go first. The tile usage policy of OpenStreetMap discourages
+/// fetching ahead, so the prefetch is opt-in and the seed is limited to SEED_LIMIT tiles.
+class TileServer : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QString url READ url CONSTANT)
+
+public:
+    static constexpr int MAX_REQUESTS = 4;      // to the upstream at once
+    static constexpr int MAX_ZOOM = 19;
+    static constexpr int PATH_STEPS = 16;
+    static constexpr int SEED_LIMIT = 4096;     // tiles
+    static constexpr int SETTLE_MS = 250;       // without a region change, before its prefetch
+    static constexpr const char* STAND_IN = "stand-in";
+    static constexpr const char* OSM = "https://tile.openstreetmap.org/%z/%x/%y.png";
+
+    /// \a latency delays the stand-in tiles, in ms, to mimic a network;
+    /// without \a prefetch only the tiles the map asks for and the seeded ones are fetched
+    TileServer(const QString& packPath, int packSlots, const QString& upstream, int latency = 0, bool prefetch = false);
+
+    /// http://127.0.0.1:<port>/ serving <z>/<x>/<y>.png
+    QString url() const;
+
+    /// fetches the tiles seen during the animation from (\a from, \a fromZoom) to (\a to, \a toZoom) of a \a viewport
+    Q_INVOKABLE void prefetchPath(const QGeoCoordinate& from, qreal fromZoom, const QGeoCoordinate& to, qreal toZoom, const QSizeF& viewport);
+    /// fetches the tiles of the \a region with a margin of a tile, at the \a zoom and the ones next to it,
+    /// once the region has not changed for SETTLE_MS
+    Q_INVOKABLE void prefetchRegion(const QGeoRectangle& region, qreal zoom);
+    /// fetches the tiles of the \a area for the zooms up to \a maxZoom, at most SEED_LIMIT of them
+    void seed(const QGeoRectangle& area, int maxZoom);
+
+private:
+    struct Range
+    {
+        int zoom;
+        int x0, y0, x1, y1;         // tiles, inclusive; x may go out of [0, 2^zoom) around the antimeridian
+    };
+
+    static Range range(const QPointF& center, qreal zoom, const QSizeF& viewport);
+    static Range range(const QGeoRectangle& region, int zoom, int margin);
+
+    void readRequest(QTcpSocket* socket);
+    void reply(QTcpSocket* socket, const QByteArray& tile);
+    void settled();
+    void enqueue(const QVector<Range>& ranges, int limit, QQueue<quint64>& queue);
+    void request(quint64 key);
+    void next();
+    void fetched(quint64 key, const QByteArray& tile);
+    QByteArray standIn(quint64 key) const;
+
+    QTcpServer mServer;
+    QNetworkAccessManager mNetwork;
+    TilePack mPack;
+    QString mUpstream;
+    int mLatency;
+    bool mPrefetching;
+
+    QTimer mSettle;
+    QGeoRectangle mRegion;      // to prefetch once settled
+    qreal mZoom = 0;
+
+    // a tile may be in several queues, it is skipped when its turn comes if it is fetched already
+    QHash<quint64, QVector<QPointer<QTcpSocket>>> mWaiting;    // for a tile being fetched
+    QQueue<quint64> mUrgent;                                    // the map waits for these
+    QQueue<quint64> mPrefetch;
+    QQueue<quint64> mSeed;
+    QSet<quint64> mFetching;
+};
+
+#endif // TILESERVER_H
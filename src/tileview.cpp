@@ -0,0 +1,279 @@
+#include <QImageReader>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QThread>
+#include <QWheelEvent>
+
+#include <algorithm>
+#include <cmath>
+
+#include "exifstorage.h"
+#include "pics.h"
+#include "tileview.h"
+
+constexpr int TileView::TILE;
+constexpr int TileView::CACHE_KB;
+constexpr int TileView::COARSE_SIZE;
+
+namespace
+{
+
+const qreal MAX_SCALE = 8;
+const int WHEEL_STEP = 240; // a notch zooms by sqrt(2)
+
+} // namespace
+
+TileView::TileView(QWidget* parent) : Super(parent), mTiles(CACHE_KB)
+{
+    setMinimumSize(200, 150);
+    setFocusPolicy(Qt::StrongFocus);
+    mPool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() / 2));
+}
+
+TileView::~TileView()
+{
+    mPool.clear();
+    mPool.waitForDone();
+}
+
+void TileView::setPath(const QString& path)
+{
+    mPool.clear();
+    ++mGeneration;
+    mTiles.clear();
+    mPending.clear();
+    mCoarse = QImage();
+    mLastLevel = -1;
+
+    mPath = path;
+    mSize = QImageReader(path).size();
+    if (!mSize.isValid())
+        mSize = QSize();
+
+    Exif::Orientation orientation;
+    if (auto photo = ExifStorage::data(path))
+        orientation = photo->orientation;
+    else
+        orientation = Exif::File(path, false).orientation();
+    mOrientation = Pics::transform(orientation, mSize);
+
+    mLevels = 1;
+    while (mSize.isValid() && (levelSize(mLevels - 1).width() > COARSE_SIZE || levelSize(mLevels - 1).height() > COARSE_SIZE))
+        ++mLevels;
+
+    setWindowTitle(path);
+    fit();
+}
+
+void TileView::fit()
+{
+    mFitted = true;
+
+    const QSizeF displayed = mOrientation.mapRect(QRectF(QPointF(), QSizeF(mSize))).size();
+    if (displayed.isEmpty())
+    {
+        update();
+        return;
+    }
+
+    mScale = std::min(width() / displayed.width(), height() / displayed.height());
+    mOrigin = QPointF(displayed.width() - width() / mScale, displayed.height() - height() / mScale) / 2;
+    update();
+}
+
+void TileView::paintEvent(QPaintEvent* /*e*/)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().dark());
+
+    if (!mSize.isValid() || mSize.isEmpty())
+        return;
+
+    const QTransform toWidget = mOrientation * view();
+    painter.setTransform(toWidget);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+    const int coarse = mLevels - 1;
+    if (!mCoarse.isNull())
+    {
+        const qreal f = 1 << coarse;
+        painter.drawImage(QRectF(0, 0, mCoarse.width() * f, mCoarse.height() * f), mCoarse);
+    }
+    else
+    {
+        request(coarse, -1, -1);
+    }
+
+    const int current = level();
+    if (current != mLastLevel)
+    {
+        // the tiles queued for the previous level are not visible any more
+        mPool.clear();
+        mPending.clear();
+        mLastLevel = current;
+        if (mCoarse.isNull())
+            request(coarse, -1, -1);
+    }
+
+    if (current == coarse)
+        return;
+
+    const QRectF visible = toWidget.inverted().mapRect(QRectF(rect())) & QRectF(QPointF(), QSizeF(mSize));
+    if (visible.isEmpty())
+        return;
+
+    const int f = 1 << current;
+    const QSize size = levelSize(current);
+    const int x0 = static_cast<int>(visible.left() / f / TILE);
+    const int y0 = static_cast<int>(visible.top() / f / TILE);
+    const int x1 = std::min(static_cast<int>(std::ceil(visible.right() / f / TILE)), (size.width() + TILE - 1) / TILE);
+    const int y1 = std::min(static_cast<int>(std::ceil(visible.bottom() / f / TILE)), (size.height() + TILE - 1) / TILE);
+
+    for (int y = y0; y < y1; ++y)
+    {
+        for (int x = x0; x < x1; ++x)
+        {
+            if (auto tile = mTiles.object(tileKey(current, x, y)))
+                painter.drawImage(QRectF(x * TILE * f, y * TILE * f, tile->width() * f, tile->height() * f), *tile);
+            else
+                request(current, x, y);
+        }
+    }
+}
+
+void TileView::resizeEvent(QResizeEvent* /*e*/)
+{
+    if (mFitted)
+        fit();
+}
+
+void TileView::wheelEvent(QWheelEvent* e)
+{
+    const QPointF pos = e->position();
+    const QPointF anchor = mOrigin + pos / mScale; // stays under the cursor
+
+    const qreal fitted = std::min(width(), height()) / std::max<qreal>(1, std::max(mSize.width(), mSize.height()));
+    const qreal scale = mScale * std::pow(2.0, 1.0 * e->angleDelta().y() / WHEEL_STEP);
+    mScale = std::max(fitted / 2, std::min(scale, MAX_SCALE));
+    mOrigin = anchor - pos / mScale;
+    mFitted = false;
+
+    update();
+    e->accept();
+}
+
+void TileView::mousePressEvent(QMouseEvent* e)
+{
+    if (e->button() != Qt::LeftButton)
+    {
+        Super::mousePressEvent(e);
+        return;
+    }
+
+    mDragStart = e->pos();
+    mDragOrigin = mOrigin;
+    setCursor(Qt::ClosedHandCursor);
+}
+
+void TileView::mouseMoveEvent(QMouseEvent* e)
+{
+    if (!(e->buttons() & Qt::LeftButton))
+    {
+        Super::mouseMoveEvent(e);
+        return;
+    }
+
+    mOrigin = mDragOrigin - QPointF(e->pos() - mDragStart) / mScale;
+    mFitted = false;
+    update();
+}
+
+void TileView::mouseReleaseEvent(QMouseEvent* e)
+{
+    unsetCursor();
+    Super::mouseReleaseEvent(e);
+}
+
+void TileView::mouseDoubleClickEvent(QMouseEvent* /*e*/)
+{
+    fit();
+}
+
+void TileView::keyPressEvent(QKeyEvent* e)
+{
+    if (e->key() == Qt::Key_Escape)
+        close();
+    else
+        Super::keyPressEvent(e);
+}
+
+quint64 TileView::tileKey(int level, int x, int y)
+{
+    return (static_cast<quint64>(level) << 48) |
+           (static_cast<quint64>(static_cast<quint32>(y) & 0xffffff) << 24) |
+           (static_cast<quint32>(x) & 0xffffff);
+}
+
+QSize TileView::levelSize(int level) const
+{
+    const int f = 1 << level;
+    return QSize((mSize.width() + f - 1) / f, (mSize.height() + f - 1) / f);
+}
+
+/// \return the coarsest level still having a pixel per device pixel
+int TileView::level() const
+{
+    const qreal ideal = std::log2(1 / (mScale * devicePixelRatioF()));
+    return std::max(0, std::min(static_cast<int>(std::floor(ideal)), mLevels - 1));
+}
+
+/// displayed picture -> widget
+QTransform TileView::view() const
+{
+    QTransform transform;
+    transform.scale(mScale, mScale);
+    transform.translate(-mOrigin.x(), -mOrigin.y());
+    return transform;
+}
+
+/// queues decoding of the tile (\a x, \a y) of the \a level, or of the whole level if \a x and \a y are -1
+void TileView::request(int level, int x, int y)
+{
+    const quint64 key = tileKey(level, x, y);
+    if (mPending.contains(key))
+        return;
+    mPending.insert(key);
+
+    const QString path = mPath;
+    const QSize size = levelSize(level);
+    const QRect rect = x < 0 ? QRect() : QRect(x * TILE, y * TILE, TILE, TILE) & QRect(QPoint(), size);
+    const int generation = mGeneration;
+
+    // only the needed part of the picture is decoded, at the nearest DCT scale
+    mPool.start([this, path, size, rect, level, key, generation](){
+        QImageReader reader(path);
+        if (level > 0)
+            reader.setScaledSize(size);
+        if (rect.isValid())
+            level > 0 ? reader.setScaledClipRect(rect) : reader.setClipRect(rect);
+
+        const QImage tile = reader.read();
+        QMetaObject::invokeMethod(this, [this, generation, key, tile](){ loaded(generation, key, tile); }, Qt::QueuedConnection);
+    });
+}
+
+void TileView::loaded(int generation, quint64 key, const QImage& tile)
+{
+    if (generation != mGeneration || tile.isNull())
+        return; // a failed tile stays pending, so it isn't requested again
+
+    mPending.remove(key);
+
+    if (key == tileKey(mLevels - 1, -1, -1))
+        mCoarse = tile;
+    else
+        mTiles.insert(key, new QImage(tile), std::max(1, static_cast<int>(tile.sizeInBytes() / 1024)));
+
+    update();
+}
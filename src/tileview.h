@@ -0,0 +1,75 @@
+#ifndef TILEVIEW_H
+#define TILEVIEW_H
+
+#include <QCache>
+#include <QImage>
+#include <QPointF>
+#include <QSet>
+#include <QThreadPool>
+#include <QTransform>
+#include <QWidget>
+
+#include "exif/file.h"
+
+/// Full resolution viewer for big pictures.
+/// The picture is decoded in TILE x TILE pieces on background threads, each of them
+/// at the pyramid level matching the zoom (level L is the picture scaled by 1 / 2^L),
+/// so only the visible part is ever decoded at full size.
+/// Tiles are kept in an LRU bounded by CACHE_KB; until a tile is decoded, the whole
+/// picture at the coarsest level is drawn in its place.
+/// Wheel zooms at the cursor, drag pans, double click fits the picture to the window.
+class TileView : public QWidget
+{
+    using Super = QWidget;
+    Q_OBJECT
+
+public:
+    static constexpr int TILE = 256;
+    static constexpr int CACHE_KB = 128 * 1024;
+    static constexpr int COARSE_SIZE = 1024; // the coarsest level fits into it
+
+    explicit TileView(QWidget* parent = nullptr);
+    ~TileView() override;
+
+    void setPath(const QString& path);
+    void fit();
+
+protected:
+    void paintEvent(QPaintEvent* e) override;
+    void resizeEvent(QResizeEvent* e) override;
+    void wheelEvent(QWheelEvent* e) override;
+    void mousePressEvent(QMouseEvent* e) override;
+    void mouseMoveEvent(QMouseEvent* e) override;
+    void mouseReleaseEvent(QMouseEvent* e) override;
+    void mouseDoubleClickEvent(QMouseEvent* e) override;
+    void keyPressEvent(QKeyEvent* e) override;
+
+private:
+    static quint64 tileKey(int level, int x, int y);
+
+    QSize levelSize(int level) const;
+    int level() const;
+    QTransform view() const;
+    void request(int level, int x, int y);
+    void loaded(int generation, quint64 key, const QImage& tile);
+
+    QString mPath;
+    QSize mSize;                        // stored, before orientation
+    QTransform mOrientation;            // stored -> displayed
+    int mLevels = 1;                    // 0 .. mLevels - 1
+    QImage mCoarse;                     // level mLevels - 1, stored orientation
+
+    qreal mScale = 1;                   // screen pixels per picture pixel
+    QPointF mOrigin;                    // displayed picture point at the widget top left corner
+    bool mFitted = true;                // follows the widget size
+    QPoint mDragStart;
+    QPointF mDragOrigin;
+
+    QThreadPool mPool;
+    int mGeneration = 0;                // bumped by setPath(), older tiles are dropped
+    int mLastLevel = -1;                // the level of the queued tiles
+    QCache<quint64, QImage> mTiles;     // cost in KB
+    QSet<quint64> mPending;
+};
+
+#endif // TILEVIEW_H
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <iterator>
+
+#include "timeindex.h"
+
+constexpr qint64 TimeIndex::INVALID_TIME;
+constexpr qint64 TimeIndex::DAY;
+
+namespace
+{
+
+/// floor division, so times before the epoch fall into the right day
+inline qint64 dayOf(qint64 time)
+{
+    return time >= 0 ? time / TimeIndex::DAY : -((-time + TimeIndex::DAY - 1) / TimeIndex::DAY);
+}
+
+inline int lowBit(int i)
+{
+    return i & -i;
+}
+
+} // namespace
+
+void TimeIndex::insert(PhotoId id, qint64 time)
+{
+    if (time == INVALID_TIME)
+        return;
+
+    mAdded.append({ time, id });
+    addDay(time, +1);
+}
+
+void TimeIndex::remove(PhotoId id, qint64 time)
+{
+    if (time == INVALID_TIME)
+        return;
+
+    const Entry entry = { time, id };
+
+    auto added = std::find_if(mAdded.begin(), mAdded.end(), [&entry](const Entry& e) {
+        return e.time == entry.time && e.id == entry.id; });
+    if (added != mAdded.end())
+    {
+        *added = mAdded.last();
+        mAdded.removeLast();
+        addDay(time, -1);
+        return;
+    }
+
+    auto sorted = std::lower_bound(mSorted.begin(), mSorted.end(), entry);
+    if (sorted != mSorted.end() && sorted->id == id && sorted->time == time)
+    {
+        mSorted.erase(sorted);
+        addDay(time, -1);
+    }
+}
+
+Period TimeIndex::range() const
+{
+    if (isEmpty())
+        return {};
+
+    flush();
+    return { mSorted.first().time, mSorted.last().time + 1 };
+}
+
+/// \return the number of photos taken in the \a period or in total if it's null
+int TimeIndex::count(const Period& period) const
+{
+    if (period.isNull())
+        return size();
+
+    flush();
+    return lowerBound(period.to) - lowerBound(period.from);
+}
+
+/// \return ids of the photos taken in the \a period or all of them if it's null
+Bitmap TimeIndex::select(const Period& period) const
+{
+    flush();
+
+    const int begin = period.isNull() ? 0 : lowerBound(period.from);
+    const int end = period.isNull() ? mSorted.size() : lowerBound(period.to);
+
+    PhotoIdList ids;
+    ids.reserve(end - begin);
+    for (int i = begin; i < end; ++i)
+        ids.append(mSorted.at(i).id);
+
+    // sorted input only appends to the bitmap chunks
+    std::sort(ids.begin(), ids.end());
+
+    Bitmap bitmap;
+    for (PhotoId id: ids)
+        bitmap.insert(id);
+    return bitmap;
+}
+
+/// splits the \a period (the whole range if it's null) into \a bins equal parts and counts photos in each;
+/// bins of a day or wider are counted with the per-day tree, narrower ones with the sorted array
+QVector<int> TimeIndex::histogram(const Period& period, int bins) const
+{
+    const Period p = period.isNull() ? range() : period;
+    QVector<int> counts(std::max(bins, 0), 0);
+    if (p.isNull() || counts.isEmpty())
+        return counts;
+
+    const double width = 1.0 * (p.to - p.from) / bins;
+    auto edge = [&p, width](int i) { return p.from + static_cast<qint64>(width * i); };
+
+    if (width >= DAY)
+    {
+        // the end is exclusive, so the day of the last instant is counted whole
+        int previous = prefix(dayOf(edge(0)));
+        for (int i = 0; i < bins; ++i)
+        {
+            const int next = prefix(i + 1 == bins ? dayOf(p.to - 1) + 1 : dayOf(edge(i + 1)));
+            counts[i] = next - previous;
+            previous = next;
+        }
+    }
+    else
+    {
+        flush();
+        int previous = lowerBound(edge(0));
+        for (int i = 0; i < bins; ++i)
+        {
+            const int next = lowerBound(i + 1 == bins ? p.to : edge(i + 1));
+            counts[i] = next - previous;
+            previous = next;
+        }
+    }
+
+    return counts;
+}
+
+void TimeIndex::flush() const
+{
+    if (mAdded.isEmpty())
+        return;
+
+    std::sort(mAdded.begin(), mAdded.end());
+
+    QVector<Entry> merged;
+    merged.reserve(mSorted.size() + mAdded.size());
+    std::merge(mSorted.cbegin(), mSorted.cend(), mAdded.cbegin(), mAdded.cend(), std::back_inserter(merged));
+
+    mSorted.swap(merged);
+    mAdded.clear();
+}
+
+/// \return index of the first entry not earlier than \a time; flush() must be called before
+int TimeIndex::lowerBound(qint64 time) const
+{
+    auto i = std::lower_bound(mSorted.cbegin(), mSorted.cend(), time, [](const Entry& entry, qint64 t) {
+        return entry.time < t; });
+    return static_cast<int>(std::distance(mSorted.cbegin(), i));
+}
+
+void TimeIndex::addDay(qint64 time, int delta)
+{
+    const qint64 day = dayOf(time);
+
+    if (mDays.isEmpty())
+        mFirstDay = day;
+
+    const qint64 last = mFirstDay + mDays.size() - 1;
+    if (day < mFirstDay || day > last)
+    {
+        // grow with a margin on the side being extended, then rebuild the tree in O(days)
+        const qint64 margin = std::max<qint64>(366, mDays.size() / 2);
+        const qint64 first = day < mFirstDay ? day - margin : mFirstDay;
+        const qint64 size = (day > last ? day + margin : last) - first + 1;
+
+        QVector<int> days(static_cast<int>(size), 0);
+        std::copy(mDays.cbegin(), mDays.cend(), days.begin() + (mFirstDay - first));
+        mDays.swap(days);
+        mFirstDay = first;
+
+        mTree = mDays;
+        for (int i = 1; i <= mTree.size(); ++i)
+        {
+            const int parent = i + lowBit(i);
+            if (parent <= mTree.size())
+                mTree[parent - 1] += mTree.at(i - 1);
+        }
+    }
+
+    const int index = static_cast<int>(day - mFirstDay);
+    mDays[index] += delta;
+    for (int i = index + 1; i <= mTree.size(); i += lowBit(i))
+        mTree[i - 1] += delta;
+}
+
+/// \return the number of photos taken before the \a day
+int TimeIndex::prefix(qint64 day) const
+{
+    int count = 0;
+    const int end = static_cast<int>(std::min<qint64>(std::max<qint64>(day - mFirstDay, 0), mTree.size()));
+    for (int i = end; i > 0; i -= lowBit(i))
+        count += mTree.at(i - 1);
+    return count;
+}
@@ -0,0 +1,70 @@
+#ifndef TIMEINDEX_H
+#define TIMEINDEX_H
+
+#include <QVector>
+
+#include <limits>
+
+#include "bitmap.h"
+#include "photoid.h"
+
+/// half-open time interval [from, to) in msecs since epoch; a null period restricts nothing
+struct Period
+{
+    qint64 from = 0;
+    qint64 to = 0;
+
+    bool isNull() const { return from >= to; }
+    bool accepts(qint64 time) const { return isNull() || (time >= from && time < to); }
+    bool operator ==(const Period& other) const { return from == other.from && to == other.to; }
+    bool operator !=(const Period& other) const { return !(*this == other); }
+};
+
+
+/// Capture times of the photos.
+/// A sorted (time, id) array answers exact range counts and range-to-set queries
+/// in O(log n); new entries are merged into it lazily, on the first query.
+/// A Fenwick tree of per-day counts answers histogram queries in O(log days) per bin.
+/// Not thread safe: ExifStorage guards it with its mutex.
+class TimeIndex
+{
+public:
+    static constexpr qint64 INVALID_TIME = std::numeric_limits<qint64>::min();
+    static constexpr qint64 DAY = 24 * 60 * 60 * 1000;
+
+    void insert(PhotoId id, qint64 time);
+    void remove(PhotoId id, qint64 time);
+
+    int size() const { return mSorted.size() + mAdded.size(); }
+    bool isEmpty() const { return size() == 0; }
+
+    /// [the earliest time, the latest time + 1)
+    Period range() const;
+
+    int count(const Period& period) const;
+    Bitmap select(const Period& period) const;
+    QVector<int> histogram(const Period& period, int bins) const;
+
+private:
+    struct Entry
+    {
+        qint64 time;
+        PhotoId id;
+        bool operator <(const Entry& other) const { return time < other.time || (time == other.time && id < other.id); }
+    };
+
+    void flush() const;
+    int lowerBound(qint64 time) const;
+
+    void addDay(qint64 time, int delta);
+    int prefix(qint64 day) const;
+
+    mutable QVector<Entry> mSorted;
+    mutable QVector<Entry> mAdded;     // not merged into mSorted yet
+
+    qint64 mFirstDay = 0;              // day number of mDays[0]
+    QVector<int> mDays;                // per-day counts
+    QVector<int> mTree;                // Fenwick tree over mDays
+};
+
+#endif // TIMEINDEX_H
@@ -0,0 +1,163 @@
+#include <QDateTime>
+#include <QMouseEvent>
+#include <QPainter>
+
+#include <algorithm>
+
+#include "exifstorage.h"
+#include "timeline.h"
+
+constexpr int Timeline::BAR_WIDTH;
+constexpr int Timeline::REFRESH_INTERVAL;
+
+Timeline::Timeline(QWidget* parent) : Super(parent)
+{
+    setToolTip(tr("Drag to show the photos taken in a period, double click to show all"));
+
+    mRefreshTimer.setSingleShot(true);
+    mRefreshTimer.setInterval(REFRESH_INTERVAL);
+    connect(&mRefreshTimer, &QTimer::timeout, this, &Timeline::updateHistogram);
+}
+
+void Timeline::setPeriod(const Period& period)
+{
+    if (period != mPeriod)
+    {
+        mPeriod = period;
+        update();
+        emit periodChanged(mPeriod);
+    }
+}
+
+void Timeline::refresh()
+{
+    if (!mRefreshTimer.isActive())
+        mRefreshTimer.start();
+}
+
+QSize Timeline::sizeHint() const
+{
+    return QSize(400, 60);
+}
+
+QSize Timeline::minimumSizeHint() const
+{
+    return QSize(100, 30);
+}
+
+void Timeline::paintEvent(QPaintEvent* /*e*/)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+
+    if (mBins.isEmpty() || mMaxBin == 0)
+        return;
+
+    const int textHeight = fontMetrics().height();
+    const int chartHeight = height() - textHeight;
+
+    const Period selected = selection();
+    if (!selected.isNull())
+    {
+        int x1 = xAt(selected.from), x2 = xAt(selected.to);
+        painter.fillRect(QRect(x1, 0, std::max(x2 - x1, 1), chartHeight), palette().highlight().color().lighter(170));
+    }
+
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(palette().highlight());
+    for (int i = 0; i < mBins.size(); ++i)
+    {
+        if (!mBins.at(i))
+            continue;
+        int h = std::max(1, mBins.at(i) * chartHeight / mMaxBin);
+        painter.drawRect(i * BAR_WIDTH, chartHeight - h, BAR_WIDTH - 1, h);
+    }
+
+    auto date = [](qint64 time) { return QDateTime::fromMSecsSinceEpoch(time, Qt::UTC).date().toString(Qt::ISODate); };
+    const Period shown = selected.isNull() ? mRange : selected;
+    QString text = selected.isNull() ?
+                       QString("%1 - %2").arg(date(shown.from), date(shown.to - 1)) :
+                       tr("%1 - %2: %3 photos").arg(date(shown.from), date(shown.to - 1)).arg(ExifStorage::count(shown));
+
+    painter.setPen(palette().text().color());
+    painter.drawText(QRect(0, chartHeight, width(), textHeight), Qt::AlignCenter, text);
+}
+
+void Timeline::resizeEvent(QResizeEvent* /*e*/)
+{
+    updateHistogram();
+}
+
+void Timeline::mousePressEvent(QMouseEvent* e)
+{
+    if (e->button() == Qt::LeftButton && !mRange.isNull())
+        mDragStart = e->pos().x();
+    else
+        Super::mousePressEvent(e);
+}
+
+void Timeline::mouseMoveEvent(QMouseEvent* e)
+{
+    if (mDragStart != -1)
+    {
+        mDragged = periodAt(mDragStart, e->pos().x());
+        update();
+    }
+    else
+        Super::mouseMoveEvent(e);
+}
+
+void Timeline::mouseReleaseEvent(QMouseEvent* e)
+{
+    if (mDragStart != -1 && e->button() == Qt::LeftButton)
+    {
+        const int start = mDragStart;
+        mDragStart = -1;
+        mDragged = {};
+
+        if (e->pos().x() != start)
+            setPeriod(periodAt(start, e->pos().x()));
+        update();
+    }
+    else
+    {
+        Super::mouseReleaseEvent(e);
+    }
+}
+
+void Timeline::mouseDoubleClickEvent(QMouseEvent* /*e*/)
+{
+    mDragStart = -1;
+    mDragged = {};
+    setPeriod({});
+}
+
+void Timeline::updateHistogram()
+{
+    mRange = ExifStorage::timeRange();
+    mBins = ExifStorage::histogram(mRange, std::max(1, width() / BAR_WIDTH));
+    mMaxBin = mBins.isEmpty() ? 0 : *std::max_element(mBins.cbegin(), mBins.cend());
+    update();
+}
+
+qint64 Timeline::timeAt(int x) const
+{
+    const int span = std::max(1, static_cast<int>(mBins.size()) * BAR_WIDTH);
+    x = std::max(0, std::min(x, span));
+    return mRange.from + static_cast<qint64>(1.0 * (mRange.to - mRange.from) * x / span);
+}
+
+int Timeline::xAt(qint64 time) const
+{
+    if (mRange.isNull())
+        return 0;
+    const int span = static_cast<int>(mBins.size()) * BAR_WIDTH;
+    return static_cast<int>(1.0 * (time - mRange.from) * span / (mRange.to - mRange.from));
+}
+
+Period Timeline::periodAt(int x1, int x2) const
+{
+    if (x1 > x2)
+        std::swap(x1, x2);
+    return { timeAt(x1), timeAt(x2 + 1) };
+}
@@ -0,0 +1,60 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <QTimer>
+#include <QVector>
+#include <QWidget>
+
+#include "timeindex.h"
+
+/// histogram of capture times of all the loaded photos;
+/// drag to select a period, double click to reset it;
+/// the dragged period is only drawn until the button is released, then it is applied once
+class Timeline : public QWidget
+{
+    using Super = QWidget;
+    Q_OBJECT
+
+signals:
+    void periodChanged(const Period& period);
+
+public:
+    explicit Timeline(QWidget* parent = nullptr);
+
+    const Period& period() const { return mPeriod; }
+    void setPeriod(const Period& period);
+
+    /// schedules the histogram update; cheap enough to call for every loaded photo
+    void refresh();
+
+    QSize sizeHint() const override;
+    QSize minimumSizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent* e) override;
+    void resizeEvent(QResizeEvent* e) override;
+    void mousePressEvent(QMouseEvent* e) override;
+    void mouseMoveEvent(QMouseEvent* e) override;
+    void mouseReleaseEvent(QMouseEvent* e) override;
+    void mouseDoubleClickEvent(QMouseEvent* e) override;
+
+private:
+    static constexpr int BAR_WIDTH = 3;
+    static constexpr int REFRESH_INTERVAL = 200;
+
+    void updateHistogram();
+    qint64 timeAt(int x) const;
+    int xAt(qint64 time) const;
+    Period periodAt(int x1, int x2) const;
+    const Period& selection() const { return mDragStart != -1 && !mDragged.isNull() ? mDragged : mPeriod; }
+
+    QTimer mRefreshTimer;
+    Period mRange;        // all the photos
+    Period mPeriod;       // selected part
+    Period mDragged;      // being selected
+    QVector<int> mBins;
+    int mMaxBin = 0;
+    int mDragStart = -1;
+};
+
+#endif // TIMELINE_H
@@ -9,6 +9,7 @@
 #include "exifstorage.h"
 #include "model.h"
 #include "pics.h"
+#include "thumbnaildelegate.h"
 #include "tooltip.h"
 
 QRect TooltipUtils::adjustedRect(const QPoint& pos, const QSize& size, int shift)
@@ -40,12 +41,11 @@ QVariant GridToolTip::Model::data(const QModelIndex& index, int role) const
     if (internalIndex >= mData.size())
         return {};
 
-    if (role == Qt::DecorationRole)
-        if (auto photo = ExifStorage::data(mData[internalIndex]))
-            return photo->pix32;
+    if (role == IFileListModel::PhotoIdRole)
+        return QVariant::fromValue(mData[internalIndex]);
 
     if (role == IFileListModel::FilePathRole)
-        return mData[internalIndex];
+        return ExifStorage::path(mData[internalIndex]);
 
     if (role == Qt::SizeHintRole)
         return QSize(ExifReader::thumbnailSize + 4, ExifReader::thumbnailSize + 4);
@@ -53,7 +53,7 @@ QVariant GridToolTip::Model::data(const QModelIndex& index, int role) const
     return {};
 }
 
-void GridToolTip::Model::setFiles(const QStringList& files)
+void GridToolTip::Model::setFiles(const PhotoIdList& files)
 {
     if (mData == files)
         return;
@@ -142,11 +142,13 @@ GridToolTip::GridToolTip(QWidget* parent) : AbstractToolTip(parent)
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setVerticalScrollBarPolicy(Qt::ScrollBarAsNeeded);
     setShowGrid(false);
+    setIconSize(QSize(ExifReader::thumbnailSize, ExifReader::thumbnailSize));
+    setItemDelegate(new ThumbnailDelegate(this));
 
     selectionModel()->setObjectName("tooltipSelectionModel");
 }
 
-void GridToolTip::setFiles(const QStringList& files)
+void GridToolTip::setFiles(const PhotoIdList& files)
 {
     mModel->setFiles(files);
     resizeRowsToContents();
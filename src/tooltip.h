@@ -6,6 +6,8 @@
 #include <QTimerEvent>
 #include <QLabel>
 
+#include "photoid.h"
+
 class TooltipUtils
 {
 public:
@@ -62,7 +64,7 @@ class GridToolTip : public AbstractToolTip<QTableView>
 {
     class Model : public QAbstractTableModel
     {
-        QStringList mData;
+        PhotoIdList mData;
         int mRowCount = 0;
         int mColCount = 0;
 
@@ -73,7 +75,7 @@ class GridToolTip : public AbstractToolTip<QTableView>
         int columnCount(const QModelIndex& parent = {}) const override;
         QVariant data(const QModelIndex& index, int role) const override;
 
-        void setFiles(const QStringList& files);
+        void setFiles(const PhotoIdList& files);
 
     } * mModel = new Model(this);
 
@@ -84,7 +86,7 @@ protected:
 
 public:
     explicit GridToolTip(QWidget* parent = nullptr);
-    void setFiles(const QStringList& files);
+    void setFiles(const PhotoIdList& files);
     void showAt(const QPoint& pos, int shift = 0);
 };
 
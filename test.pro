@@ -1,7 +1,6 @@
-QT -= gui
-QT += location positioning
+QT += concurrent location network positioning widgets
 
-CONFIG += c++11 console
+CONFIG += c++17 console
 CONFIG -= app_bundle
 
 include(src/3rdparty/libexif/libexif.pri)
@@ -15,18 +14,56 @@ INCLUDEPATH += \
     src/3rdparty/libexif
 
 SOURCES += \
+    src/bitmap.cpp \
+    src/catalog.cpp \
+    src/clusters.cpp \
     src/exif/file.cpp \
     src/exif/utils.cpp \
     src/exifstorage.cpp \
+    src/heatmap.cpp \
+    src/model.cpp \
     src/pics.cpp \
+    src/previewloader.cpp \
+    src/stringpool.cpp \
+    src/thumbnailatlas.cpp \
+    src/thumbnailstore.cpp \
+    src/tilepack.cpp \
+    src/tileserver.cpp \
+    src/timeindex.cpp \
     src/test/tmpjpegfile.cpp \
-    src/test/tst_exiffile.cpp
+    src/test/tst_bitmap.cpp \
+    src/test/tst_catalog.cpp \
+    src/test/tst_clusters.cpp \
+    src/test/tst_exiffile.cpp \
+    src/test/tst_heatmap.cpp \
+    src/test/tst_model.cpp \
+    src/test/tst_pics.cpp \
+    src/test/tst_previewloader.cpp \
+    src/test/tst_stringpool.cpp \
+    src/test/tst_thumbnailatlas.cpp \
+    src/test/tst_thumbnailstore.cpp \
+    src/test/tst_tilepack.cpp \
+    src/test/tst_tileserver.cpp \
+    src/test/tst_timeindex.cpp
 
 HEADERS += \
+    src/bitmap.h \
+    src/catalog.h \
+    src/clusters.h \
     src/exif/file.h \
     src/exif/utils.h \
     src/exifstorage.h \
+    src/heatmap.h \
+    src/model.h \
+    src/photoid.h \
     src/pics.h \
+    src/previewloader.h \
+    src/stringpool.h \
+    src/thumbnailatlas.h \
+    src/thumbnailstore.h \
+    src/tilepack.h \
+    src/tileserver.h \
+    src/timeindex.h \
     src/test/tmpjpegfile.h
 
 RESOURCES += \